@@ -0,0 +1,335 @@
+// Performance benchmarks for loading, ranking, propagation and output.
+//
+//   g++ -std=c++17 -O2 -pthread -Iinclude bench/bench_bgpsim.cpp src/parser.cpp -lbenchmark -o bench_bgpsim
+//   ./bench_bgpsim [--ases=N[,N...]] [--caida=FILE] [--prefixes=N] [benchmark flags]
+//
+// Every benchmark runs once per dataset: synthetic tiered graphs with
+// the given numbers of ASes (default 2000,20000,100000), plus the real CAIDA
+// file when it exists (default ../data/20250901.as-rel2.txt, as in
+// CaidaRealDataTest).  Propagation phases are timed alone: the earlier
+// phases and re-seeding run with the timer paused.
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../include/parser.hpp"
+#include "../include/read_caida.hpp"
+#include "../include/as_graph.hpp"
+#include "../include/graph_loader.hpp"
+#include "../include/csr_graph.hpp"
+#include "../include/topology.hpp"
+#include "../include/bgp_sim.hpp"
+#include "../include/output.hpp"
+#include "../include/topology_generator.hpp"
+
+namespace {
+
+// -------------------- datasets --------------------
+
+struct Dataset {
+    std::string name;
+    std::string file;                    // CAIDA-format relationships
+    std::string text;                    // contents of `file`
+    ASGraph graph;
+    std::shared_ptr<const Topology> topo;
+    std::shared_ptr<const Topology> layered;   // topo renumbered in IdOrder::LAYER
+    std::vector<std::pair<std::string, uint32_t>> seeds;
+    uint32_t invalid_origin = 0;         // origin of one ROV-invalid prefix
+    std::vector<uint32_t> rov_asns;
+};
+
+std::size_t g_num_prefixes = 32;
+
+// Same generator as tools/gen_topology; ROV and seeds come from
+// choose_scenario so that they follow the ranked layers.
+std::string synthetic_caida(std::size_t num_ases) {
+    GeneratorConfig cfg;
+    cfg.num_ases = num_ases;
+    cfg.tier1 = std::max<std::size_t>(4, num_ases / 5000);
+    cfg.num_prefixes = 0;
+    cfg.rov_fraction = 0;
+    cfg.seed = 12345;
+
+    std::ostringstream out;
+    write_caida(generate_topology(cfg), out);
+    return out.str();
+}
+
+std::string read_file(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// Seeds prefixes at stubs spread over the graph and deploys ROV at every
+// seventh transit
+void choose_scenario(Dataset& d) {
+    const auto& layers = d.topo->layers;
+    const CSRGraph& g = d.topo->graph;
+    if (layers.empty()) return;
+
+    const auto& stubs = layers[0];
+    for (std::size_t k = 0; k < g_num_prefixes; ++k) {
+        const uint32_t id = stubs[(k * 7919) % stubs.size()];
+        d.seeds.emplace_back("10." + std::to_string(k / 256) + "." +
+                             std::to_string(k % 256) + ".0/24", g.asn_of(id));
+    }
+    d.invalid_origin = g.asn_of(stubs[stubs.size() / 2]);
+
+    for (std::size_t r = 1; r < layers.size(); ++r)
+        for (std::size_t i = 0; i < layers[r].size(); i += 7)
+            d.rov_asns.push_back(g.asn_of(layers[r][i]));
+}
+
+Dataset& finish_dataset(Dataset& d) {
+    ::build_graph(d.file, d.graph);
+    d.topo = make_topology(d.graph);
+    d.layered = relabel_by_layer(*d.topo);
+    choose_scenario(d);
+    return d;
+}
+
+std::vector<std::unique_ptr<Dataset>> g_datasets;
+
+Dataset& add_synthetic(std::size_t num_ases) {
+    auto d = std::make_unique<Dataset>();
+    d->name = "synthetic_" + std::to_string(num_ases);
+    d->text = synthetic_caida(num_ases);
+    d->file = (std::filesystem::temp_directory_path() /
+               ("bgpsim_bench_" + std::to_string(num_ases) + ".txt")).string();
+    std::ofstream(d->file, std::ios::binary) << d->text;
+    g_datasets.push_back(std::move(d));
+    return finish_dataset(*g_datasets.back());
+}
+
+Dataset& add_caida(const std::string& filename) {
+    auto d = std::make_unique<Dataset>();
+    d->name = "caida";
+    d->file = filename;
+    d->text = read_file(filename);
+    g_datasets.push_back(std::move(d));
+    return finish_dataset(*g_datasets.back());
+}
+
+void seed(BGPSim& sim, const Dataset& d) {
+    for (const auto& s : d.seeds)
+        sim.seed_prefix(s.first, s.second);
+    sim.seed_prefix(d.seeds.front().first, d.invalid_origin, true);
+}
+
+// -------------------- loading and ranking --------------------
+
+void BM_ParseLine(benchmark::State& state, const Dataset* d) {
+    std::vector<std::string_view> lines;
+    std::string_view rest(d->text);
+    while (!rest.empty()) {
+        const std::size_t nl = rest.find('\n');
+        std::string_view line = rest.substr(0, nl);
+        if (!line.empty() && line[0] != '#') lines.push_back(line);
+        rest.remove_prefix(nl == std::string_view::npos ? rest.size() : nl + 1);
+    }
+
+    DataRecord rec;
+    for (auto _ : state) {
+        for (std::string_view line : lines) {
+            benchmark::DoNotOptimize(parse_line(line, rec));
+            benchmark::DoNotOptimize(rec);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * lines.size()));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * d->text.size()));
+}
+
+template <bool Mapped>
+void BM_ReadCaida(benchmark::State& state, const Dataset* d) {
+    std::size_t records = 0;
+    for (auto _ : state) {
+        records = 0;
+        auto count = [&](const DataRecord& rec) {
+            benchmark::DoNotOptimize(rec);
+            ++records;
+        };
+        if (Mapped) read_caida_mapped(d->file, count);
+        else        read_caida_data(d->file, count);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * records));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * d->text.size()));
+}
+
+void BM_BuildGraph(benchmark::State& state, const Dataset* d) {
+    for (auto _ : state) {
+        ASGraph g;
+        ::build_graph(d->file, g);
+        benchmark::DoNotOptimize(g.size());
+    }
+    state.counters["ases"] = static_cast<double>(d->graph.size() - 1);
+}
+
+// range(0) = loader threads
+void BM_LoadCsrGraph(benchmark::State& state, const Dataset* d) {
+    const unsigned threads = static_cast<unsigned>(state.range(0));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(load_csr_graph(d->file, threads).size());
+    state.counters["ases"] = static_cast<double>(d->graph.size() - 1);
+}
+
+// range(0) = ranking threads
+void BM_ComputeRanks(benchmark::State& state, const Dataset* d) {
+    ThreadPool pool(static_cast<unsigned>(state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(compute_propagation_ranks(d->topo->graph, &pool));
+}
+
+void BM_FlattenGraph(benchmark::State& state, const Dataset* d) {
+    for (auto _ : state)
+        benchmark::DoNotOptimize(flatten_graph(d->graph));
+    state.counters["layers"] = static_cast<double>(d->topo->layers.size());
+}
+
+void BM_RelabelByLayer(benchmark::State& state, const Dataset* d) {
+    for (auto _ : state)
+        benchmark::DoNotOptimize(relabel_by_layer(*d->topo));
+}
+
+// -------------------- propagation --------------------
+
+enum class Phase { UP, PEERS, DOWN };
+
+// range(0) = threads, range(1) = 0 for push, 1 for pull, range(2) = 1 for
+// ids renumbered by layer
+template <Phase P>
+void BM_Propagate(benchmark::State& state, const Dataset* d) {
+    BGPSim sim(state.range(2) ? d->layered : d->topo, d->rov_asns);
+    sim.set_num_threads(static_cast<unsigned>(state.range(0)));
+    sim.set_strategy(state.range(1) ? Strategy::PULL : Strategy::PUSH);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        sim.reset(d->rov_asns);
+        seed(sim, *d);
+        if (P != Phase::UP) sim.propagate_up();
+        if (P == Phase::DOWN) sim.propagate_across_peers();
+        state.ResumeTiming();
+
+        if (P == Phase::UP)    sim.propagate_up();
+        if (P == Phase::PEERS) sim.propagate_across_peers();
+        if (P == Phase::DOWN)  sim.propagate_down();
+    }
+    state.counters["prefixes"] = static_cast<double>(sim.prefixes().size());
+}
+
+// -------------------- output --------------------
+
+// range(0) = formatting threads
+void BM_WriteRoutingCsv(benchmark::State& state, const Dataset* d) {
+    BGPSim sim(d->topo, d->rov_asns);
+    seed(sim, *d);
+    sim.propagate_all();
+
+    const std::string out = (std::filesystem::temp_directory_path() /
+                             ("bgpsim_bench_ribs_" + d->name + ".csv")).string();
+    const unsigned threads = static_cast<unsigned>(state.range(0));
+    for (auto _ : state)
+        write_routing_csv(sim, out, threads);
+
+    const auto bytes = std::filesystem::file_size(out);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    std::filesystem::remove(out);
+}
+
+// -------------------- registration --------------------
+
+void register_dataset(const Dataset& d) {
+    const int hw = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+    auto name = [&](const char* bench) { return std::string(bench) + "/" + d.name; };
+
+    benchmark::RegisterBenchmark(name("ParseLine").c_str(), BM_ParseLine, &d);
+    benchmark::RegisterBenchmark(name("ReadCaidaData").c_str(), BM_ReadCaida<false>, &d);
+    benchmark::RegisterBenchmark(name("ReadCaidaMapped").c_str(), BM_ReadCaida<true>, &d);
+    benchmark::RegisterBenchmark(name("BuildGraph").c_str(), BM_BuildGraph, &d)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("LoadCsrGraph").c_str(), BM_LoadCsrGraph, &d)
+        ->ArgName("threads")
+        ->Arg(1)->Arg(hw)
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+    benchmark::RegisterBenchmark(name("ComputeRanks").c_str(), BM_ComputeRanks, &d)
+        ->ArgName("threads")
+        ->Arg(1)->Arg(hw)
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+    benchmark::RegisterBenchmark(name("FlattenGraph").c_str(), BM_FlattenGraph, &d)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("RelabelByLayer").c_str(), BM_RelabelByLayer, &d)
+        ->Unit(benchmark::kMillisecond);
+
+    auto phase = [&](const char* bench, auto fn) {
+        benchmark::RegisterBenchmark(name(bench).c_str(), fn, &d)
+            ->ArgNames({"threads", "pull", "layered"})
+            ->ArgsProduct({{1, hw}, {0, 1}, {0, 1}})
+            ->Unit(benchmark::kMillisecond)
+            ->UseRealTime();
+    };
+    phase("PropagateUp", BM_Propagate<Phase::UP>);
+    phase("PropagateAcrossPeers", BM_Propagate<Phase::PEERS>);
+    phase("PropagateDown", BM_Propagate<Phase::DOWN>);
+
+    benchmark::RegisterBenchmark(name("WriteRoutingCsv").c_str(), BM_WriteRoutingCsv, &d)
+        ->ArgName("threads")
+        ->Arg(1)->Arg(hw)
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+}
+
+bool take_flag(std::string_view arg, std::string_view flag, std::string& value) {
+    if (arg.substr(0, flag.size()) != flag) return false;
+    value = std::string(arg.substr(flag.size()));
+    return true;
+}
+
+} // end of anonymous namespace
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+
+    std::vector<std::size_t> sizes = {2000, 20000, 100000};
+    std::string caida = "../data/20250901.as-rel2.txt";
+    for (int i = 1; i < argc; ++i) {
+        std::string value;
+        if (take_flag(argv[i], "--ases=", value)) {
+            sizes.clear();
+            std::stringstream ss(value);
+            for (std::string item; std::getline(ss, item, ',');)
+                sizes.push_back(std::stoul(item));
+        } else if (take_flag(argv[i], "--caida=", value)) {
+            caida = value;
+        } else if (take_flag(argv[i], "--prefixes=", value)) {
+            g_num_prefixes = std::max<std::size_t>(1, std::stoul(value));
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    for (std::size_t n : sizes)
+        register_dataset(add_synthetic(n));
+    if (std::filesystem::exists(caida))
+        register_dataset(add_caida(caida));
+    else
+        std::cerr << "[ INFO ] Missing CAIDA dataset " << caida << "; skipping it.\n";
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    for (const auto& d : g_datasets)
+        if (d->name != "caida") std::filesystem::remove(d->file);
+    return 0;
+}
@@ -1,8 +1,6 @@
 #pragma once
-#include <string>
-#include <vector>
 #include <cstdint>
-#include <utility>
+#include "path_store.hpp"
 
 enum class Relationship : uint8_t 
 {
@@ -14,33 +12,37 @@ enum class Relationship : uint8_t
 
 struct Announcement 
 {
-  std::string prefix;
-  std::vector<uint32_t> as_path;
+  uint32_t prefix_id = 0;
+  uint32_t path = kEmptyPath;   // PathStore handle, starts at next_hop_asn
+  uint32_t path_len = 1;        // full AS path length, holder included
   uint32_t next_hop_asn;
   Relationship received_from;
   bool rov_invalid = false;
 
   Announcement() = default;
   
-  Announcement(std::string p,
-               std::vector<uint32_t> path,
+  Announcement(uint32_t p,
+               uint32_t path_handle,
+               uint32_t length,
                uint32_t next_hop,
                Relationship rel,
                bool invalid = false)
-    : prefix(std::move(p)),
-      as_path(std::move(path)),
+    : prefix_id(p),
+      path(path_handle),
+      path_len(length),
       next_hop_asn(next_hop),
       received_from(rel),
       rov_invalid(invalid) {}
 
 };
 
-inline Announcement make_origin_announcement(const std::string& prefix,
+inline Announcement make_origin_announcement(uint32_t prefix_id,
                                              uint32_t asn)
 {
   Announcement a;
-  a.prefix        = prefix;
-  a.as_path       = {asn};
+  a.prefix_id     = prefix_id;
+  a.path          = kEmptyPath;
+  a.path_len      = 1;
   a.next_hop_asn  = asn;
   a.received_from = Relationship::ORIGIN;
   a.rov_invalid   = false;
@@ -66,9 +68,7 @@ inline bool better_announcement(const Announcement& a,
   const int rb = relationship_rank(b.received_from);
   if (ra != rb) return ra > rb;
 
-  const std::size_t la = a.as_path.size();
-  const std::size_t lb = b.as_path.size();
-  if (la != lb) return la < lb;
+  if (a.path_len != b.path_len) return a.path_len < b.path_len;
 
   return a.next_hop_asn < b.next_hop_asn;
 }
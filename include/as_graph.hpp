@@ -4,9 +4,12 @@
 #include <string>
 #include <stdexcept>
 #include <algorithm>
-#include <queue>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
 #include "data_record.hpp"
 #include "read_caida.hpp"
+#include "thread_pool.hpp"
 
 struct ASNode {
   std::vector<uint32_t> providers;
@@ -14,36 +17,83 @@ struct ASNode {
   std::vector<uint32_t> peers;
 };
 
+constexpr uint32_t kNoId = UINT32_MAX;
+
+// Nodes are indexed by dense ids rather than by ASN, so memory scales with
+// the number of ASes actually present.  Id 0 is a reserved sentinel; ids are
+// handed out in first-seen order.  Neighbor lists, ranks and layers all hold
+// ids; asn_of()/id_of() translate at the edges.
 class ASGraph {
   std::vector<ASNode> nodes;
+  std::vector<uint32_t> asns;                  // id -> ASN
+  std::unordered_map<uint32_t, uint32_t> ids;  // ASN -> id, beyond identity_
+  uint32_t identity_ = 0;                      // ASNs 1..identity_ map to themselves
+
+  uint32_t intern(uint32_t asn) {
+    if (asn != 0 && asn <= identity_) return asn;
+
+    auto it = ids.find(asn);
+    if (it != ids.end()) return it->second;
+
+    const uint32_t id = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    asns.push_back(asn);
+    ids.emplace(asn, id);
+    return id;
+  }
 
 public:
-  explicit ASGraph(size_t max_asn = 100000)
-    : nodes(max_asn + 1) {}
+  ASGraph() : nodes(1), asns(1, 0) {}
+
+  // Reserves ASNs 1..max_asn with id == ASN.  Handy for small hand-built
+  // graphs; loaders should use the default constructor.
+  explicit ASGraph(size_t max_asn)
+    : nodes(max_asn + 1),
+      asns(max_asn + 1),
+      identity_(static_cast<uint32_t>(max_asn))
+  {
+    for (uint32_t asn = 0; asn <= identity_; ++asn)
+      asns[asn] = asn;
+  }
 
-  inline void add_provider_customer(uint32_t provider, const uint32_t customer) noexcept {
-    if (provider >= nodes.size() || customer >= nodes.size()) return;
-    nodes[provider].customers.push_back(customer);
-    nodes[customer].providers.push_back(provider);
+  inline void add_provider_customer(uint32_t provider, const uint32_t customer) {
+    const uint32_t p = intern(provider);
+    const uint32_t c = intern(customer);
+    nodes[p].customers.push_back(c);
+    nodes[c].providers.push_back(p);
   }
 
-  inline void add_peer(uint32_t a, uint32_t b) noexcept {
-    if (a >= nodes.size() || b >= nodes.size()) return;
-    nodes[a].peers.push_back(b);
-    nodes[b].peers.push_back(a);
+  inline void add_peer(uint32_t a, uint32_t b) {
+    const uint32_t ia = intern(a);
+    const uint32_t ib = intern(b);
+    nodes[ia].peers.push_back(ib);
+    nodes[ib].peers.push_back(ia);
   }
 
-  inline const ASNode& get(uint32_t asn) const noexcept {
-    return nodes[asn];
+  inline const ASNode& get(uint32_t id) const noexcept {
+    return nodes[id];
   }
 
+  // number of ids, sentinel included
   inline size_t size() const noexcept {
     return nodes.size();
   }
+
+  inline uint32_t asn_of(uint32_t id) const noexcept {
+    return asns[id];
+  }
+
+  inline uint32_t id_of(uint32_t asn) const noexcept {
+    if (asn != 0 && asn <= identity_) return asn;
+    auto it = ids.find(asn);
+    return it == ids.end() ? kNoId : it->second;
+  }
 };
 
+// Single pass over a memory-mapped relationships file; ids are assigned as
+// ASNs appear, so no max-ASN pre-scan is needed.
 inline void build_graph(const std::string& filename, ASGraph& graph) {
-  read_caida_data(filename, [&](const DataRecord& rec) {
+  read_caida_mapped(filename, [&](const DataRecord& rec) {
     if (rec.indicator == -1) {
       graph.add_provider_customer(rec.provider_peer, rec.customer_peer);
     }
@@ -56,130 +106,196 @@ inline void build_graph(const std::string& filename, ASGraph& graph) {
   });
 }
 
-enum VisitState : uint8_t {
-  UNVISITED = 0,
-  ACTIVE    = 1,
-  FINISHED  = 2
-};
-
-namespace detail {
-
-inline bool dfs_has_cycle(uint32_t u,
-                          const ASGraph& graph,
-                          std::vector<VisitState>& state)
+// Thrown when the provider/customer relation has a cycle; cycle_asns() holds
+// one such cycle in provider -> customer order, without repeating the first
+// ASN at the end.
+class ProviderCycleError : public std::runtime_error
 {
-  state[u] = ACTIVE;
+  std::vector<uint32_t> asns_;
 
-  for (uint32_t customer : graph.get(u).customers) {
-    if (state[customer] == ACTIVE) {
-      return true;
-    }
-    if (state[customer] == UNVISITED) {
-      if (dfs_has_cycle(customer, graph, state)) {
-        return true;
-      }
-    }
+  static std::string describe(const std::vector<uint32_t>& asns)
+  {
+    std::string msg = "Provider/customer cycle detected in AS graph:";
+    for (uint32_t asn : asns) msg += " " + std::to_string(asn) + " ->";
+    msg += " " + std::to_string(asns.front());
+    return msg;
   }
 
-  state[u] = FINISHED;
-  return false;
-}
+public:
+  explicit ProviderCycleError(std::vector<uint32_t> asns)
+    : std::runtime_error(describe(asns)), asns_(std::move(asns)) {}
 
-} // end of namespace detail
+  const std::vector<uint32_t>& cycle_asns() const noexcept
+  {
+    return asns_;
+  }
+};
 
-inline bool has_provider_cycle(const ASGraph& graph)
+// Ranks of every id plus, if the graph is not acyclic, one provider cycle.
+struct RankResult
 {
-  std::vector<VisitState> state(graph.size(), UNVISITED);
+  std::vector<int> ranks;       // -1 for ids on or above a cycle
+  std::vector<uint32_t> cycle;  // ASNs, empty when acyclic
 
-  for (uint32_t asn = 1; asn < graph.size(); ++asn) {
-    if (state[asn] == UNVISITED) {
-      if (detail::dfs_has_cycle(asn, graph, state)) {
-        return true;
-      }
-    }
+  bool acyclic() const noexcept
+  {
+    return cycle.empty();
   }
-  return false;
-}
+};
 
-inline void assert_provider_acyclic(const ASGraph& graph)
+namespace detail {
+
+// Every unranked id has an unranked customer (otherwise the frontier would
+// have reached it), so following unranked customers from any of them must
+// come back to an id already on the walk.
+template <typename Graph>
+std::vector<uint32_t> find_unranked_cycle(const Graph& graph,
+                                          const std::vector<int>& rank)
 {
-  if (has_provider_cycle(graph)) {
-    throw std::runtime_error("Provider/customer cycle detected in AS graph");
+  const std::size_t n = graph.size();
+  uint32_t start = 0;
+  for (uint32_t id = 1; id < n && !start; ++id)
+    if (rank[id] < 0) start = id;
+  if (!start) return {};
+
+  std::vector<uint32_t> step(n, kNoId);   // position on the walk
+  std::vector<uint32_t> walk;
+  uint32_t u = start;
+  while (step[u] == kNoId)
+  {
+    step[u] = static_cast<uint32_t>(walk.size());
+    walk.push_back(u);
+    for (uint32_t customer : graph.get(u).customers)
+      if (rank[customer] < 0)
+      {
+        u = customer;
+        break;
+      }
   }
+
+  std::vector<uint32_t> cycle;
+  for (std::size_t i = step[u]; i < walk.size(); ++i)
+    cycle.push_back(graph.asn_of(walk[i]));
+  return cycle;
 }
 
-inline std::vector<int> compute_propagation_ranks(const ASGraph& graph)
+} // end of namespace detail
+
+// One iterative pass that ranks every id and checks for provider cycles.
+// Level-synchronous Kahn's algorithm: stubs form frontier 0, and an id joins
+// frontier r + 1 once its last customer has been ranked, so its rank is the
+// length of its longest customer chain.  With a pool the frontier is
+// expanded in parallel; ranks do not depend on the number of threads.
+template <typename Graph>
+RankResult rank_providers(const Graph& graph, ThreadPool* pool = nullptr)
 {
   const std::size_t n = graph.size();
-  std::vector<int> rank(n, -1);
+  RankResult result;
+  result.ranks.assign(n, -1);
+  std::vector<int>& rank = result.ranks;
 
-  std::vector<uint32_t> remaining_children(n, 0);
-  for (uint32_t asn = 1; asn < n; ++asn)
+  const bool parallel = pool && pool->size() > 1;
+  std::unique_ptr<std::atomic<uint32_t>[]> remaining(new std::atomic<uint32_t>[n]);
+  std::vector<uint32_t> frontier;
+  for (uint32_t id = 1; id < n; ++id)
   {
-    remaining_children[asn] =
-      static_cast<uint32_t>(graph.get(asn).customers.size());
+    const auto customers = static_cast<uint32_t>(graph.get(id).customers.size());
+    remaining[id].store(customers, std::memory_order_relaxed);
+    if (customers == 0) frontier.push_back(id);
   }
 
-  std::queue<uint32_t> q;
-  for (uint32_t asn = 1; asn < n; ++asn)
+  constexpr std::size_t kGrain = 1024;
+  std::vector<std::vector<uint32_t>> next(parallel ? pool->size() : 1);
+  for (int r = 0; !frontier.empty(); ++r)
   {
-    if (remaining_children[asn] == 0)
+    auto expand = [&](std::size_t begin, std::size_t end, unsigned w) {
+      for (std::size_t i = begin; i < end; ++i)
+      {
+        const uint32_t u = frontier[i];
+        rank[u] = r;
+        for (uint32_t provider : graph.get(u).providers)
+        {
+          // the serial pass owns the counters and needs no atomic RMW
+          const uint32_t left = parallel
+            ? remaining[provider].fetch_sub(1, std::memory_order_relaxed) - 1
+            : remaining[provider].load(std::memory_order_relaxed) - 1;
+          if (!parallel) remaining[provider].store(left, std::memory_order_relaxed);
+          if (left == 0) next[w].push_back(provider);
+        }
+      }
+    };
+    if (parallel)
+      pool->parallel_for(frontier.size(), kGrain, expand);
+    else
+      expand(0, frontier.size(), 0);
+
+    frontier.clear();
+    for (auto& part : next)
     {
-      rank[asn] = 0;
-      q.push(asn);
+      frontier.insert(frontier.end(), part.begin(), part.end());
+      part.clear();
     }
   }
 
-  while (!q.empty())
-  {
-    uint32_t u = q.front();
-    q.pop();
-    const int r_u = rank[u];
+  result.cycle = detail::find_unranked_cycle(graph, rank);
+  return result;
+}
 
-    for (uint32_t provider : graph.get(u).providers)
-    {
-      if (rank[provider] < r_u + 1)
-        rank[provider] = r_u + 1;
-      if (remaining_children[provider] > 0)
-      {
-        --remaining_children[provider];
-        if (remaining_children[provider] == 0)
-          q.push(provider);
-      }
-    }
-  }
+template <typename Graph>
+std::vector<uint32_t> find_provider_cycle(const Graph& graph)
+{
+  return rank_providers(graph).cycle;
+}
 
-  for (uint32_t asn = 1; asn < n; ++asn)
-  {
-    if (remaining_children[asn] != 0)
-      throw std::runtime_error("compute_propogation_ranks: provider/customer cycle detected");
-  }
+template <typename Graph>
+bool has_provider_cycle(const Graph& graph)
+{
+  return !find_provider_cycle(graph).empty();
+}
 
-  return rank;
+template <typename Graph>
+void assert_provider_acyclic(const Graph& graph)
+{
+  auto cycle = find_provider_cycle(graph);
+  if (!cycle.empty()) throw ProviderCycleError(std::move(cycle));
 }
 
-inline std::vector<std::vector<uint32_t>> flatten_graph(const ASGraph& graph)
+// Works on ASGraph or its frozen CSRGraph form; the engines use the latter.
+// Throws ProviderCycleError if the graph has a cycle.
+template <typename Graph>
+std::vector<int> compute_propagation_ranks(const Graph& graph, ThreadPool* pool = nullptr)
 {
-  std::vector<int> rank = compute_propagation_ranks(graph);
+  RankResult result = rank_providers(graph, pool);
+  if (!result.acyclic()) throw ProviderCycleError(std::move(result.cycle));
+  return std::move(result.ranks);
+}
 
+inline std::vector<std::vector<uint32_t>> layers_from_ranks(const std::vector<int>& rank)
+{
   int max_rank = -1;
   const std::size_t n = rank.size();
-  for (uint32_t asn = 1; asn < n; ++asn)
+  for (uint32_t id = 1; id < n; ++id)
   {
-    if (rank[asn] >= 0 && rank[asn] > max_rank)
-      max_rank = rank[asn];
+    if (rank[id] >= 0 && rank[id] > max_rank)
+      max_rank = rank[id];
   }
 
   if (max_rank < 0) return {};
 
   std::vector<std::vector<uint32_t>> layers(static_cast<std::size_t>(max_rank) + 1);
 
-  for (uint32_t asn = 1; asn < n; ++asn)
+  for (uint32_t id = 1; id < n; ++id)
   {
-    int r = rank[asn];
+    int r = rank[id];
     if (r >= 0)
-      layers[static_cast<std::size_t>(r)].push_back(asn);
+      layers[static_cast<std::size_t>(r)].push_back(id);
   }
 
   return layers;
 }
+
+template <typename Graph>
+std::vector<std::vector<uint32_t>> flatten_graph(const Graph& graph)
+{
+  return layers_from_ranks(compute_propagation_ranks(graph));
+}
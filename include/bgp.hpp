@@ -1,78 +1,220 @@
 #pragma once
 #include <unordered_map>
 #include <vector>
-#include <string>
+#include <memory_resource>
+#include <cstddef>
 #include <cstdint>
 #include "policy.hpp"
 #include "announcement.hpp"
+#include "stats.hpp"
 
-class BGPPolicy : public Policy
+// How BGPPolicy chooses among queued candidates.  BUFFERED keeps every
+// candidate until process_pending scans them; FUSED compares each one with
+// the best so far as it is enqueued, so a prefix never holds more than one.
+// Both pick the same route.
+enum class Selection : uint8_t
 {
-protected:
+  BUFFERED,
+  FUSED
+};
+
+// The closed set of built-in policies.  BGPSim tags every AS with its kind
+// and dispatches on it statically (see visit_policy), so hot loops make no
+// virtual calls.  A new kind needs an import filter, an alias, an entry here
+// and a case in visit_policy and for_each_policy_type.
+enum class PolicyKind : uint8_t
+{
+  BGP,
+  ROV
+};
+
+constexpr std::size_t kNumPolicyKinds = 2;
+
+// Best-route selection shared by every built-in policy, parameterized on
+// its import filter:
+//
+//   struct Import
+//   {
+//     static constexpr PolicyKind kind = ...;
+//     static bool accepts(const Announcement&) noexcept;
+//   };
+template <typename Import>
+class RoutingPolicy final : public Policy
+{
+  // queued candidates, allocated from `pending` (see the constructor)
+  using ReceivedLists = std::pmr::unordered_map<uint32_t, std::pmr::vector<Announcement>>;
+  using ReceivedBest  = std::pmr::unordered_map<uint32_t, Announcement>;
+
   uint32_t asn_;
-  std::unordered_map<std::string, Announcement> local_rib_;
-  std::unordered_map<std::string, std::vector<Announcement>> received_;
+  Selection selection_;
+  std::unordered_map<uint32_t, Announcement> local_rib_;
+  ReceivedLists received_;
+  ReceivedBest best_received_;   // FUSED only
+
+  // Let go of the pending storage itself, not just its elements, so the
+  // resource may be released wholesale afterwards.
+  void drop_pending()
+  {
+    received_ = ReceivedLists(received_.get_allocator());
+    best_received_ = ReceivedBest(best_received_.get_allocator());
+  }
 
 public:
-  explicit BGPPolicy(uint32_t asn) : asn_(asn) {}
-  
+  static constexpr PolicyKind kind = Import::kind;
+
+  // Candidates waiting for process_pending live in `pending`, which BGPSim
+  // points at a PhaseArena; standalone policies use the heap.
+  explicit RoutingPolicy(uint32_t asn,
+                         Selection selection = Selection::BUFFERED,
+                         std::pmr::memory_resource* pending = std::pmr::get_default_resource())
+    : asn_(asn), selection_(selection), received_(pending), best_received_(pending) {}
+
+  Selection selection() const noexcept
+  {
+    return selection_;
+  }
+
   uint32_t asn() const noexcept override
   {
     return asn_;
   }
-  
+
   void enqueue(const Announcement& ann) override
   {
-    received_[ann.prefix].push_back(ann);
+    BGPSIM_COUNT(enqueued);
+    if (!Import::accepts(ann))
+    {
+      BGPSIM_COUNT(dropped);
+      return;
+    }
+    if (selection_ == Selection::BUFFERED)
+    {
+      received_[ann.prefix_id].push_back(ann);
+      return;
+    }
+
+    // ties keep the earlier candidate, as the buffered scan does
+    auto ins = best_received_.try_emplace(ann.prefix_id, ann);
+    if (!ins.second && better_announcement(ann, ins.first->second))
+      ins.first->second = ann;
+  }
+
+  bool accepts(const Announcement& ann) const override
+  {
+    return Import::accepts(ann);
+  }
+
+  bool adopt(const Announcement& ann) override
+  {
+    auto it = local_rib_.find(ann.prefix_id);
+    if (it == local_rib_.end())
+      local_rib_.emplace(ann.prefix_id, ann);
+    else if (better_announcement(ann, it->second))
+    {
+      it->second = ann;
+      BGPSIM_COUNT(replaced);
+    }
+    else
+      return false;
+    BGPSIM_COUNT(installed);
+    return true;
   }
-  
+
   bool has_pending() const override
   {
+    if (!best_received_.empty()) return true;
     for (const auto& kv : received_)
       if (!kv.second.empty()) return true;
     return false;
   }
-  
+
   void process_pending() override
   {
     for (auto& kv : received_)
     {
-      const std::string& prefix = kv.first;
-      std::vector<Announcement>& candidates = kv.second;
+      const auto& candidates = kv.second;
       if (candidates.empty()) continue;
 
-      Announcement best = candidates[0];
+      const Announcement* best = &candidates[0];
       for (std::size_t i = 1; i < candidates.size(); ++i)
-        if (better_announcement(candidates[i], best))
-          best = candidates[i];
-
-      auto it = local_rib_.find(prefix);
-      if (it == local_rib_.end())
-        local_rib_[prefix] = std::move(best);
-      else
-        if (better_announcement(best, it->second))
-          it->second = std::move(best);
+        if (better_announcement(candidates[i], *best))
+          best = &candidates[i];
+      adopt(*best);
     }
 
-    received_.clear();
+    for (const auto& kv : best_received_)
+      adopt(kv.second);
+
+    drop_pending();
   }
-  
-  const std::unordered_map<std::string, Announcement>& local_rib() const override
+
+  const std::unordered_map<uint32_t, Announcement>& local_rib() const override
   {
     return local_rib_;
   }
 
+  void withdraw(uint32_t prefix_id) override
+  {
+    local_rib_.erase(prefix_id);
+  }
+
+  void release_rib() override
+  {
+    std::unordered_map<uint32_t, Announcement>().swap(local_rib_);
+  }
+
+  void reset() override
+  {
+    local_rib_.clear();
+    drop_pending();
+  }
+
 };
 
 
-class ROVPolicy : public BGPPolicy
+struct AcceptAll
 {
-public:
-  explicit ROVPolicy(uint32_t asn) : BGPPolicy(asn) {}
+  static constexpr PolicyKind kind = PolicyKind::BGP;
 
-  void enqueue(const Announcement& ann) override
+  static bool accepts(const Announcement&) noexcept
+  {
+    return true;
+  }
+};
+
+struct DropRovInvalid
+{
+  static constexpr PolicyKind kind = PolicyKind::ROV;
+
+  static bool accepts(const Announcement& ann) noexcept
   {
-    if (ann.rov_invalid) return;
-    BGPPolicy::enqueue(ann);
+    return !ann.rov_invalid;
   }
 };
+
+using BGPPolicy = RoutingPolicy<AcceptAll>;
+using ROVPolicy = RoutingPolicy<DropRovInvalid>;
+
+// fn(pol) with `pol` cast to the concrete type of `kind`, so every call fn
+// makes on it binds at compile time.
+template <typename Fn>
+decltype(auto) visit_policy(PolicyKind kind, Policy& pol, Fn&& fn)
+{
+  if (kind == PolicyKind::ROV) return fn(static_cast<ROVPolicy&>(pol));
+  return fn(static_cast<BGPPolicy&>(pol));
+}
+
+template <typename Fn>
+decltype(auto) visit_policy(PolicyKind kind, const Policy& pol, Fn&& fn)
+{
+  if (kind == PolicyKind::ROV) return fn(static_cast<const ROVPolicy&>(pol));
+  return fn(static_cast<const BGPPolicy&>(pol));
+}
+
+// fn(tag) once per built-in policy type, tag being a null pointer to it
+template <typename Fn>
+void for_each_policy_type(Fn&& fn)
+{
+  fn(static_cast<BGPPolicy*>(nullptr));
+  fn(static_cast<ROVPolicy*>(nullptr));
+}
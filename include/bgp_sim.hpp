@@ -1,31 +1,49 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <cstdint>
 #include <stdexcept>
 #include <memory>
-#include <unordered_set>
+#include <iterator>
+#include <array>
+#include <type_traits>
+#include <queue>
+#include <functional>
+#include <utility>
+#include <algorithm>
 
 #include "as_graph.hpp"
+#include "topology.hpp"
 #include "bgp.hpp"
 #include "announcement.hpp"
+#include "prefix_table.hpp"
+#include "thread_pool.hpp"
+#include "phase_arena.hpp"
+#include "stats.hpp"
+#include "seed.hpp"
+
+// How announcements move between neighbors.  PUSH has senders enqueue
+// copies into each receiver's pending queue; PULL has each receiver scan its
+// neighbors' RIBs and keep a running best, with no per-candidate storage.
+enum class Strategy : uint8_t
+{
+  PUSH,
+  PULL
+};
 
 class BGPSim
 {
   static Announcement make_forwarded(const Announcement& base,
                                      uint32_t from_asn,
-                                     uint32_t to_asn,
+                                     uint32_t forwarded_path,
                                      Relationship rel_at_receiver)
   {
     Announcement out;
-    out.prefix = base.prefix;
-
-    out.as_path.reserve(base.as_path.size() + 1);
-    out.as_path.push_back(to_asn);
-    out.as_path.insert(out.as_path.end(),
-                       base.as_path.begin(),
-                       base.as_path.end());
-
+    out.prefix_id     = base.prefix_id;
+    out.path          = forwarded_path;
+    out.path_len      = base.path_len + 1;
     out.next_hop_asn  = from_asn;
     out.received_from = rel_at_receiver;
     out.rov_invalid   = base.rov_invalid;
@@ -33,43 +51,839 @@ class BGPSim
     return out;
   }
 
-  const ASGraph& graph_;
+  std::shared_ptr<const Topology> topo_;
+  const CSRGraph& graph_;
+  const std::vector<std::vector<uint32_t>>& layers_;
   std::vector<std::unique_ptr<Policy>> policies_;
-  std::vector<std::vector<uint32_t>> layers_;
+  PrefixTable prefixes_;
+  PathStore paths_;
+
+  // parallel mode: one outbox per (sending worker, owning worker) pair;
+  // receiver `id` is owned by worker id % threads so delivery never races
+  using Outbox = std::vector<std::pair<uint32_t, Announcement>>;
+  std::unique_ptr<ThreadPool> pool_;
+  std::vector<std::vector<Outbox>> outboxes_;
+  std::vector<PathStore::Block> blocks_;
+
+  // running best per prefix for one receiver; reset in O(touched)
+  struct PullScratch
+  {
+    std::vector<Announcement> best;
+    std::vector<uint8_t> seen;
+    std::vector<uint32_t> touched;
+  };
+
+  Strategy strategy_ = Strategy::PUSH;
+  Selection selection_ = Selection::FUSED;
+  std::vector<PullScratch> scratch_;
+  std::vector<std::vector<Announcement>> staged_;   // peer phase, PULL only
+
+  // ids whose RIB may hold routes, so reset() is O(touched); each worker
+  // records the ids it processed
+  std::vector<uint8_t> dirty_;
+  std::vector<std::vector<uint32_t>> touched_;
+
+  // kind_[id] names the concrete type of policies_[id]; rov_ids_ lists the
+  // ROV ids in order
+  std::vector<PolicyKind> kind_;
+  std::vector<uint32_t> rov_ids_;
+
+  // each layer's ids grouped by policy kind, so layer sweeps run one loop
+  // instantiation per kind: kind k occupies ids[offset[k], offset[k + 1])
+  struct KindLayer
+  {
+    std::vector<uint32_t> ids;
+    std::array<std::size_t, kNumPolicyKinds + 1> offset{};
+  };
+  std::vector<KindLayer> kind_layers_;
+
+  // every seed, by prefix id, so single prefixes can be recomputed
+  struct Origination
+  {
+    uint32_t id;
+    bool rov_invalid;
+  };
+  std::vector<std::vector<Origination>> origins_;
+
+  // membership flags for the region an incremental update recomputes
+  std::vector<uint8_t> region_;
+
+#if BGPSIM_STATS
+  // per-phase statistics, gathered only after set_collect_stats(true)
+  struct alignas(64) ActiveCount
+  {
+    uint64_t n = 0;
+  };
+  bool collect_stats_ = false;
+  std::vector<PhaseStats> stats_;
+  std::vector<PropagationCounters> phase_start_;
+  std::vector<ActiveCount> active_;
+  StatsTimer phase_timer_;
+#endif
+
+  // layers smaller than this are not worth waking the pool for
+  static constexpr std::size_t kParallelMinLayer = 256;
+  static constexpr std::size_t kParallelGrain    = 64;
+  // stubs pulled, reported and released together by propagate_down_streaming
+  static constexpr std::size_t kStreamChunk      = 512;
+
+  using Neighbors = NeighborRange (CSRGraph::*)(uint32_t) const noexcept;
+  using RIB = std::unordered_map<uint32_t, Announcement>;
+
+  uint32_t id_or_throw(uint32_t asn) const
+  {
+    const uint32_t id = graph_.id_of(asn);
+    if (id == kNoId)
+      throw std::out_of_range("BGPSim: ASN not in graph");
+    return id;
+  }
+
+  // the policy of graph id `id`; its queued candidates live in the arena of
+  // its rank layer
+  std::unique_ptr<Policy> make_policy(uint32_t id, PolicyKind kind) const
+  {
+    const uint32_t asn = id ? graph_.asn_of(id) : 0;
+    const int rank = topo_->ranks[id];
+    std::pmr::memory_resource* pending =
+      &PhaseArena::for_layer(rank > 0 ? static_cast<std::size_t>(rank) : 0);
+    if (kind == PolicyKind::ROV)
+      return std::make_unique<ROVPolicy>(asn, selection_, pending);
+    return std::make_unique<BGPPolicy>(asn, selection_, pending);
+  }
+
+  // fn(pol) with policies_[id] as its concrete type
+  template <typename Fn>
+  decltype(auto) visit(uint32_t id, Fn&& fn)
+  {
+    return visit_policy(kind_[id], *policies_[id], std::forward<Fn>(fn));
+  }
+
+  template <typename Fn>
+  decltype(auto) visit(uint32_t id, Fn&& fn) const
+  {
+    return visit_policy(kind_[id], const_cast<const Policy&>(*policies_[id]),
+                        std::forward<Fn>(fn));
+  }
+
+  void group_layer(std::size_t r)
+  {
+    KindLayer& kl = kind_layers_[r];
+    kl.offset.fill(0);
+    for (uint32_t id : layers_[r])
+      ++kl.offset[static_cast<std::size_t>(kind_[id]) + 1];
+    for (std::size_t k = 0; k < kNumPolicyKinds; ++k)
+      kl.offset[k + 1] += kl.offset[k];
+
+    std::array<std::size_t, kNumPolicyKinds + 1> next = kl.offset;
+    kl.ids.resize(layers_[r].size());
+    for (uint32_t id : layers_[r])
+      kl.ids[next[static_cast<std::size_t>(kind_[id])]++] = id;
+  }
+
+  void mark_touched(uint32_t id, unsigned worker)
+  {
+    if (dirty_[id]) return;
+    dirty_[id] = 1;
+    touched_[worker].push_back(id);
+  }
+
+  // Swap policies only for ASes whose ROV status changes.
+  void assign_rov(const std::vector<uint32_t>& rov_asns)
+  {
+    std::vector<uint32_t> wanted;
+    for (uint32_t asn : rov_asns)
+    {
+      const uint32_t id = graph_.id_of(asn);
+      if (id != kNoId) wanted.push_back(id);
+    }
+    std::sort(wanted.begin(), wanted.end());
+    wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+    std::vector<uint8_t> regroup(layers_.size(), 0);
+    std::vector<uint32_t> affected;
+    std::set_union(rov_ids_.begin(), rov_ids_.end(),
+                   wanted.begin(), wanted.end(), std::back_inserter(affected));
+    for (uint32_t id : affected)
+    {
+      const PolicyKind want =
+        std::binary_search(wanted.begin(), wanted.end(), id) ? PolicyKind::ROV
+                                                             : PolicyKind::BGP;
+      if (want == kind_[id]) continue;
+
+      policies_[id] = make_policy(id, want);
+      kind_[id] = want;
+      regroup[static_cast<std::size_t>(topo_->ranks[id])] = 1;
+    }
+    rov_ids_ = std::move(wanted);
+
+    for (std::size_t r = 0; r < layers_.size(); ++r)
+      if (regroup[r]) group_layer(r);
+  }
+
+  bool parallel_for_layer(std::size_t layer_size) const noexcept
+  {
+    return pool_ && layer_size >= kParallelMinLayer;
+  }
+
+  // Forward every route held by `id` to its `neighbors`, handing each
+  // forwarded announcement to sink(receiver_id, announcement).  With
+  // skip_stubs, rank-0 neighbors (first in every rank-ordered list) are left
+  // out.
+  template <typename P, typename Sink>
+  void forward_routes(const P& pol, uint32_t id, Neighbors neighbors,
+                      Relationship rel, bool skip_stubs,
+                      PathStore::Block& block, Sink&& sink)
+  {
+    NeighborRange targets = (graph_.*neighbors)(id);
+    if (skip_stubs)
+      targets.first = std::partition_point(targets.first, targets.last,
+        [&](uint32_t to) { return topo_->ranks[to] == 0; });
+    const auto& rib = pol.local_rib();
+    if (rib.empty() || targets.empty()) return;
+
+    const uint32_t asn = graph_.asn_of(id);
+    for (const auto& kv : rib)
+    {
+      const Announcement& ann = kv.second;
+      const uint32_t fwd_path = paths_.append(block, asn, ann.path);
+      for (uint32_t to : targets)
+        sink(to, make_forwarded(ann, asn, fwd_path, rel));
+    }
+  }
+
+  void send_layer(std::size_t r, Neighbors neighbors, Relationship rel,
+                  bool skip_stubs = false)
+  {
+    if (!parallel_for_layer(layers_[r].size()))
+    {
+      for_each_in_layer(r, [&](const auto& pol, uint32_t id, unsigned) {
+        forward_routes(pol, id, neighbors, rel, skip_stubs, blocks_[0],
+                       [&](uint32_t to, const Announcement& ann) {
+                         visit(to, [&](auto& receiver) { receiver.enqueue(ann); });
+                       });
+      });
+      return;
+    }
+
+    const unsigned workers = pool_->size();
+    for_each_in_layer(r, [&](const auto& pol, uint32_t id, unsigned w) {
+      std::vector<Outbox>& bins = outboxes_[w];
+      forward_routes(pol, id, neighbors, rel, skip_stubs, blocks_[w],
+                     [&](uint32_t to, const Announcement& ann) {
+                       bins[to % workers].emplace_back(to, ann);
+                     });
+    });
+
+    pool_->parallel_for(workers, 1,
+      [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t owner = begin; owner < end; ++owner)
+          for (unsigned src = 0; src < workers; ++src)
+          {
+            Outbox& box = outboxes_[src][owner];
+            for (const auto& item : box)
+              visit(item.first, [&](auto& receiver) { receiver.enqueue(item.second); });
+            box.clear();
+          }
+      });
+  }
+
+  // fn(pol, id, worker) for every id of layer r, `pol` being policies_[id]
+  // as its concrete type.  Threaded when worthwhile; a chunk runs one loop
+  // per kind it overlaps.
+  template <typename Fn>
+  void for_each_in_layer(std::size_t r, Fn&& fn)
+  {
+    for_each_in_range(r, 0, kind_layers_[r].ids.size(), std::forward<Fn>(fn));
+  }
+
+  // for_each_in_layer over positions [first, last) of the layer's
+  // kind-grouped ids
+  template <typename Fn>
+  void for_each_in_range(std::size_t r, std::size_t first, std::size_t last, Fn&& fn)
+  {
+    const KindLayer& kl = kind_layers_[r];
+    auto run = [&](std::size_t begin, std::size_t end, unsigned w) {
+      for_each_policy_type([&](auto* tag) {
+        using P = std::remove_pointer_t<decltype(tag)>;
+        const std::size_t k = static_cast<std::size_t>(P::kind);
+        const std::size_t lo = std::max(begin, kl.offset[k]);
+        const std::size_t hi = std::min(end, kl.offset[k + 1]);
+        for (std::size_t i = lo; i < hi; ++i)
+        {
+          const uint32_t id = kl.ids[i];
+          fn(static_cast<P&>(*policies_[id]), id, w);
+        }
+      });
+    };
+
+    const std::size_t n = last - first;
+    if (!parallel_for_layer(n))
+      run(first, last, 0u);
+    else
+      pool_->parallel_for(n, kParallelGrain,
+        [&](std::size_t begin, std::size_t end, unsigned w) {
+          run(first + begin, first + end, w);
+        });
+  }
+
+  void process_layer(std::size_t r)
+  {
+    for_each_in_layer(r, [&](auto& pol, uint32_t id, unsigned w) {
+      if (pol.has_pending())
+      {
+        pol.process_pending();
+        mark_touched(id, w);
+        count_active(w);
+      }
+    });
+    release_layer_memory(r);
+    end_layer(r);
+  }
+
+  // Scan the RIBs of `id`'s neighbors and hand the best acceptable candidate
+  // per prefix to sink(candidate).  Candidates carry the sender's path as
+  // their parent; the sender's node is only appended once a route is kept.
+  template <typename P, typename Sink>
+  void pull_routes(const P& self, uint32_t id, Neighbors neighbors,
+                   Relationship rel, PullScratch& sc, Sink&& sink)
+  {
+    if (sc.best.size() < prefixes_.size())
+    {
+      sc.best.resize(prefixes_.size());
+      sc.seen.resize(prefixes_.size(), 0);
+    }
+
+    for (uint32_t from : (graph_.*neighbors)(id))
+    {
+      const auto& rib = visit(from, [](const auto& sender) -> const RIB& {
+        return sender.local_rib();
+      });
+      if (rib.empty()) continue;
+
+      const uint32_t from_asn = graph_.asn_of(from);
+      for (const auto& kv : rib)
+      {
+        Announcement cand = make_forwarded(kv.second, from_asn,
+                                           kv.second.path, rel);
+        BGPSIM_COUNT(enqueued);
+        if (!self.accepts(cand))
+        {
+          BGPSIM_COUNT(dropped);
+          continue;
+        }
+
+        const uint32_t p = cand.prefix_id;
+        if (!sc.seen[p])
+        {
+          sc.seen[p] = 1;
+          sc.best[p] = cand;
+          sc.touched.push_back(p);
+        }
+        else if (better_announcement(cand, sc.best[p]))
+          sc.best[p] = cand;
+      }
+    }
+
+    for (uint32_t p : sc.touched)
+    {
+      sink(sc.best[p]);
+      sc.seen[p] = 0;
+    }
+    sc.touched.clear();
+  }
+
+  // install a pulled candidate, materializing its sender's path node
+  template <typename P>
+  void adopt_pulled(P& pol, uint32_t id, Announcement cand, unsigned worker)
+  {
+    const auto& rib = pol.local_rib();
+    auto it = rib.find(cand.prefix_id);
+    if (it != rib.end() && !better_announcement(cand, it->second)) return;
+
+    cand.path = paths_.append(blocks_[worker], cand.next_hop_asn, cand.path);
+    pol.adopt(cand);
+    mark_touched(id, worker);
+  }
+
+  template <typename P>
+  void pull_into(P& pol, uint32_t id, Neighbors neighbors, Relationship rel,
+                 unsigned worker)
+  {
+    bool active = false;
+    pull_routes(pol, id, neighbors, rel, scratch_[worker],
+                [&](const Announcement& cand) {
+                  adopt_pulled(pol, id, cand, worker);
+                  active = true;
+                });
+    if (active) count_active(worker);
+  }
+
+  void pull_layer(std::size_t r, Neighbors neighbors, Relationship rel)
+  {
+    for_each_in_layer(r, [&](auto& pol, uint32_t id, unsigned w) {
+      pull_into(pol, id, neighbors, rel, w);
+    });
+    end_layer(r);
+  }
+
+  // ---------- statistics (no-ops unless collecting) ----------
+
+#if BGPSIM_STATS
+  // thread_counters() of every worker, indexed by worker
+  std::vector<PropagationCounters> worker_counters()
+  {
+    if (!pool_) return {thread_counters()};
+    std::vector<PropagationCounters> out(pool_->size());
+    pool_->run([&](unsigned w) { out[w] = thread_counters(); });
+    return out;
+  }
+#endif
+
+  void begin_phase(const char* name)
+  {
+#if BGPSIM_STATS
+    if (!collect_stats_) return;
+    stats_.emplace_back();
+    stats_.back().name = name;
+    phase_start_ = worker_counters();
+    active_.assign(num_threads(), ActiveCount{});
+    phase_timer_ = StatsTimer();
+#else
+    (void)name;
+#endif
+  }
+
+  void end_phase()
+  {
+#if BGPSIM_STATS
+    if (!collect_stats_) return;
+    PhaseStats& ps = stats_.back();
+    ps.seconds = phase_timer_.seconds();
+
+    const std::vector<PropagationCounters> now = worker_counters();
+    ps.per_thread.resize(now.size());
+    for (std::size_t w = 0; w < now.size(); ++w)
+    {
+      ps.per_thread[w] = now[w] - phase_start_[w];
+      ps.total += ps.per_thread[w];
+    }
+
+    for (uint32_t id = 1; id < policies_.size(); ++id)
+    {
+      const uint64_t size = policies_[id]->local_rib().size();
+      ps.rib_entries += size;
+      ps.max_rib = std::max(ps.max_rib, size);
+    }
+#endif
+  }
+
+  void count_active(unsigned worker)
+  {
+#if BGPSIM_STATS
+    if (collect_stats_) ++active_[worker].n;
+#else
+    (void)worker;
+#endif
+  }
+
+  void end_layer(std::size_t r)
+  {
+#if BGPSIM_STATS
+    if (!collect_stats_) return;
+    uint64_t active = 0;
+    for (ActiveCount& a : active_)
+    {
+      active += a.n;
+      a.n = 0;
+    }
+    stats_.back().layers.push_back(LayerStats{r, layers_[r].size(), active});
+#else
+    (void)r;
+#endif
+  }
+
+  // brackets one public propagation call
+  class PhaseScope
+  {
+    BGPSim& sim_;
+
+  public:
+    PhaseScope(BGPSim& sim, const char* name) : sim_(sim)
+    {
+      sim_.begin_phase(name);
+    }
+
+    ~PhaseScope()
+    {
+      sim_.end_phase();
+    }
+  };
+
+  // Every worker may have queued candidates for layer r while sending, so
+  // each releases its own buffer once the layer has processed them.
+  void release_layer_memory(std::size_t r)
+  {
+    if (pool_) pool_->run([r](unsigned) { PhaseArena::release_local(r); });
+    else       PhaseArena::release_local(r);
+  }
+
+  // whatever seeding queued at layers no phase processes
+  void release_phase_memory()
+  {
+    if (pool_) pool_->run([](unsigned) { PhaseArena::release_local(); });
+    else       PhaseArena::release_local();
+  }
+
+  template <typename Fn>
+  void release_ribs(const std::vector<uint32_t>& ids, Fn& on_final)
+  {
+    if (ids.empty()) return;
+    on_final(ids);
+    for (uint32_t id : ids)
+      policies_[id]->release_rib();
+  }
+
+  // ---------- incremental updates ----------
+
+  // routes an AS holds after the up phase, the only ones peers may use
+  static bool up_phase_route(const Announcement& ann) noexcept
+  {
+    return ann.received_from == Relationship::ORIGIN ||
+           ann.received_from == Relationship::FROM_CUSTOMER;
+  }
+
+  const Announcement* route_of(uint32_t id, uint32_t prefix_id) const
+  {
+    const auto& rib = policies_[id]->local_rib();
+    auto it = rib.find(prefix_id);
+    return it == rib.end() ? nullptr : &it->second;
+  }
+
+  // what `id` held at the end of the up phase and of the peer phase, read
+  // back from its final route
+  const Announcement* up_state(uint32_t id, uint32_t prefix_id) const
+  {
+    const Announcement* r = route_of(id, prefix_id);
+    return r && up_phase_route(*r) ? r : nullptr;
+  }
+
+  const Announcement* peer_state(uint32_t id, uint32_t prefix_id) const
+  {
+    const Announcement* r = route_of(id, prefix_id);
+    return r && r->received_from != Relationship::FROM_PROVIDER ? r : nullptr;
+  }
+
+  // best acceptable candidate for `id` among its `neighbors`' routes; the
+  // candidate's path is still the sender's path, as in pull_routes
+  bool best_neighbor_route(uint32_t id, uint32_t prefix_id, Neighbors neighbors,
+                           Relationship rel, bool up_phase_only,
+                           Announcement& best) const
+  {
+    const Policy& self = *policies_[id];
+    bool found = false;
+    for (uint32_t from : (graph_.*neighbors)(id))
+    {
+      const Announcement* r = up_phase_only ? up_state(from, prefix_id)
+                                            : route_of(from, prefix_id);
+      if (!r) continue;
+
+      Announcement cand = make_forwarded(*r, graph_.asn_of(from), r->path, rel);
+      if (!self.accepts(cand)) continue;
+      if (!found || better_announcement(cand, best))
+      {
+        best = cand;
+        found = true;
+      }
+    }
+    return found;
+  }
+
+  // whether installing candidate `cand` would reproduce route `old`
+  bool same_route(const Announcement* old, const Announcement* cand) const
+  {
+    if (!old || !cand) return old == cand;
+    if (old->received_from != cand->received_from ||
+        old->next_hop_asn != cand->next_hop_asn ||
+        old->path_len != cand->path_len ||
+        old->rov_invalid != cand->rov_invalid)
+      return false;
+    if (cand->received_from == Relationship::ORIGIN) return true;
+    return old->path != kEmptyPath && paths_.node(old->path).parent == cand->path;
+  }
+
+  // Replace the route of `id` with `cand` (none if null) unless it equals the
+  // state `old` it is meant to supersede.  Unchanged routes keep their path
+  // handle, which is what lets neighbors see that nothing changed.
+  bool settle(uint32_t id, uint32_t prefix_id,
+              const Announcement* old, const Announcement* cand)
+  {
+    if (same_route(old, cand)) return false;
+
+    Policy& pol = *policies_[id];
+    pol.withdraw(prefix_id);
+    if (cand)
+    {
+      Announcement a = *cand;
+      if (a.received_from != Relationship::ORIGIN)
+        a.path = paths_.append(blocks_[0], a.next_hop_asn, a.path);
+      pol.adopt(a);
+    }
+    mark_touched(id, 0);
+    return true;
+  }
+
+  // Re-run the three phases for one prefix, starting from the ASes in
+  // `changed` (whose seeds or import filter changed) and spreading only to
+  // neighbors of ASes whose route actually changed.  Each phase visits ASes
+  // in rank order, so everything an AS reads is already final for that
+  // phase, exactly as in propagate_all.
+  void update_prefix(uint32_t prefix_id, const std::vector<uint32_t>& changed)
+  {
+    enum : uint8_t { kUp = 1, kPeer = 2, kDown = 4, kSeed = 8 };
+    const std::vector<int>& rank = topo_->ranks;
+    using Entry = std::pair<int, uint32_t>;
+
+    region_.resize(graph_.size(), 0);
+    std::vector<uint32_t> flagged;
+    auto flag = [&](uint32_t id, uint8_t bit) {
+      if (region_[id] & bit) return false;
+      if (!region_[id]) flagged.push_back(id);
+      region_[id] |= bit;
+      return true;
+    };
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> up;
+    std::priority_queue<Entry> down;
+    std::vector<uint32_t> peer_set;
+    auto queue_up   = [&](uint32_t id) { if (flag(id, kUp)) up.emplace(rank[id], id); };
+    auto queue_peer = [&](uint32_t id) { if (flag(id, kPeer)) peer_set.push_back(id); };
+    auto queue_down = [&](uint32_t id) { if (flag(id, kDown)) down.emplace(rank[id], id); };
+    auto seed_down  = [&](uint32_t id) { flag(id, kSeed); queue_down(id); };
+
+    for (uint32_t id : changed)
+    {
+      queue_up(id);
+      queue_peer(id);
+      seed_down(id);
+    }
+
+    Announcement best;
+    while (!up.empty())
+    {
+      const uint32_t id = up.top().second;
+      up.pop();
+
+      bool found = best_neighbor_route(id, prefix_id, &CSRGraph::customers,
+                                       Relationship::FROM_CUSTOMER, true, best);
+      for (const Origination& o : origins_[prefix_id])
+      {
+        if (o.id != id) continue;
+        Announcement a = make_origin_announcement(prefix_id, graph_.asn_of(id));
+        a.rov_invalid = o.rov_invalid;
+        if (policies_[id]->accepts(a) && (!found || better_announcement(a, best)))
+        {
+          best = a;
+          found = true;
+        }
+      }
+
+      if (!settle(id, prefix_id, up_state(id, prefix_id), found ? &best : nullptr))
+        continue;
+      for (uint32_t p : graph_.providers(id)) queue_up(p);
+      for (uint32_t p : graph_.peers(id))     queue_peer(p);
+      queue_peer(id);
+      seed_down(id);
+    }
+
+    // a peer route only matters where the up phase left nothing, and peers
+    // only read up-phase routes, so installs here never feed each other
+    for (uint32_t id : peer_set)
+    {
+      if (up_state(id, prefix_id)) continue;
+      const bool found = best_neighbor_route(id, prefix_id, &CSRGraph::peers,
+                                             Relationship::FROM_PEER, true, best);
+      if (settle(id, prefix_id, peer_state(id, prefix_id), found ? &best : nullptr))
+        seed_down(id);
+    }
+
+    // seeds may hold an intermediate state, so their customers are always
+    // revisited; elsewhere only a changed route spreads
+    while (!down.empty())
+    {
+      const uint32_t id = down.top().second;
+      down.pop();
+
+      bool changed_route = false;
+      if (!peer_state(id, prefix_id))
+      {
+        const bool found = best_neighbor_route(id, prefix_id, &CSRGraph::providers,
+                                               Relationship::FROM_PROVIDER, false, best);
+        changed_route = settle(id, prefix_id, route_of(id, prefix_id),
+                               found ? &best : nullptr);
+      }
+      if (changed_route || (region_[id] & kSeed))
+        for (uint32_t c : graph_.customers(id)) queue_down(c);
+    }
+
+    for (uint32_t id : flagged)
+      region_[id] = 0;
+  }
 
 public:
   explicit BGPSim(const ASGraph& graph,
                   const std::vector<uint32_t>& rov_asns = {})
-    : graph_(graph),
-      layers_(flatten_graph(graph))
+    : BGPSim(make_topology(graph), rov_asns) {}
+
+  explicit BGPSim(std::shared_ptr<const Topology> topo,
+                  const std::vector<uint32_t>& rov_asns = {})
+    : topo_(std::move(topo)),
+      graph_(topo_->graph),
+      layers_(topo_->layers),
+      blocks_(1),
+      scratch_(1),
+      dirty_(graph_.size(), 0),
+      touched_(1),
+      kind_(graph_.size(), PolicyKind::BGP),
+      kind_layers_(layers_.size())
   {
     const std::size_t n = graph_.size();
     policies_.resize(n);
 
-    std::unordered_set<uint32_t> rov(rov_asns.begin(), rov_asns.end());
+    policies_[0] = make_policy(0, PolicyKind::BGP);
 
-    policies_[0] = std::make_unique<BGPPolicy>(0);
+    for (uint32_t id = 1; id < n; ++id)
+      policies_[id] = make_policy(id, PolicyKind::BGP);
+    for (std::size_t r = 0; r < layers_.size(); ++r)
+      group_layer(r);
+    assign_rov(rov_asns);
+  }
+
+  // Ready the simulator for another scenario on the same topology: clears
+  // every RIB that was written since the last reset (not the whole graph),
+  // drops prefixes and paths, and swaps in the new ROV deployment.  Thread
+  // count and strategy are kept.
+  void reset(const std::vector<uint32_t>& rov_asns)
+  {
+    for (auto& list : touched_)
+    {
+      for (uint32_t id : list)
+      {
+        policies_[id]->reset();
+        dirty_[id] = 0;
+      }
+      list.clear();
+    }
+
+    prefixes_.clear();
+    origins_.clear();
+    paths_.reset();
+    for (auto& block : blocks_)
+      block = PathStore::Block{};
+
+    assign_rov(rov_asns);
+  }
+
+  // Threads used to sweep each rank layer; 1 (the default) keeps the whole
+  // run on the calling thread.  Results are identical for any count.
+  void set_num_threads(unsigned num_threads)
+  {
+    num_threads = std::max(1u, num_threads);
+    pool_ = num_threads > 1 ? std::make_unique<ThreadPool>(num_threads) : nullptr;
+    outboxes_.assign(num_threads, std::vector<Outbox>(num_threads));
+    blocks_.assign(num_threads, PathStore::Block{});
+    scratch_.assign(num_threads, PullScratch{});
+    touched_.resize(std::max<std::size_t>(touched_.size(), num_threads));
+  }
+
+  unsigned num_threads() const noexcept
+  {
+    return pool_ ? pool_->size() : 1u;
+  }
+
+  void set_strategy(Strategy strategy) noexcept
+  {
+    strategy_ = strategy;
+  }
+
+  Strategy strategy() const noexcept
+  {
+    return strategy_;
+  }
+
+  // Candidate selection used by every policy (FUSED by default).  Rebuilds
+  // the policies, so any routes held so far are dropped; call it before
+  // seeding.
+  void set_selection(Selection selection)
+  {
+    if (selection == selection_) return;
+    selection_ = selection;
+    for (uint32_t id = 0; id < policies_.size(); ++id)
+      policies_[id] = make_policy(id, kind_[id]);
+  }
 
-    for (uint32_t asn = 1; asn < n; ++asn)
-      if (rov.count(asn))
-        policies_[asn] = std::make_unique<ROVPolicy>(asn);
-      else
-        policies_[asn] = std::make_unique<BGPPolicy>(asn);
+  Selection selection() const noexcept
+  {
+    return selection_;
+  }
+
+  // Record a PhaseStats entry for every propagation phase from now on.  A
+  // no-op when statistics are compiled out.
+  void set_collect_stats(bool on)
+  {
+#if BGPSIM_STATS
+    collect_stats_ = on;
+#else
+    (void)on;
+#endif
+  }
+
+  const std::vector<PhaseStats>& phase_stats() const noexcept
+  {
+#if BGPSIM_STATS
+    return stats_;
+#else
+    static const std::vector<PhaseStats> none;
+    return none;
+#endif
   }
 
-  uint32_t max_asn() const noexcept
+  const CSRGraph& graph() const noexcept
   {
-    return static_cast<uint32_t>(policies_.size() - 1);
+    return graph_;
+  }
+
+  const std::shared_ptr<const Topology>& topology() const noexcept
+  {
+    return topo_;
   }
 
   Policy& policy(uint32_t asn)
   {
-    return *policies_.at(asn);
+    return policy_at(id_or_throw(asn));
   }
 
   const Policy& policy(uint32_t asn) const
   {
-    return *policies_.at(asn);
+    return policy_at(id_or_throw(asn));
+  }
+
+  // policy by graph id rather than ASN; mutable access counts as a write
+  // for reset()
+  Policy& policy_at(uint32_t id)
+  {
+    Policy& pol = *policies_.at(id);
+    mark_touched(id, 0);
+    return pol;
+  }
+
+  const Policy& policy_at(uint32_t id) const
+  {
+    return *policies_.at(id);
+  }
+
+  bool deploys_rov(uint32_t id) const
+  {
+    return kind_.at(id) == PolicyKind::ROV;
   }
 
   const std::vector<std::vector<uint32_t>>& layers() const noexcept
@@ -77,125 +891,258 @@ public:
     return layers_;
   }
 
-  void seed_prefix(const std::string& prefix,
+  const PrefixTable& prefixes() const noexcept
+  {
+    return prefixes_;
+  }
+
+  const PathStore& paths() const noexcept
+  {
+    return paths_;
+  }
+
+  // materialized AS path of `ann` as held by `asn`
+  std::vector<uint32_t> as_path(uint32_t asn, const Announcement& ann) const
+  {
+    return paths_.expand(asn, ann.path);
+  }
+
+  void seed_prefix(std::string_view prefix,
                    uint32_t origin_asn,
                    bool rov_invalid = false)
   {
-    if (origin_asn == 0 || origin_asn >= graph_.size())
-      throw std::runtime_error("seed_prefix: origin ASN out of range");
+    const uint32_t id = graph_.id_of(origin_asn);
+    if (origin_asn == 0 || id == kNoId)
+      throw std::runtime_error("seed_prefix: origin ASN not in graph");
 
-    Announcement a = make_origin_announcement(prefix, origin_asn);
+    Announcement a = make_origin_announcement(prefixes_.intern(prefix),
+                                              origin_asn);
     a.rov_invalid = rov_invalid;
+    origins_.resize(prefixes_.size());
+    origins_[a.prefix_id].push_back(Origination{id, rov_invalid});
 
-    auto& pol = policy(origin_asn);
+    auto& pol = policy_at(id);
     pol.enqueue(a);
     pol.process_pending();
+    mark_touched(id, 0);
+  }
+
+  // Bulk form of seed_prefix for a whole announcements file: every origin
+  // is checked before anything is seeded, all origin routes are queued, and
+  // each origin AS then resolves its candidates in one process_pending.
+  // `seeds` holds Seed or SeedView rows; views are interned without a copy
+  // unless their prefix is new.
+  template <typename Seeds>
+  void seed_prefixes(const Seeds& seeds)
+  {
+    std::vector<uint32_t> ids;
+    ids.reserve(std::size(seeds));
+    for (const auto& s : seeds)
+    {
+      const uint32_t id = graph_.id_of(s.origin_asn);
+      if (s.origin_asn == 0 || id == kNoId)
+        throw std::runtime_error("seed_prefix: origin ASN not in graph");
+      ids.push_back(id);
+    }
+
+    prefixes_.reserve(prefixes_.size() + ids.size());
+    origins_.reserve(prefixes_.size() + ids.size());
+    std::size_t k = 0;
+    for (const auto& s : seeds)
+    {
+      const uint32_t id = ids[k++];
+      Announcement a = make_origin_announcement(prefixes_.intern(s.prefix),
+                                                s.origin_asn);
+      a.rov_invalid = s.rov_invalid;
+      if (a.prefix_id >= origins_.size()) origins_.resize(prefixes_.size());
+      origins_[a.prefix_id].push_back(Origination{id, s.rov_invalid});
+      policy_at(id).enqueue(a);
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    for (uint32_t id : ids)
+    {
+      policy_at(id).process_pending();
+      mark_touched(id, 0);
+    }
   }
 
   void propagate_up()
   {
+    PhaseScope scope(*this, "propagate_up");
     const std::size_t num_ranks = layers_.size();
     if (num_ranks == 0) return;
 
-    for (std::size_t r = 0; r < num_ranks; ++r)
+    if (strategy_ == Strategy::PULL)
     {
-      for (uint32_t asn : layers_[r])
-      {
-        const ASNode& node = graph_.get(asn);
-        const auto& rib = policy(asn).local_rib();
-        if (rib.empty()) continue;
+      for (std::size_t r = 1; r < num_ranks; ++r)
+        pull_layer(r, &CSRGraph::customers, Relationship::FROM_CUSTOMER);
+      release_phase_memory();   // only seeding queued anything
+      return;
+    }
 
-        for (const auto& kv : rib)
-        {
-          const Announcement& ann = kv.second;
-          for (uint32_t provider : node.providers)
-          {
-            Announcement out = make_forwarded
-            (
-              ann,
-              asn,
-              provider,
-              Relationship::FROM_CUSTOMER
-            );
-            policy(provider).enqueue(out);
-          }
-        }
-      }
+    for (std::size_t r = 0; r < num_ranks; ++r)
+    {
+      send_layer(r, &CSRGraph::providers, Relationship::FROM_CUSTOMER);
 
       if (r + 1 < num_ranks)
-        for (uint32_t asn : layers_[r + 1])
-          if (policy(asn).has_pending())
-            policy(asn).process_pending();
+        process_layer(r + 1);
     }
+    release_phase_memory();
   }
 
   void propagate_across_peers()
   {
-    const std::size_t n = graph_.size();
-
-    for (uint32_t asn = 1; asn < n; ++asn)
+    PhaseScope scope(*this, "propagate_across_peers");
+    if (strategy_ == Strategy::PULL)
     {
-      const ASNode& node = graph_.get(asn);
-      const auto& rib = policy(asn).local_rib();
-      if (rib.empty()) continue;
+      // stage against pre-phase RIBs first, then install, so a route is
+      // never carried across two peering links
+      staged_.resize(graph_.size());
+      for (std::size_t r = 0; r < layers_.size(); ++r)
+        for_each_in_layer(r, [&](const auto& pol, uint32_t id, unsigned w) {
+          pull_routes(pol, id, &CSRGraph::peers, Relationship::FROM_PEER,
+                      scratch_[w], [&](const Announcement& cand) {
+                        staged_[id].push_back(cand);
+                      });
+        });
 
-      for (const auto& kv : rib)
+      for (std::size_t r = 0; r < layers_.size(); ++r)
       {
-        const Announcement& ann = kv.second;
-        for (uint32_t peer : node.peers)
-        {
-          Announcement out = make_forwarded
-          (
-            ann,
-            asn,
-            peer,
-            Relationship::FROM_PEER
-          );
-          policy(peer).enqueue(out);
-        }
+        for_each_in_layer(r, [&](auto& pol, uint32_t id, unsigned w) {
+          if (!staged_[id].empty()) count_active(w);
+          for (const Announcement& cand : staged_[id])
+            adopt_pulled(pol, id, cand, w);
+          staged_[id].clear();
+          staged_[id].shrink_to_fit();
+        });
+        end_layer(r);
       }
+      return;
     }
 
-    for (uint32_t asn = 1; asn < n; ++asn)
-      if (policy(asn).has_pending())
-        policy(asn).process_pending();
+    // every layer sends before anyone processes, so a route is never
+    // forwarded across two peering links
+    for (std::size_t r = 0; r < layers_.size(); ++r)
+      send_layer(r, &CSRGraph::peers, Relationship::FROM_PEER);
+
+    for (std::size_t r = 0; r < layers_.size(); ++r)
+      process_layer(r);
+    release_phase_memory();
   }
 
   void propagate_down()
   {
+    PhaseScope scope(*this, "propagate_down");
     if (layers_.empty()) return;
     const std::size_t num_ranks = layers_.size();
 
+    if (strategy_ == Strategy::PULL)
+    {
+      for (std::size_t r = num_ranks - 1; r-- > 0;)
+        pull_layer(r, &CSRGraph::providers, Relationship::FROM_PROVIDER);
+      return;
+    }
+
     for (std::size_t r = num_ranks - 1; r > 0; --r)
     {
-      for (uint32_t asn : layers_[r])
-      {
-        const ASNode& node = graph_.get(asn);
-        const auto& rib = policy(asn).local_rib();
-        if (rib.empty()) continue;
+      send_layer(r, &CSRGraph::customers, Relationship::FROM_PROVIDER);
+      process_layer(r - 1);
+    }
+    release_phase_memory();
+  }
 
-        for (const auto& kv : rib)
+  // propagate_down that hands out RIBs as soon as they are final.  Calls
+  // on_final(ids) once per batch of ASes whose routes can no longer change
+  // and that no customer still has to read, then releases their RIBs, so
+  // peak memory shrinks as the sweep moves down.  Every id in layers() is
+  // reported exactly once, on the calling thread.
+  //
+  // Stubs (layer 0) make up most ASes, so under either strategy they pull
+  // from their providers kStreamChunk or so at a time, and each chunk is
+  // handed out, along with the providers it was the last reader of, before
+  // the next one is pulled.
+  template <typename Fn>
+  void propagate_down_streaming(Fn&& on_final)
+  {
+    PhaseScope scope(*this, "propagate_down");
+    if (layers_.empty()) return;
+    const std::size_t num_ranks = layers_.size();
+
+    // stub customers each AS still has to be read by
+    std::vector<uint32_t> readers(policies_.size(), 0);
+    for (uint32_t id : layers_[0])
+      for (uint32_t p : graph_.providers(id))
+        ++readers[p];
+
+    if (strategy_ == Strategy::PULL)
+    {
+      // a pulled RIB is read until its lowest-ranked customer has pulled
+      const std::vector<int>& rank = topo_->ranks;
+      std::vector<std::vector<uint32_t>> release(num_ranks);
+      for (std::size_t r = 1; r < num_ranks; ++r)
+        for (uint32_t id : layers_[r])
         {
-          const Announcement& ann = kv.second;
-          for (uint32_t customer : node.customers)
-          {
-            Announcement out = make_forwarded
-            (
-              ann,
-              asn,
-              customer,
-              Relationship::FROM_PROVIDER
-            );
-            policy(customer).enqueue(out);
-          }
+          if (readers[id]) continue;
+          std::size_t at = r;
+          for (uint32_t c : graph_.customers(id))
+            at = std::min(at, static_cast<std::size_t>(rank[c]));
+          release[at].push_back(id);
         }
+
+      for (std::size_t r = num_ranks; r-- > 1;)
+      {
+        if (r + 1 < num_ranks)
+          pull_layer(r, &CSRGraph::providers, Relationship::FROM_PROVIDER);
+        release_ribs(release[r], on_final);
+      }
+    }
+    else
+    {
+      // a pushed RIB is final once its layer has been processed and no
+      // longer needed once it has sent, unless stubs still pull from it
+      std::vector<uint32_t> sent;
+      for (std::size_t r = num_ranks - 1; r > 0; --r)
+      {
+        send_layer(r, &CSRGraph::customers, Relationship::FROM_PROVIDER,
+                   /*skip_stubs=*/true);
+        if (r > 1) process_layer(r - 1);
+        sent.clear();
+        for (uint32_t id : layers_[r])
+          if (!readers[id]) sent.push_back(id);
+        release_ribs(sent, on_final);
       }
+      release_phase_memory();
+    }
+
+    pull_stubs_streaming(readers, on_final);
+  }
+
+  template <typename Fn>
+  void pull_stubs_streaming(std::vector<uint32_t>& readers, Fn& on_final)
+  {
+    const std::vector<uint32_t>& stubs = kind_layers_[0].ids;
+    const std::size_t chunk =
+      std::max(kStreamChunk, num_threads() * kParallelGrain * 4);
+
+    std::vector<uint32_t> pulled, read;
+    for (std::size_t first = 0; first < stubs.size(); first += chunk)
+    {
+      const std::size_t last = std::min(first + chunk, stubs.size());
+      for_each_in_range(0, first, last, [&](auto& pol, uint32_t id, unsigned w) {
+        pull_into(pol, id, &CSRGraph::providers, Relationship::FROM_PROVIDER, w);
+      });
 
-      const std::size_t lower_rank = r - 1;
-      for (uint32_t asn : layers_[lower_rank])
-        if (policy(asn).has_pending())
-          policy(asn).process_pending();
+      pulled.assign(stubs.begin() + first, stubs.begin() + last);
+      read.clear();
+      for (uint32_t id : pulled)
+        for (uint32_t p : graph_.providers(id))
+          if (--readers[p] == 0) read.push_back(p);
+      release_ribs(pulled, on_final);
+      release_ribs(read, on_final);
     }
+    end_layer(0);
   }
 
   void propagate_all()
@@ -204,4 +1151,68 @@ public:
     propagate_across_peers();
     propagate_down();
   }
+
+  // Incremental updates for an already propagated simulator.  Each leaves
+  // the RIBs as propagate_all would over the updated seeds and ROV set, but
+  // only revisits the changed prefix at ASes whose inputs changed.  Always
+  // serial.
+
+  // Seed one more origin for `prefix` and propagate it.
+  void announce(std::string_view prefix, uint32_t origin_asn,
+                bool rov_invalid = false)
+  {
+    const uint32_t id = graph_.id_of(origin_asn);
+    if (origin_asn == 0 || id == kNoId)
+      throw std::runtime_error("announce: origin ASN not in graph");
+
+    const uint32_t prefix_id = prefixes_.intern(prefix);
+    origins_.resize(prefixes_.size());
+    origins_[prefix_id].push_back(Origination{id, rov_invalid});
+    update_prefix(prefix_id, {id});
+  }
+
+  // Remove every seed of `prefix` at `origin_asn`.  Returns false if there
+  // was none.
+  bool withdraw(std::string_view prefix, uint32_t origin_asn)
+  {
+    const uint32_t prefix_id = prefixes_.find(prefix);
+    const uint32_t id = graph_.id_of(origin_asn);
+    if (prefix_id == PrefixTable::npos || id == kNoId) return false;
+
+    auto& seeds = origins_[prefix_id];
+    const auto kept = std::remove_if(seeds.begin(), seeds.end(),
+      [&](const Origination& o) { return o.id == id; });
+    if (kept == seeds.end()) return false;
+    seeds.erase(kept, seeds.end());
+
+    update_prefix(prefix_id, {id});
+    return true;
+  }
+
+  // Deploy or remove ROV at one AS.  Its routes are carried over to the new
+  // policy, then every prefix with an ROV-invalid seed is updated from it.
+  void set_rov(uint32_t asn, bool deploy)
+  {
+    const uint32_t id = id_or_throw(asn);
+    const PolicyKind kind = deploy ? PolicyKind::ROV : PolicyKind::BGP;
+    if (kind_[id] == kind) return;
+
+    std::unique_ptr<Policy> next = make_policy(id, kind);
+    for (const auto& kv : policies_[id]->local_rib())
+      next->adopt(kv.second);
+    policies_[id] = std::move(next);
+
+    kind_[id] = kind;
+    group_layer(static_cast<std::size_t>(topo_->ranks[id]));
+    auto pos = std::lower_bound(rov_ids_.begin(), rov_ids_.end(), id);
+    if (deploy) rov_ids_.insert(pos, id);
+    else        rov_ids_.erase(pos);
+
+    for (uint32_t p = 0; p < origins_.size(); ++p)
+    {
+      const bool has_invalid = std::any_of(origins_[p].begin(), origins_[p].end(),
+        [](const Origination& o) { return o.rov_invalid; });
+      if (has_invalid) update_prefix(p, {id});
+    }
+  }
 };
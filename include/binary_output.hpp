@@ -0,0 +1,682 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include "prefix_table.hpp"
+#include "path_store.hpp"
+#include "topology_snapshot.hpp"
+#include "output.hpp"
+
+// Columnar binary alternative to ribs.csv.  One row per held route, in the
+// same order as the CSV, stored as three parallel columns:
+//
+//   asn          holder of the route
+//   prefix_id    index into the prefix name table
+//   path_offset  node in the path pool for the path as received (next hop
+//                first), or kEmptyPath for an origin route
+//
+// The path pool is a parent-linked node list (pool_asn, pool_parent) in which
+// every distinct path suffix appears once, so routes that share a suffix
+// share its nodes.  The full path of row i is asn[i] followed by the pool
+// chain starting at path_offset[i].
+//
+// A file is a header, one or more segments and, as a footer, the index of
+// segment offsets.  Each segment carries its own prefix names, columns and
+// pool, so a sharded run writes every shard as one segment as soon as it is
+// done; reading merges the segments back into one table.  Sections reuse the
+// topology snapshot framing: each array is a uint64 count plus raw data
+// padded to 8 bytes.
+constexpr uint32_t kBinaryRibsVersion = 2;
+
+namespace detail {
+
+constexpr char kRibsMagic[8] = {'B', 'G', 'P', 'R', 'I', 'B', 'S', '\0'};
+
+struct RibsHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t num_segments;
+  uint64_t num_rows;
+  uint64_t index_offset;
+  uint64_t file_size;
+};
+
+struct RibsSegmentHeader
+{
+  uint64_t num_rows;
+  uint64_t num_prefixes;
+  uint64_t num_path_nodes;
+};
+
+// One segment: header, prefix name offsets and bytes, the three row columns
+// and the path pool.  name_at(p) is the name of prefix p.
+template <typename NameAt>
+inline void write_ribs_segment(SnapshotWriter& w, std::size_t num_prefixes, NameAt name_at,
+                               const std::vector<uint32_t>& asn,
+                               const std::vector<uint32_t>& prefix_id,
+                               const std::vector<uint32_t>& path_offset,
+                               const std::vector<uint32_t>& pool_asn,
+                               const std::vector<uint32_t>& pool_parent)
+{
+  std::vector<uint32_t> name_off(1, 0);
+  std::vector<char> names;
+  for (std::size_t p = 0; p < num_prefixes; ++p)
+  {
+    const std::string& name = name_at(p);
+    names.insert(names.end(), name.begin(), name.end());
+    name_off.push_back(static_cast<uint32_t>(names.size()));
+  }
+
+  const RibsSegmentHeader header{asn.size(), num_prefixes, pool_asn.size()};
+  w.raw(&header, sizeof(header));
+  w.array(name_off);
+  w.array(names);
+  w.array(asn);
+  w.array(prefix_id);
+  w.array(path_offset);
+  w.array(pool_asn);
+  w.array(pool_parent);
+}
+
+} // namespace detail
+
+// Routing table as read back from a binary RIB file.
+struct BinaryRibs
+{
+  std::vector<std::string> prefixes;
+  std::vector<uint32_t> asn;
+  std::vector<uint32_t> prefix_id;
+  std::vector<uint32_t> path_offset;
+  std::vector<uint32_t> pool_asn;
+  std::vector<uint32_t> pool_parent;
+
+  std::size_t size() const noexcept
+  {
+    return asn.size();
+  }
+
+  // full AS path of row i, holder first
+  std::vector<uint32_t> path(std::size_t row) const
+  {
+    std::vector<uint32_t> out{asn[row]};
+    for (uint32_t n = path_offset[row]; n != kEmptyPath; n = pool_parent[n])
+      out.push_back(pool_asn[n]);
+    return out;
+  }
+};
+
+// Collects the routing tables of one or more simulators into one table, in
+// memory, with prefix ids and the path pool shared by everything added.
+// Runs too large to hold at once write through BinaryRibFile instead.
+class BinaryRibWriter
+{
+  PrefixTable prefixes_;
+  std::vector<uint32_t> asn_, prefix_id_, path_offset_;
+  std::vector<uint32_t> pool_asn_, pool_parent_;
+
+  // (asn, parent pool node) -> pool node, shared by all simulators
+  std::unordered_map<uint64_t, uint32_t> pool_index_;
+
+  // PathStore handle -> pool node for the simulator being added
+  std::unordered_map<uint32_t, uint32_t> handle_index_;
+  std::vector<uint32_t> chain_;
+
+  uint32_t intern_node(uint32_t asn, uint32_t parent)
+  {
+    const uint64_t key = (uint64_t{asn} << 32) | parent;
+    auto it = pool_index_.find(key);
+    if (it != pool_index_.end()) return it->second;
+
+    const uint32_t node = static_cast<uint32_t>(pool_asn_.size());
+    pool_asn_.push_back(asn);
+    pool_parent_.push_back(parent);
+    pool_index_.emplace(key, node);
+    return node;
+  }
+
+  uint32_t intern_path(const PathStore& paths, uint32_t handle)
+  {
+    // walk up to the first suffix already in the pool, then add the missing
+    // nodes origin side first
+    chain_.clear();
+    uint32_t parent = kEmptyPath;
+    for (uint32_t h = handle; h != kEmptyPath; h = paths.node(h).parent)
+    {
+      auto it = handle_index_.find(h);
+      if (it != handle_index_.end())
+      {
+        parent = it->second;
+        break;
+      }
+      chain_.push_back(h);
+    }
+
+    for (std::size_t i = chain_.size(); i-- > 0;)
+    {
+      parent = intern_node(paths.node(chain_[i]).asn, parent);
+      handle_index_.emplace(chain_[i], parent);
+    }
+    return parent;
+  }
+
+public:
+  template <typename Sim>
+  void add(const Sim& sim)
+  {
+    handle_index_.clear();
+
+    std::vector<uint32_t> local_to_global(sim.prefixes().size());
+    for (uint32_t p = 0; p < local_to_global.size(); ++p)
+      local_to_global[p] = prefixes_.intern(sim.prefixes().name(p));
+
+    const uint32_t n = static_cast<uint32_t>(sim.graph().size());
+    for (uint32_t id = 1; id < n; ++id)
+    {
+      const uint32_t asn = sim.graph().asn_of(id);
+      detail::for_each_route(sim, id, [&](uint32_t prefix_id, uint32_t path) {
+        asn_.push_back(asn);
+        prefix_id_.push_back(local_to_global[prefix_id]);
+        path_offset_.push_back(intern_path(sim.paths(), path));
+      });
+    }
+  }
+
+  // Appends routes read back from a binary file, e.g. a shard computed
+  // elsewhere; shared path suffixes are merged into the pool.
+  void add(const BinaryRibs& ribs)
+  {
+    std::vector<uint32_t> local_to_global(ribs.prefixes.size());
+    for (uint32_t p = 0; p < local_to_global.size(); ++p)
+      local_to_global[p] = prefixes_.intern(ribs.prefixes[p]);
+
+    // parents precede their children, so one forward pass maps every node
+    std::vector<uint32_t> node(ribs.pool_asn.size());
+    for (std::size_t i = 0; i < node.size(); ++i)
+    {
+      const uint32_t parent = ribs.pool_parent[i];
+      node[i] = intern_node(ribs.pool_asn[i], parent == kEmptyPath ? kEmptyPath : node[parent]);
+    }
+
+    for (std::size_t row = 0; row < ribs.size(); ++row)
+    {
+      asn_.push_back(ribs.asn[row]);
+      prefix_id_.push_back(local_to_global[ribs.prefix_id[row]]);
+      path_offset_.push_back(ribs.path_offset[row] == kEmptyPath
+                               ? kEmptyPath : node[ribs.path_offset[row]]);
+    }
+  }
+
+  std::size_t size() const noexcept
+  {
+    return asn_.size();
+  }
+
+  // Moves everything added so far out, as read_routing_binary would return
+  // it, and leaves the writer empty.
+  BinaryRibs take()
+  {
+    BinaryRibs out;
+    out.prefixes.reserve(prefixes_.size());
+    for (uint32_t p = 0; p < prefixes_.size(); ++p)
+      out.prefixes.push_back(prefixes_.name(p));
+    out.asn = std::move(asn_);
+    out.prefix_id = std::move(prefix_id_);
+    out.path_offset = std::move(path_offset_);
+    out.pool_asn = std::move(pool_asn_);
+    out.pool_parent = std::move(pool_parent_);
+    *this = BinaryRibWriter();
+    return out;
+  }
+
+  std::size_t path_nodes() const noexcept
+  {
+    return pool_asn_.size();
+  }
+
+  // Writes everything added as a one-segment file.  Any seekable stream
+  // will do; the header is rewritten at its start.
+  void write(std::ostream& out) const;
+  void write(const std::string& filename) const;
+
+  // appends everything added as one segment
+  void write_segment(detail::SnapshotWriter& w) const
+  {
+    detail::write_ribs_segment(w, prefixes_.size(),
+                               [&](std::size_t p) -> const std::string& {
+                                 return prefixes_.name(static_cast<uint32_t>(p));
+                               },
+                               asn_, prefix_id_, path_offset_, pool_asn_, pool_parent_);
+  }
+};
+
+// Writes a binary RIB file a segment at a time, e.g. one per shard as it
+// finishes, so only the segment being added is ever held in memory.  The
+// file is complete once finish() returns.
+class BinaryRibFile
+{
+  std::ofstream file_;
+  std::ostream& out_;
+  detail::SnapshotWriter w_;
+  std::vector<uint64_t> index_;
+  uint64_t rows_ = 0;
+
+  void begin()
+  {
+    const detail::RibsHeader placeholder{};
+    w_.raw(&placeholder, sizeof(placeholder));
+  }
+
+public:
+  explicit BinaryRibFile(const std::string& filename)
+    : file_(filename, std::ios::binary | std::ios::trunc), out_(file_), w_(out_)
+  {
+    if (!file_.is_open())
+      throw std::runtime_error("Failed to open output file: " + filename);
+    begin();
+  }
+
+  // any seekable stream, written from its start
+  explicit BinaryRibFile(std::ostream& out) : out_(out), w_(out_)
+  {
+    begin();
+  }
+
+  BinaryRibFile(const BinaryRibFile&) = delete;
+  BinaryRibFile& operator=(const BinaryRibFile&) = delete;
+
+  template <typename Sim>
+  void add(const Sim& sim)
+  {
+    BinaryRibWriter segment;
+    segment.add(sim);
+    add(segment);
+  }
+
+  void add(const BinaryRibWriter& segment)
+  {
+    index_.push_back(w_.written());
+    rows_ += segment.size();
+    segment.write_segment(w_);
+    if (!out_)
+      throw std::runtime_error("Failed to write binary RIBs");
+  }
+
+  // routes read back from elsewhere, e.g. a worker's shard, copied as they are
+  void add(const BinaryRibs& ribs)
+  {
+    index_.push_back(w_.written());
+    rows_ += ribs.size();
+    detail::write_ribs_segment(w_, ribs.prefixes.size(),
+                               [&](std::size_t p) -> const std::string& {
+                                 return ribs.prefixes[p];
+                               },
+                               ribs.asn, ribs.prefix_id, ribs.path_offset,
+                               ribs.pool_asn, ribs.pool_parent);
+    if (!out_)
+      throw std::runtime_error("Failed to write binary RIBs");
+  }
+
+  // Writes the segment index and the header.
+  void finish()
+  {
+    detail::RibsHeader header{};
+    std::memcpy(header.magic, detail::kRibsMagic, sizeof(header.magic));
+    header.version      = kBinaryRibsVersion;
+    header.byte_order   = detail::kSnapshotByteOrder;
+    header.num_segments = index_.size();
+    header.num_rows     = rows_;
+    header.index_offset = w_.written();
+
+    w_.array(index_);
+    header.file_size = w_.written();
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.flush();
+    if (!out_)
+      throw std::runtime_error("Failed to write binary RIBs");
+  }
+};
+
+inline void BinaryRibWriter::write(std::ostream& out) const
+{
+  BinaryRibFile file(out);
+  file.add(*this);
+  file.finish();
+}
+
+inline void BinaryRibWriter::write(const std::string& filename) const
+{
+  BinaryRibFile file(filename);
+  file.add(*this);
+  file.finish();
+}
+
+template <typename Sim>
+inline void write_routing_binary(const Sim& sim, const std::string& filename)
+{
+  BinaryRibWriter writer;
+  writer.add(sim);
+  writer.write(filename);
+}
+
+namespace detail {
+
+inline BinaryRibs parse_ribs_segment(std::string_view data)
+{
+  SnapshotReader r(data);
+
+  RibsSegmentHeader header;
+  r.raw(&header, sizeof(header));
+
+  BinaryRibs ribs;
+  std::vector<uint32_t> name_off;
+  std::vector<char> names;
+  r.array(name_off);
+  r.array(names);
+  r.array(ribs.asn);
+  r.array(ribs.prefix_id);
+  r.array(ribs.path_offset);
+  r.array(ribs.pool_asn);
+  r.array(ribs.pool_parent);
+
+  const std::size_t rows = ribs.asn.size();
+  const std::size_t nodes = ribs.pool_asn.size();
+  bool ok = r.at_end() &&
+            name_off.size() == header.num_prefixes + 1 &&
+            name_off.back() == names.size() &&
+            rows == header.num_rows &&
+            ribs.prefix_id.size() == rows && ribs.path_offset.size() == rows &&
+            nodes == header.num_path_nodes && ribs.pool_parent.size() == nodes;
+  for (std::size_t i = 0; ok && i + 1 < name_off.size(); ++i)
+    ok = name_off[i] <= name_off[i + 1];
+  for (std::size_t i = 0; ok && i < rows; ++i)
+    ok = ribs.prefix_id[i] < header.num_prefixes &&
+         (ribs.path_offset[i] == kEmptyPath || ribs.path_offset[i] < nodes);
+  // parents always precede their children in the pool
+  for (std::size_t i = 0; ok && i < nodes; ++i)
+    ok = ribs.pool_parent[i] == kEmptyPath || ribs.pool_parent[i] < i;
+  if (!ok)
+    throw std::runtime_error("Binary RIBs: unsupported or corrupt file");
+
+  ribs.prefixes.reserve(static_cast<std::size_t>(header.num_prefixes));
+  for (std::size_t i = 0; i + 1 < name_off.size(); ++i)
+    ribs.prefixes.emplace_back(names.data() + name_off[i],
+                               name_off[i + 1] - name_off[i]);
+  return ribs;
+}
+
+} // namespace detail
+
+// Every segment of the file, merged into one table
+inline BinaryRibs parse_routing_binary(std::string_view data)
+{
+  using detail::SnapshotReader;
+
+  SnapshotReader r(data);
+
+  detail::RibsHeader header;
+  r.raw(&header, sizeof(header));
+  if (std::memcmp(header.magic, detail::kRibsMagic, sizeof(header.magic)) != 0)
+    throw std::runtime_error("Binary RIBs: not a binary RIB file");
+  if (header.byte_order != detail::kSnapshotByteOrder ||
+      header.version != kBinaryRibsVersion ||
+      header.file_size != data.size() ||
+      header.index_offset < sizeof(header) || header.index_offset > data.size())
+    throw std::runtime_error("Binary RIBs: unsupported or corrupt file");
+
+  std::vector<uint64_t> index;
+  SnapshotReader footer(data.substr(static_cast<std::size_t>(header.index_offset)));
+  footer.array(index);
+  bool ok = footer.at_end() && index.size() == header.num_segments &&
+            !index.empty() && index.front() == sizeof(header);
+  for (std::size_t i = 0; ok && i + 1 < index.size(); ++i)
+    ok = index[i] < index[i + 1];
+  if (!ok || index.back() >= header.index_offset)
+    throw std::runtime_error("Binary RIBs: unsupported or corrupt file");
+
+  auto segment = [&](std::size_t i) {
+    const uint64_t end = i + 1 < index.size() ? index[i + 1] : header.index_offset;
+    return detail::parse_ribs_segment(
+      data.substr(static_cast<std::size_t>(index[i]),
+                  static_cast<std::size_t>(end - index[i])));
+  };
+
+  BinaryRibs ribs;
+  if (index.size() == 1)
+    ribs = segment(0);
+  else
+  {
+    BinaryRibWriter merged;
+    for (std::size_t i = 0; i < index.size(); ++i)
+      merged.add(segment(i));
+    ribs = merged.take();
+  }
+  if (ribs.size() != header.num_rows)
+    throw std::runtime_error("Binary RIBs: unsupported or corrupt file");
+  return ribs;
+}
+
+inline BinaryRibs read_routing_binary(const std::string& filename)
+{
+  MappedFile file(filename);
+  return parse_routing_binary(file.view());
+}
+
+// Rows of `ribs` sorted by ASN, then prefix name: the CANONICAL row order.
+inline std::vector<std::size_t> canonical_rows(const BinaryRibs& ribs)
+{
+  std::vector<uint32_t> order(ribs.prefixes.size());
+  for (uint32_t p = 0; p < order.size(); ++p) order[p] = p;
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return ribs.prefixes[a] < ribs.prefixes[b];
+  });
+  std::vector<uint32_t> rank(order.size());
+  for (uint32_t i = 0; i < order.size(); ++i) rank[order[i]] = i;
+
+  std::vector<std::size_t> rows(ribs.size());
+  for (std::size_t i = 0; i < rows.size(); ++i) rows[i] = i;
+  std::sort(rows.begin(), rows.end(), [&](std::size_t a, std::size_t b) {
+    if (ribs.asn[a] != ribs.asn[b]) return ribs.asn[a] < ribs.asn[b];
+    return rank[ribs.prefix_id[a]] < rank[ribs.prefix_id[b]];
+  });
+  return rows;
+}
+
+// ribs.csv rows (no header) for routes read back from a binary file, in
+// file order or canonical order
+inline void write_routing_rows(const BinaryRibs& ribs, std::ostream& out,
+                               RowOrder order = RowOrder::ENGINE)
+{
+  std::vector<std::size_t> rows;
+  if (order == RowOrder::CANONICAL) rows = canonical_rows(ribs);
+
+  std::string buf;
+  for (std::size_t i = 0; i < ribs.size(); ++i)
+  {
+    const std::size_t row = rows.empty() ? i : rows[i];
+    detail::append_uint(buf, ribs.asn[row]);
+    buf += ',';
+    buf += ribs.prefixes[ribs.prefix_id[row]];
+    buf += ",\"(";
+    detail::append_uint(buf, ribs.asn[row]);
+    if (ribs.path_offset[row] == kEmptyPath)
+      buf += ",";
+    for (uint32_t n = ribs.path_offset[row]; n != kEmptyPath; n = ribs.pool_parent[n])
+    {
+      buf += ", ";
+      detail::append_uint(buf, ribs.pool_asn[n]);
+    }
+    buf += ")\"\n";
+
+    if (buf.size() >= (1 << 16) || i + 1 == ribs.size())
+    {
+      out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+      buf.clear();
+    }
+  }
+  if (!out)
+    throw std::runtime_error("Failed to write routing rows");
+}
+
+// Canonical ribs.csv rows for a run computed in shards.  Canonical order
+// interleaves the shards, so each shard's rows are appended, already sorted,
+// to a spill file as the shard finishes, and finish() merges those sorted
+// runs into the output.  Memory holds one shard's routes while it is added
+// and a small read buffer per run while merging.  The spill file is removed
+// when the object goes away.
+class CanonicalRowSpill
+{
+  static constexpr std::size_t kMergeMemory = std::size_t{16} << 20;
+  static constexpr std::size_t kMinRunBuffer = std::size_t{1} << 12;
+
+  std::string name_;
+  std::ofstream spill_;
+  std::vector<uint64_t> run_start_{0};
+
+  // a sorted run being merged; `line` is its current row
+  struct Run
+  {
+    uint64_t pos, end;
+    std::string buf;
+    std::size_t at = 0;
+    std::string_view line;
+    uint32_t asn = 0;
+    std::string_view prefix;
+  };
+
+  void end_run()
+  {
+    if (!spill_)
+      throw std::runtime_error("Failed to write spill file: " + name_);
+    run_start_.push_back(static_cast<uint64_t>(spill_.tellp()));
+  }
+
+  // Moves `run` to its next row, reading `chunk` more bytes of it at a
+  // time; false once the run is used up.
+  bool next_row(std::ifstream& in, Run& run, std::size_t chunk) const
+  {
+    for (;;)
+    {
+      const std::size_t nl = run.buf.find('\n', run.at);
+      if (nl != std::string::npos)
+      {
+        run.line = std::string_view(run.buf).substr(run.at, nl + 1 - run.at);
+        run.at = nl + 1;
+        const std::size_t c1 = run.line.find(',');
+        const std::size_t c2 = run.line.find(',', c1 + 1);
+        std::from_chars(run.line.data(), run.line.data() + c1, run.asn);
+        run.prefix = run.line.substr(c1 + 1, c2 - c1 - 1);
+        return true;
+      }
+      if (run.pos == run.end)
+      {
+        if (run.at != run.buf.size())
+          throw std::runtime_error("Spill file is truncated: " + name_);
+        return false;
+      }
+
+      run.buf.erase(0, run.at);
+      run.at = 0;
+      const std::size_t n = static_cast<std::size_t>(
+        std::min<uint64_t>(chunk, run.end - run.pos));
+      const std::size_t old = run.buf.size();
+      run.buf.resize(old + n);
+      in.seekg(static_cast<std::streamoff>(run.pos));
+      in.read(&run.buf[old], static_cast<std::streamsize>(n));
+      if (!in)
+        throw std::runtime_error("Failed to read spill file: " + name_);
+      run.pos += n;
+    }
+  }
+
+public:
+  explicit CanonicalRowSpill(std::string spill_file)
+    : name_(std::move(spill_file)), spill_(name_, std::ios::binary | std::ios::trunc)
+  {
+    if (!spill_.is_open())
+      throw std::runtime_error("Failed to open spill file: " + name_);
+  }
+
+  ~CanonicalRowSpill()
+  {
+    spill_.close();
+    std::remove(name_.c_str());
+  }
+
+  CanonicalRowSpill(const CanonicalRowSpill&) = delete;
+  CanonicalRowSpill& operator=(const CanonicalRowSpill&) = delete;
+
+  template <typename Sim>
+  void add(const Sim& sim)
+  {
+    write_routing_rows(sim, spill_, 1, RowOrder::CANONICAL);
+    end_run();
+  }
+
+  void add(const BinaryRibs& ribs)
+  {
+    write_routing_rows(ribs, spill_, RowOrder::CANONICAL);
+    end_run();
+  }
+
+  // Writes every row added, in canonical order.  Shards hold disjoint
+  // prefixes, so no two runs share an (ASN, prefix) key.
+  void finish(std::ostream& out)
+  {
+    spill_.close();
+    if (!spill_)
+      throw std::runtime_error("Failed to write spill file: " + name_);
+
+    std::ifstream in(name_, std::ios::binary);
+    if (!in.is_open())
+      throw std::runtime_error("Failed to open spill file: " + name_);
+
+    const std::size_t num_runs = run_start_.size() - 1;
+    const std::size_t chunk =
+      std::max(kMinRunBuffer, kMergeMemory / std::max<std::size_t>(num_runs, 1));
+    std::vector<Run> runs(num_runs);
+    auto after = [&](std::size_t a, std::size_t b) {
+      if (runs[a].asn != runs[b].asn) return runs[a].asn > runs[b].asn;
+      return runs[a].prefix > runs[b].prefix;
+    };
+    std::vector<std::size_t> heap;
+    for (std::size_t k = 0; k < num_runs; ++k)
+    {
+      runs[k].pos = run_start_[k];
+      runs[k].end = run_start_[k + 1];
+      if (next_row(in, runs[k], chunk)) heap.push_back(k);
+    }
+    std::make_heap(heap.begin(), heap.end(), after);
+
+    std::string buf;
+    while (!heap.empty())
+    {
+      std::pop_heap(heap.begin(), heap.end(), after);
+      Run& run = runs[heap.back()];
+      buf.append(run.line);
+      if (buf.size() >= (1 << 16))
+      {
+        out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        buf.clear();
+      }
+      if (next_row(in, run, chunk))
+        std::push_heap(heap.begin(), heap.end(), after);
+      else
+        heap.pop_back();
+    }
+    out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+    if (!out)
+      throw std::runtime_error("Failed to write routing rows");
+  }
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <cstddef>
+
+// Blocking FIFO of at most `capacity` items connecting two pipeline stages.
+// push() waits while the queue is full and pop() while it is empty, so a
+// fast stage runs at most `capacity` items ahead of a slow one.  close()
+// wakes everyone: later pushes fail, and pops drain what is left and then
+// return nothing.
+template <typename T>
+class BoundedQueue
+{
+  std::deque<T> items_;
+  std::size_t capacity_;
+  bool closed_ = false;
+  std::mutex mutex_;
+  std::condition_variable not_full_, not_empty_;
+
+public:
+  explicit BoundedQueue(std::size_t capacity)
+    : capacity_(capacity ? capacity : 1) {}
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  // false if the queue was closed, in which case `item` is dropped
+  bool push(T item)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+    if (closed_) return false;
+    items_.push_back(std::move(item));
+    lock.unlock();
+    not_empty_.notify_one();
+    return true;
+  }
+
+  std::optional<T> pop()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+    if (items_.empty()) return std::nullopt;
+    T item = std::move(items_.front());
+    items_.pop_front();
+    lock.unlock();
+    not_full_.notify_one();
+    return item;
+  }
+
+  void close()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+};
@@ -0,0 +1,306 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#include "as_graph.hpp"
+#include "topology.hpp"
+#include "announcement.hpp"
+#include "prefix_table.hpp"
+#include "path_store.hpp"
+#include "seed.hpp"
+
+// Struct-of-arrays alternative to BGPSim.  Instead of one Policy object per
+// AS, every seeded prefix owns a set of dense columns indexed by graph id that
+// hold the best route's relationship, path length, next hop and path handle.
+// ROV deployment is a bitmask over ids, so the propagation loops are plain
+// scans over the rank layers with no virtual dispatch or hash lookups.
+class ColumnarSim
+{
+public:
+  static constexpr uint8_t kNoRoute = 0xff;
+
+  struct PrefixRib
+  {
+    std::vector<uint8_t>  rel;        // Relationship, kNoRoute if unset
+    std::vector<uint8_t>  invalid;    // rov_invalid of the held route
+    std::vector<uint32_t> path_len;
+    std::vector<uint32_t> next_hop;   // ASN, used for tie-breaking
+    std::vector<uint32_t> path;       // PathStore handle, as in Announcement
+
+    explicit PrefixRib(std::size_t n)
+      : rel(n, kNoRoute), invalid(n, 0), path_len(n, 0),
+        next_hop(n, 0), path(n, kEmptyPath) {}
+  };
+
+private:
+  std::shared_ptr<const Topology> topo_;
+  const CSRGraph& graph_;
+  const std::vector<std::vector<uint32_t>>& layers_;
+  std::vector<uint64_t> rov_bits_;
+  PrefixTable prefixes_;
+  PathStore paths_;
+  std::vector<PrefixRib> ribs_;
+
+  // scratch columns for the peer phase, which must only forward routes
+  // that were in place before the phase started
+  PrefixRib peer_scratch_{0};
+
+  bool is_rov(uint32_t id) const noexcept
+  {
+    return (rov_bits_[id >> 6] >> (id & 63)) & 1u;
+  }
+
+  void assign_rov(const std::vector<uint32_t>& rov_asns)
+  {
+    rov_bits_.assign((graph_.size() + 63) / 64, 0);
+    for (uint32_t asn : rov_asns)
+    {
+      const uint32_t id = graph_.id_of(asn);
+      if (id != kNoId)
+        rov_bits_[id >> 6] |= uint64_t{1} << (id & 63);
+    }
+  }
+
+  uint32_t id_or_throw(uint32_t asn) const
+  {
+    const uint32_t id = graph_.id_of(asn);
+    if (id == kNoId)
+      throw std::out_of_range("ColumnarSim: ASN not in graph");
+    return id;
+  }
+
+  static bool better(uint8_t rel_a, uint32_t len_a, uint32_t nh_a,
+                     uint8_t rel_b, uint32_t len_b, uint32_t nh_b) noexcept
+  {
+    if (rel_b == kNoRoute) return true;
+    const int ra = relationship_rank(static_cast<Relationship>(rel_a));
+    const int rb = relationship_rank(static_cast<Relationship>(rel_b));
+    if (ra != rb) return ra > rb;
+    if (len_a != len_b) return len_a < len_b;
+    return nh_a < nh_b;
+  }
+
+  // offer the route held by id `from` (ASN `from_asn`) in `src` to id `to`
+  // in `dst`
+  void offer(const PrefixRib& src, PrefixRib& dst,
+             uint32_t from, uint32_t from_asn, uint32_t to,
+             uint32_t fwd_path, Relationship rel) noexcept
+  {
+    if (src.invalid[from] && is_rov(to)) return;
+
+    const uint8_t  r  = static_cast<uint8_t>(rel);
+    const uint32_t ln = src.path_len[from] + 1;
+    if (!better(r, ln, from_asn, dst.rel[to], dst.path_len[to], dst.next_hop[to]))
+      return;
+
+    dst.rel[to]      = r;
+    dst.invalid[to]  = src.invalid[from];
+    dst.path_len[to] = ln;
+    dst.next_hop[to] = from_asn;
+    dst.path[to]     = fwd_path;
+  }
+
+  void merge(const PrefixRib& src, PrefixRib& dst, uint32_t id) noexcept
+  {
+    if (src.rel[id] == kNoRoute) return;
+    if (!better(src.rel[id], src.path_len[id], src.next_hop[id],
+                dst.rel[id], dst.path_len[id], dst.next_hop[id]))
+      return;
+
+    dst.rel[id]      = src.rel[id];
+    dst.invalid[id]  = src.invalid[id];
+    dst.path_len[id] = src.path_len[id];
+    dst.next_hop[id] = src.next_hop[id];
+    dst.path[id]     = src.path[id];
+  }
+
+public:
+  explicit ColumnarSim(const ASGraph& graph,
+                       const std::vector<uint32_t>& rov_asns = {})
+    : ColumnarSim(make_topology(graph), rov_asns) {}
+
+  explicit ColumnarSim(std::shared_ptr<const Topology> topo,
+                       const std::vector<uint32_t>& rov_asns = {})
+    : topo_(std::move(topo)),
+      graph_(topo_->graph),
+      layers_(topo_->layers)
+  {
+    assign_rov(rov_asns);
+  }
+
+  // Ready the simulator for another scenario on the same topology: drops
+  // every prefix and path (keeping path memory) and installs a new ROV set.
+  void reset(const std::vector<uint32_t>& rov_asns)
+  {
+    ribs_.clear();
+    prefixes_.clear();
+    paths_.reset();
+    assign_rov(rov_asns);
+  }
+
+  const CSRGraph& graph() const noexcept
+  {
+    return graph_;
+  }
+
+  const std::shared_ptr<const Topology>& topology() const noexcept
+  {
+    return topo_;
+  }
+
+  const std::vector<std::vector<uint32_t>>& layers() const noexcept
+  {
+    return layers_;
+  }
+
+  const PrefixTable& prefixes() const noexcept
+  {
+    return prefixes_;
+  }
+
+  const PathStore& paths() const noexcept
+  {
+    return paths_;
+  }
+
+  const PrefixRib& rib(uint32_t prefix_id) const
+  {
+    return ribs_.at(prefix_id);
+  }
+
+  bool deploys_rov(uint32_t id) const noexcept
+  {
+    return is_rov(id);
+  }
+
+  bool has_route(uint32_t prefix_id, uint32_t asn) const
+  {
+    return rib(prefix_id).rel[id_or_throw(asn)] != kNoRoute;
+  }
+
+  Announcement route(uint32_t prefix_id, uint32_t asn) const
+  {
+    const PrefixRib& r = rib(prefix_id);
+    const uint32_t id = id_or_throw(asn);
+    if (r.rel[id] == kNoRoute)
+      throw std::runtime_error("ColumnarSim::route: no route held");
+
+    return Announcement(prefix_id, r.path[id], r.path_len[id],
+                        r.next_hop[id],
+                        static_cast<Relationship>(r.rel[id]),
+                        r.invalid[id] != 0);
+  }
+
+  std::vector<uint32_t> as_path(uint32_t asn, const Announcement& ann) const
+  {
+    return paths_.expand(asn, ann.path);
+  }
+
+  void seed_prefix(std::string_view prefix,
+                   uint32_t origin_asn,
+                   bool rov_invalid = false)
+  {
+    const uint32_t o = graph_.id_of(origin_asn);
+    if (origin_asn == 0 || o == kNoId)
+      throw std::runtime_error("seed_prefix: origin ASN not in graph");
+
+    const uint32_t id = prefixes_.intern(prefix);
+    if (id == ribs_.size())
+      ribs_.emplace_back(graph_.size());
+
+    PrefixRib& r = ribs_[id];
+    if (rov_invalid && is_rov(o)) return;
+
+    const uint8_t origin = static_cast<uint8_t>(Relationship::ORIGIN);
+    if (!better(origin, 1, origin_asn,
+                r.rel[o], r.path_len[o], r.next_hop[o]))
+      return;
+
+    r.rel[o]      = origin;
+    r.invalid[o]  = rov_invalid;
+    r.path_len[o] = 1;
+    r.next_hop[o] = origin_asn;
+    r.path[o]     = kEmptyPath;
+  }
+
+  template <typename Seeds>
+  void seed_prefixes(const Seeds& seeds)
+  {
+    for (const auto& s : seeds)
+      seed_prefix(s.prefix, s.origin_asn, s.rov_invalid);
+  }
+
+  void propagate_up()
+  {
+    for (PrefixRib& r : ribs_)
+      for (const auto& layer : layers_)
+        for (uint32_t id : layer)
+        {
+          if (r.rel[id] == kNoRoute) continue;
+          const CSRNode node = graph_.get(id);
+          if (node.providers.empty()) continue;
+
+          const uint32_t asn = graph_.asn_of(id);
+          const uint32_t fwd_path = paths_.append(asn, r.path[id]);
+          for (uint32_t provider : node.providers)
+            offer(r, r, id, asn, provider, fwd_path, Relationship::FROM_CUSTOMER);
+        }
+  }
+
+  void propagate_across_peers()
+  {
+    const uint32_t n = static_cast<uint32_t>(graph_.size());
+
+    for (PrefixRib& r : ribs_)
+    {
+      PrefixRib& scratch = peer_scratch_;
+      if (scratch.rel.size() != n)
+        scratch = PrefixRib(n);
+      else
+        std::fill(scratch.rel.begin(), scratch.rel.end(), kNoRoute);
+
+      for (uint32_t id = 1; id < n; ++id)
+      {
+        if (r.rel[id] == kNoRoute) continue;
+        const CSRNode node = graph_.get(id);
+        if (node.peers.empty()) continue;
+
+        const uint32_t asn = graph_.asn_of(id);
+        const uint32_t fwd_path = paths_.append(asn, r.path[id]);
+        for (uint32_t peer : node.peers)
+          offer(r, scratch, id, asn, peer, fwd_path, Relationship::FROM_PEER);
+      }
+
+      for (uint32_t id = 1; id < n; ++id)
+        merge(scratch, r, id);
+    }
+  }
+
+  void propagate_down()
+  {
+    for (PrefixRib& r : ribs_)
+      for (std::size_t i = layers_.size(); i-- > 0;)
+        for (uint32_t id : layers_[i])
+        {
+          if (r.rel[id] == kNoRoute) continue;
+          const CSRNode node = graph_.get(id);
+          if (node.customers.empty()) continue;
+
+          const uint32_t asn = graph_.asn_of(id);
+          const uint32_t fwd_path = paths_.append(asn, r.path[id]);
+          for (uint32_t customer : node.customers)
+            offer(r, r, id, asn, customer, fwd_path, Relationship::FROM_PROVIDER);
+        }
+  }
+
+  void propagate_all()
+  {
+    propagate_up();
+    propagate_across_peers();
+    propagate_down();
+  }
+};
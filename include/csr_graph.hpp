@@ -0,0 +1,283 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include "as_graph.hpp"
+
+// Read-only view over a contiguous run of neighbor ids.
+struct NeighborRange
+{
+  const uint32_t* first = nullptr;
+  const uint32_t* last  = nullptr;
+
+  const uint32_t* begin() const noexcept { return first; }
+  const uint32_t* end()   const noexcept { return last; }
+  std::size_t size() const noexcept { return static_cast<std::size_t>(last - first); }
+  bool empty() const noexcept { return first == last; }
+  uint32_t operator[](std::size_t i) const noexcept { return first[i]; }
+};
+
+struct CSRNode
+{
+  NeighborRange providers;
+  NeighborRange customers;
+  NeighborRange peers;
+};
+
+// Frozen compressed-sparse-row form of ASGraph.  Each relationship kind is one
+// offsets array (size() + 1 entries) plus one flat neighbor array, so walking
+// a layer touches a few contiguous buffers instead of three vectors per AS.
+// Ids are the same as in the ASGraph it was built from.
+class CSRGraph
+{
+  std::vector<uint32_t> asns_;          // id -> ASN
+  std::vector<uint32_t> sorted_asns_;   // ascending, for id_of()
+  std::vector<uint32_t> sorted_ids_;    // id of sorted_asns_[i]
+
+  std::vector<uint32_t> provider_off_, providers_;
+  std::vector<uint32_t> customer_off_, customers_;
+  std::vector<uint32_t> peer_off_,     peers_;
+
+  template <typename Member>
+  static void pack(const ASGraph& g, Member member,
+                   std::vector<uint32_t>& off, std::vector<uint32_t>& adj)
+  {
+    const std::size_t n = g.size();
+    off.assign(n + 1, 0);
+    for (uint32_t id = 0; id < n; ++id)
+      off[id + 1] = off[id] + static_cast<uint32_t>((g.get(id).*member).size());
+
+    adj.resize(off[n]);
+    for (uint32_t id = 0; id < n; ++id)
+    {
+      const auto& list = g.get(id).*member;
+      std::copy(list.begin(), list.end(), adj.begin() + off[id]);
+    }
+    dedup(off, adj);
+  }
+
+  void index_asns()
+  {
+    const std::size_t n = asns_.size();
+    sorted_ids_.resize(n > 0 ? n - 1 : 0);
+    for (uint32_t id = 1; id < n; ++id)
+      sorted_ids_[id - 1] = id;
+    std::sort(sorted_ids_.begin(), sorted_ids_.end(),
+              [&](uint32_t a, uint32_t b) { return asns_[a] < asns_[b]; });
+    sorted_asns_.resize(sorted_ids_.size());
+    for (std::size_t i = 0; i < sorted_ids_.size(); ++i)
+      sorted_asns_[i] = asns_[sorted_ids_[i]];
+  }
+
+  static NeighborRange range(const std::vector<uint32_t>& off,
+                             const std::vector<uint32_t>& adj,
+                             uint32_t id) noexcept
+  {
+    return NeighborRange{adj.data() + off[id], adj.data() + off[id + 1]};
+  }
+
+  static void sort_by_rank(const std::vector<uint32_t>& off,
+                           std::vector<uint32_t>& adj,
+                           const std::vector<int>& rank)
+  {
+    for (std::size_t id = 0; id + 1 < off.size(); ++id)
+      std::sort(adj.begin() + off[id], adj.begin() + off[id + 1],
+                [&](uint32_t a, uint32_t b) {
+                  return rank[a] != rank[b] ? rank[a] < rank[b] : a < b;
+                });
+  }
+
+public:
+  // A relationship that appears more than once in the input is kept once:
+  // every list is sorted by id and its repeats dropped (on the pool when
+  // given), then adj is compacted in place.
+  static void dedup(std::vector<uint32_t>& off, std::vector<uint32_t>& adj,
+                    ThreadPool* pool = nullptr)
+  {
+    const std::size_t n = off.size() - 1;
+    std::vector<uint32_t> kept(n);
+    auto sort_lists = [&](std::size_t begin, std::size_t end, unsigned) {
+      for (std::size_t id = begin; id < end; ++id)
+      {
+        auto first = adj.begin() + off[id];
+        auto last  = adj.begin() + off[id + 1];
+        std::sort(first, last);
+        kept[id] = static_cast<uint32_t>(std::unique(first, last) - first);
+      }
+    };
+    if (pool)
+      pool->parallel_for(n, 4096, sort_lists);
+    else
+      sort_lists(0, n, 0);
+
+    uint32_t out = 0;
+    for (std::size_t id = 0; id < n; ++id)
+    {
+      auto first = adj.begin() + off[id];
+      off[id] = out;
+      out = static_cast<uint32_t>(std::copy(first, first + kept[id], adj.begin() + out) -
+                                  adj.begin());
+    }
+    off[n] = out;
+    adj.resize(out);
+  }
+
+  CSRGraph() = default;
+
+  explicit CSRGraph(const ASGraph& g)
+  {
+    const std::size_t n = g.size();
+    asns_.resize(n);
+    for (uint32_t id = 0; id < n; ++id)
+      asns_[id] = g.asn_of(id);
+    index_asns();
+
+    pack(g, &ASNode::providers, provider_off_, providers_);
+    pack(g, &ASNode::customers, customer_off_, customers_);
+    pack(g, &ASNode::peers,     peer_off_,     peers_);
+  }
+
+  // Adopts prebuilt arrays (see load_csr_graph): asns[id] for every id,
+  // sentinel 0 included, and per relationship kind size() + 1 offsets into
+  // a flat list of neighbor ids without repeats.
+  CSRGraph(std::vector<uint32_t> asns,
+           std::vector<uint32_t> provider_off, std::vector<uint32_t> providers,
+           std::vector<uint32_t> customer_off, std::vector<uint32_t> customers,
+           std::vector<uint32_t> peer_off, std::vector<uint32_t> peers)
+    : asns_(std::move(asns)),
+      provider_off_(std::move(provider_off)), providers_(std::move(providers)),
+      customer_off_(std::move(customer_off)), customers_(std::move(customers)),
+      peer_off_(std::move(peer_off)), peers_(std::move(peers))
+  {
+    index_asns();
+  }
+
+  // Sort every neighbor list by (rank, id) so propagation sweeps visit
+  // neighbors in layer order.
+  void order_neighbors_by_rank(const std::vector<int>& rank)
+  {
+    sort_by_rank(provider_off_, providers_, rank);
+    sort_by_rank(customer_off_, customers_, rank);
+    sort_by_rank(peer_off_,     peers_,     rank);
+  }
+
+  // The same graph with every id renumbered: id becomes new_id[id], where
+  // new_id is a permutation that keeps the sentinel at 0.  Lists come out
+  // sorted by new id.
+  CSRGraph relabeled(const std::vector<uint32_t>& new_id) const
+  {
+    const std::size_t n = size();
+    std::vector<uint32_t> old_id(n);
+    for (uint32_t id = 0; id < n; ++id)
+      old_id[new_id[id]] = id;
+
+    std::vector<uint32_t> asns(n);
+    for (uint32_t id = 0; id < n; ++id)
+      asns[id] = asns_[old_id[id]];
+
+    auto permute = [&](const std::vector<uint32_t>& off,
+                       const std::vector<uint32_t>& adj,
+                       std::vector<uint32_t>& out_off,
+                       std::vector<uint32_t>& out_adj) {
+      out_off.assign(n + 1, 0);
+      out_adj.resize(adj.size());
+      for (uint32_t id = 0; id < n; ++id)
+      {
+        const uint32_t old = old_id[id];
+        auto first = out_adj.begin() + out_off[id];
+        auto last = std::transform(adj.begin() + off[old], adj.begin() + off[old + 1],
+                                   first, [&](uint32_t v) { return new_id[v]; });
+        std::sort(first, last);
+        out_off[id + 1] = static_cast<uint32_t>(last - out_adj.begin());
+      }
+    };
+
+    std::vector<uint32_t> po, pa, co, ca, eo, ea;
+    permute(provider_off_, providers_, po, pa);
+    permute(customer_off_, customers_, co, ca);
+    permute(peer_off_,     peers_,     eo, ea);
+    return CSRGraph(std::move(asns), std::move(po), std::move(pa),
+                    std::move(co), std::move(ca), std::move(eo), std::move(ea));
+  }
+
+  // Every backing array in a fixed order, for serializing the graph as-is.
+  template <typename Self, typename Fn>
+  static void for_each_array(Self& g, Fn&& fn)
+  {
+    fn(g.asns_);
+    fn(g.sorted_asns_);
+    fn(g.sorted_ids_);
+    fn(g.provider_off_);
+    fn(g.providers_);
+    fn(g.customer_off_);
+    fn(g.customers_);
+    fn(g.peer_off_);
+    fn(g.peers_);
+  }
+
+  // Structural consistency of arrays that did not come from an ASGraph.
+  bool well_formed() const noexcept
+  {
+    const std::size_t n = asns_.size();
+    if (sorted_asns_.size() != sorted_ids_.size() ||
+        sorted_ids_.size() != (n > 0 ? n - 1 : 0))
+      return false;
+    for (std::size_t i = 0; i < sorted_ids_.size(); ++i)
+      if (sorted_ids_[i] >= n || asns_[sorted_ids_[i]] != sorted_asns_[i] ||
+          (i > 0 && sorted_asns_[i - 1] >= sorted_asns_[i]))
+        return false;
+
+    auto check = [n](const std::vector<uint32_t>& off,
+                     const std::vector<uint32_t>& adj) {
+      if (off.size() != n + 1 || off[0] != 0 || off[n] != adj.size())
+        return false;
+      for (std::size_t id = 0; id < n; ++id)
+        if (off[id] > off[id + 1]) return false;
+      for (uint32_t v : adj)
+        if (v == 0 || v >= n) return false;
+      return true;
+    };
+    return n > 0 &&
+           check(provider_off_, providers_) &&
+           check(customer_off_, customers_) &&
+           check(peer_off_, peers_);
+  }
+
+  std::size_t size() const noexcept
+  {
+    return asns_.size();
+  }
+
+  uint32_t asn_of(uint32_t id) const noexcept
+  {
+    return asns_[id];
+  }
+
+  uint32_t id_of(uint32_t asn) const noexcept
+  {
+    auto it = std::lower_bound(sorted_asns_.begin(), sorted_asns_.end(), asn);
+    if (asn == 0 || it == sorted_asns_.end() || *it != asn) return kNoId;
+    return sorted_ids_[static_cast<std::size_t>(it - sorted_asns_.begin())];
+  }
+
+  NeighborRange providers(uint32_t id) const noexcept
+  {
+    return range(provider_off_, providers_, id);
+  }
+
+  NeighborRange customers(uint32_t id) const noexcept
+  {
+    return range(customer_off_, customers_, id);
+  }
+
+  NeighborRange peers(uint32_t id) const noexcept
+  {
+    return range(peer_off_, peers_, id);
+  }
+
+  CSRNode get(uint32_t id) const noexcept
+  {
+    return CSRNode{providers(id), customers(id), peers(id)};
+  }
+};
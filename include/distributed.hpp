@@ -0,0 +1,568 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <map>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <cerrno>
+#include <stdexcept>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "topology_snapshot.hpp"
+#include "bgp_sim.hpp"
+#include "binary_output.hpp"
+#include "read_inputs.hpp"
+#include "seed.hpp"
+
+// Coordinator/worker mode for runs whose RIBs do not fit on one machine even
+// when sharded.  The coordinator holds the topology and the prefix shards;
+// every worker connects over TCP, receives the topology snapshot and the ROV
+// set once, then asks for shards one at a time, runs propagate_all on each
+// and streams the result back in the binary RIB format.  Shards of a worker
+// that disconnects, or takes longer than the result timeout, are handed to
+// the others; a worker that reports a failure stops the run.
+//
+// Every message is a frame header {type, payload size} followed by the
+// payload.  Frames use native byte order, like the snapshot, and the HELLO
+// a worker opens with lets the coordinator reject a mismatch:
+//
+//   HELLO     worker -> coordinator  protocol version, byte-order mark
+//   TOPOLOGY  coordinator -> worker  topology snapshot
+//   ROV_ASNS  coordinator -> worker  uint32 ASNs
+//   SHARD     coordinator -> worker  uint64 shard index, announcements CSV
+//   RESULT    worker -> coordinator  uint64 shard index, binary RIB file
+//   FAILED    worker -> coordinator  error message
+//   DONE      coordinator -> worker  no more shards
+constexpr uint32_t kWireProtocolVersion = 1;
+
+namespace detail {
+
+enum class WireType : uint32_t
+{
+  HELLO = 1,
+  TOPOLOGY,
+  ROV_ASNS,
+  SHARD,
+  RESULT,
+  FAILED,
+  DONE
+};
+
+struct WireHeader
+{
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t size;
+};
+
+// Largest payload accepted for each message type; the size in a frame
+// header comes from the peer and is checked before anything is allocated.
+inline uint64_t max_payload(WireType type)
+{
+  switch (type)
+  {
+    case WireType::HELLO:    return 2 * sizeof(uint32_t);
+    case WireType::DONE:     return 0;
+    case WireType::FAILED:   return uint64_t(64) << 10;
+    case WireType::ROV_ASNS: return uint64_t(1) << 30;
+    case WireType::SHARD:    return uint64_t(4) << 30;
+    case WireType::TOPOLOGY:
+    case WireType::RESULT:   return uint64_t(64) << 30;
+  }
+  return 0;
+}
+
+struct WireMessage
+{
+  WireType type;
+  std::string payload;
+};
+
+class Socket
+{
+  int fd_ = -1;
+
+public:
+  explicit Socket(int fd = -1) noexcept : fd_(fd) {}
+  Socket(Socket&& o) noexcept : fd_(o.fd_) { o.fd_ = -1; }
+  Socket& operator=(Socket&& o) noexcept
+  {
+    std::swap(fd_, o.fd_);
+    return *this;
+  }
+  Socket(const Socket&) = delete;
+  Socket& operator=(const Socket&) = delete;
+  ~Socket() { close(); }
+
+  int fd() const noexcept { return fd_; }
+  bool open() const noexcept { return fd_ >= 0; }
+
+  void close() noexcept
+  {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+  }
+
+  // Bounds how long a single send or receive may block; zero blocks for
+  // as long as it takes.
+  void set_timeout(std::chrono::milliseconds t) noexcept
+  {
+    timeval tv{};
+    tv.tv_sec = static_cast<time_t>(t.count() / 1000);
+    tv.tv_usec = static_cast<suseconds_t>(t.count() % 1000 * 1000);
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  }
+
+  void send_all(const void* data, std::size_t n)
+  {
+    const char* p = static_cast<const char*>(data);
+    while (n > 0)
+    {
+      const ssize_t k = ::send(fd_, p, n, MSG_NOSIGNAL);
+      if (k < 0 && errno == EINTR) continue;
+      if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        throw std::runtime_error("Timed out sending to peer");
+      if (k <= 0) throw std::runtime_error("Connection lost while sending");
+      p += k;
+      n -= static_cast<std::size_t>(k);
+    }
+  }
+
+  void recv_all(void* data, std::size_t n)
+  {
+    char* p = static_cast<char*>(data);
+    while (n > 0)
+    {
+      const ssize_t k = ::recv(fd_, p, n, 0);
+      if (k < 0 && errno == EINTR) continue;
+      if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        throw std::runtime_error("Timed out waiting for peer");
+      if (k <= 0) throw std::runtime_error("Connection lost while receiving");
+      p += k;
+      n -= static_cast<std::size_t>(k);
+    }
+  }
+
+  // the payload is `head` followed by `body`, sent without joining them
+  void send_message(WireType type, std::string_view head, std::string_view body = {})
+  {
+    const WireHeader h{static_cast<uint32_t>(type), 0, head.size() + body.size()};
+    send_all(&h, sizeof(h));
+    send_all(head.data(), head.size());
+    send_all(body.data(), body.size());
+  }
+
+  WireMessage recv_message()
+  {
+    WireHeader h;
+    recv_all(&h, sizeof(h));
+    if (h.type < static_cast<uint32_t>(WireType::HELLO) ||
+        h.type > static_cast<uint32_t>(WireType::DONE))
+      throw std::runtime_error("Malformed message from peer");
+    WireMessage msg{static_cast<WireType>(h.type), {}};
+    if (h.size > max_payload(msg.type))
+      throw std::runtime_error("Oversized message from peer");
+
+    // grown as bytes arrive, so a lying header costs no more than was sent
+    constexpr std::size_t kChunk = std::size_t(1) << 20;
+    for (std::size_t got = 0; got < h.size;)
+    {
+      const std::size_t n = static_cast<std::size_t>(std::min<uint64_t>(h.size - got, kChunk));
+      msg.payload.resize(got + n);
+      recv_all(msg.payload.data() + got, n);
+      got += n;
+    }
+    return msg;
+  }
+};
+
+inline Socket listen_on(uint16_t port)
+{
+  Socket s(::socket(AF_INET, SOCK_STREAM, 0));
+  if (!s.open()) throw std::runtime_error("Failed to create socket");
+  const int yes = 1;
+  ::setsockopt(s.fd(), SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (::bind(s.fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::listen(s.fd(), 64) != 0)
+    throw std::runtime_error("Failed to listen on port " + std::to_string(port));
+  return s;
+}
+
+// Retries for a while so workers may be started before the coordinator.
+inline Socket connect_to(const std::string& host, uint16_t port)
+{
+  constexpr int kAttempts = 100;
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* found = nullptr;
+  if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0)
+    throw std::runtime_error("Cannot resolve coordinator host: " + host);
+  std::unique_ptr<addrinfo, decltype(&::freeaddrinfo)> addrs(found, &::freeaddrinfo);
+
+  for (int attempt = 0; attempt < kAttempts; ++attempt)
+  {
+    for (const addrinfo* a = addrs.get(); a; a = a->ai_next)
+    {
+      Socket s(::socket(a->ai_family, a->ai_socktype, a->ai_protocol));
+      if (s.open() && ::connect(s.fd(), a->ai_addr, a->ai_addrlen) == 0) return s;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  throw std::runtime_error("Cannot connect to coordinator " + host + ":" +
+                           std::to_string(port));
+}
+
+inline std::string_view wire_bytes(const void* p, std::size_t n)
+{
+  return std::string_view(static_cast<const char*>(p), n);
+}
+
+inline uint64_t read_shard_index(const WireMessage& msg)
+{
+  uint64_t k;
+  if (msg.payload.size() < sizeof(k)) throw std::runtime_error("Malformed message from peer");
+  std::memcpy(&k, msg.payload.data(), sizeof(k));
+  return k;
+}
+
+inline std::string shard_announcements(const std::vector<Seed>& seeds)
+{
+  std::string text;
+  for (const Seed& s : seeds)
+  {
+    append_uint(text, s.origin_asn);
+    text += ',';
+    text += s.prefix;
+    text += s.rov_invalid ? ",1\n" : ",0\n";
+  }
+  return text;
+}
+
+} // namespace detail
+
+class Coordinator
+{
+  detail::Socket listener_;
+  uint16_t port_ = 0;
+  std::chrono::milliseconds handshake_timeout_{30000};
+  std::chrono::milliseconds result_timeout_{std::chrono::minutes(30)};
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Worker
+  {
+    detail::Socket socket;
+    std::size_t shard = kIdle;
+    Clock::time_point deadline;   // for the result of `shard`
+  };
+  static constexpr std::size_t kIdle = SIZE_MAX;
+
+  // best effort: a worker already gone needs no DONE
+  static void dismiss(std::vector<Worker>& pool) noexcept
+  {
+    for (Worker& w : pool)
+      if (w.socket.open())
+      {
+        try
+        {
+          w.socket.send_message(detail::WireType::DONE, {});
+        }
+        catch (const std::runtime_error&) {}
+      }
+  }
+
+public:
+  // Listens on `port`; 0 picks a free port, see port().
+  explicit Coordinator(uint16_t port)
+    : listener_(detail::listen_on(port))
+  {
+    sockaddr_in addr{};
+    socklen_t len = sizeof(addr);
+    ::getsockname(listener_.fd(), reinterpret_cast<sockaddr*>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+  }
+
+  uint16_t port() const noexcept
+  {
+    return port_;
+  }
+
+  // How long a connecting worker may take to say HELLO and to take the
+  // topology and ROV set; a connection that runs over is dropped.
+  void set_handshake_timeout(std::chrono::milliseconds t) noexcept
+  {
+    handshake_timeout_ = t;
+  }
+
+  // How long a worker may take to return a shard, and to take one; a worker
+  // that runs over is dropped like a lost one and its shard dealt again.
+  // Zero waits for as long as it takes.
+  void set_result_timeout(std::chrono::milliseconds t) noexcept
+  {
+    result_timeout_ = t;
+  }
+
+  // Waits for `workers` workers, sends each the topology and the ROV set,
+  // then deals out the shards.  A connection that fails the handshake (a
+  // port probe, a bad HELLO, another protocol version) is closed and does
+  // not count as a worker.  on_result(shard_index, ribs) runs on the
+  // calling thread strictly in shard order, as run_sharded's callback does,
+  // so each result can go straight to the output.
+  // Throws if a worker reports a failure or every worker is lost; the
+  // remaining workers are sent DONE first, so they exit cleanly.
+  template <typename ShardDone>
+  void run(const Topology& topo,
+           const std::vector<uint32_t>& rov_asns,
+           const std::vector<std::vector<Seed>>& shards,
+           std::size_t workers,
+           ShardDone&& on_result)
+  {
+    using detail::WireType;
+
+    std::ostringstream snapshot;
+    write_topology_snapshot(topo, snapshot);
+    const std::string snap = snapshot.str();
+
+    std::vector<Worker> pool;
+    while (pool.size() < workers)
+    {
+      detail::Socket s(::accept(listener_.fd(), nullptr, nullptr));
+      if (!s.open())
+      {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        throw std::runtime_error("Failed to accept a worker");
+      }
+
+      try
+      {
+        s.set_timeout(handshake_timeout_);
+        const detail::WireMessage hello = s.recv_message();
+        uint32_t ids[2] = {};
+        if (hello.type != WireType::HELLO || hello.payload.size() != sizeof(ids))
+          throw std::runtime_error("Worker did not introduce itself");
+        std::memcpy(ids, hello.payload.data(), sizeof(ids));
+        if (ids[0] != kWireProtocolVersion || ids[1] != detail::kSnapshotByteOrder)
+          throw std::runtime_error("Worker speaks another protocol version or byte order");
+
+        s.send_message(WireType::TOPOLOGY, snap);
+        s.send_message(WireType::ROV_ASNS,
+                       detail::wire_bytes(rov_asns.data(), rov_asns.size() * sizeof(uint32_t)));
+        s.set_timeout(result_timeout_);
+      }
+      catch (const std::runtime_error&)
+      {
+        continue;   // not a worker; the socket closes here
+      }
+      pool.push_back(Worker{std::move(s), kIdle, Clock::time_point{}});
+    }
+
+    std::deque<std::size_t> pending;
+    for (std::size_t k = 0; k < shards.size(); ++k) pending.push_back(k);
+    std::map<std::size_t, BinaryRibs> ready;   // results that arrived early
+    std::size_t delivered = 0;
+
+    auto deal = [&](Worker& w) {
+      if (pending.empty() || !w.socket.open()) return;
+      const uint64_t k = pending.front();
+      try
+      {
+        w.socket.send_message(WireType::SHARD, detail::wire_bytes(&k, sizeof(k)),
+                              detail::shard_announcements(shards[k]));
+        pending.pop_front();
+        w.shard = k;
+        w.deadline = Clock::now() + result_timeout_;
+      }
+      catch (const std::runtime_error&)
+      {
+        w.socket.close();
+      }
+    };
+
+    // the shard goes to whoever asks next
+    auto lose = [&](Worker& w) {
+      pending.push_front(w.shard);
+      w.shard = kIdle;
+      w.socket.close();
+    };
+
+    try
+    {
+      std::vector<pollfd> fds;
+      std::vector<Worker*> polled;
+      while (delivered < shards.size())
+      {
+        for (Worker& w : pool)
+          if (w.shard == kIdle) deal(w);
+
+        fds.clear();
+        polled.clear();
+        for (Worker& w : pool)
+          if (w.socket.open() && w.shard != kIdle)
+          {
+            fds.push_back(pollfd{w.socket.fd(), POLLIN, 0});
+            polled.push_back(&w);
+          }
+        if (fds.empty()) throw std::runtime_error("All workers were lost");
+
+        // until the earliest deadline
+        int wait = -1;
+        if (result_timeout_.count() > 0)
+        {
+          Clock::time_point first = polled.front()->deadline;
+          for (const Worker* w : polled) first = std::min(first, w->deadline);
+          const auto left = std::chrono::ceil<std::chrono::milliseconds>(first - Clock::now());
+          wait = static_cast<int>(std::max<std::chrono::milliseconds::rep>(
+            0, std::min<std::chrono::milliseconds::rep>(left.count(), INT_MAX)));
+        }
+
+        if (::poll(fds.data(), fds.size(), wait) < 0)
+        {
+          if (errno == EINTR) continue;
+          throw std::runtime_error("poll failed");
+        }
+
+        const Clock::time_point now = Clock::now();
+        for (std::size_t i = 0; i < fds.size(); ++i)
+        {
+          Worker& w = *polled[i];
+          if (!fds[i].revents)
+          {
+            if (result_timeout_.count() > 0 && now >= w.deadline) lose(w);
+            continue;
+          }
+
+          detail::WireMessage msg;
+          try
+          {
+            msg = w.socket.recv_message();
+          }
+          catch (const std::runtime_error&)
+          {
+            lose(w);
+            continue;
+          }
+
+          // Intentionally not dealt again: a shard a worker could not
+          // compute (bad input, out of memory) would most likely fail on
+          // the next one too, and a run with a shard missing must not look
+          // complete, so the whole run stops.
+          if (msg.type == WireType::FAILED)
+            throw std::runtime_error("Worker failed on shard " + std::to_string(w.shard) +
+                                     ": " + msg.payload);
+          if (msg.type != WireType::RESULT || detail::read_shard_index(msg) != w.shard)
+            throw std::runtime_error("Unexpected message from worker");
+
+          ready.emplace(w.shard, parse_routing_binary(
+                                   std::string_view(msg.payload).substr(sizeof(uint64_t))));
+          w.shard = kIdle;
+          for (auto it = ready.begin(); it != ready.end() && it->first == delivered;
+               it = ready.erase(it), ++delivered)
+            on_result(delivered, static_cast<const BinaryRibs&>(it->second));
+        }
+      }
+    }
+    catch (...)
+    {
+      dismiss(pool);
+      throw;
+    }
+    dismiss(pool);
+  }
+};
+
+// Connects to a coordinator and serves shards until it says DONE; returns
+// the number of shards served.  configure(sim) runs once on the worker's
+// simulator, e.g. to set its thread count, before the first shard.
+template <typename Configure>
+std::size_t run_worker(const std::string& host, uint16_t port, Configure&& configure)
+{
+  using detail::WireType;
+
+  detail::Socket s = detail::connect_to(host, port);
+  const uint32_t hello[2] = {kWireProtocolVersion, detail::kSnapshotByteOrder};
+  s.send_message(WireType::HELLO, detail::wire_bytes(hello, sizeof(hello)));
+
+  detail::WireMessage msg = s.recv_message();
+  if (msg.type != WireType::TOPOLOGY) throw std::runtime_error("Expected the topology");
+  std::shared_ptr<const Topology> topo = parse_topology_snapshot(msg.payload);
+
+  msg = s.recv_message();
+  if (msg.type != WireType::ROV_ASNS || msg.payload.size() % sizeof(uint32_t))
+    throw std::runtime_error("Expected the ROV ASNs");
+  std::vector<uint32_t> rov_asns(msg.payload.size() / sizeof(uint32_t));
+  std::memcpy(rov_asns.data(), msg.payload.data(), msg.payload.size());
+
+  BGPSim sim(topo, rov_asns);
+  configure(sim);
+
+  std::size_t served = 0;
+  std::vector<SeedView> seeds;   // views into the SHARD message
+  for (;;)
+  {
+    msg = s.recv_message();
+    if (msg.type == WireType::DONE) return served;
+    if (msg.type != WireType::SHARD) throw std::runtime_error("Unexpected message from coordinator");
+
+    const uint64_t k = detail::read_shard_index(msg);
+    std::string result;
+    try
+    {
+      seeds.clear();
+      parse_announcements(std::string_view(msg.payload).substr(sizeof(k)),
+                          [&](const SeedView& v) { seeds.push_back(v); });
+      if (served > 0) sim.reset(rov_asns);
+      seed_all(sim, seeds);
+      sim.propagate_all();
+
+      BinaryRibWriter writer;
+      writer.add(sim);
+      std::ostringstream out;
+      writer.write(out);
+      result = out.str();
+    }
+    catch (const std::exception& ex)
+    {
+      s.send_message(WireType::FAILED, ex.what());
+      throw;
+    }
+    try
+    {
+      s.send_message(WireType::RESULT, detail::wire_bytes(&k, sizeof(k)), result);
+    }
+    catch (const std::runtime_error&)
+    {
+      // a coordinator whose run failed dismisses busy workers too and may
+      // hang up before reading this result
+      if (s.recv_message().type == WireType::DONE) return served;
+      throw;
+    }
+    ++served;
+  }
+}
+
+inline std::size_t run_worker(const std::string& host, uint16_t port)
+{
+  return run_worker(host, port, [](BGPSim&) {});
+}
@@ -0,0 +1,285 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include "parser.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include "csr_graph.hpp"
+
+// Parallel relationships loader that builds a CSRGraph directly, without an
+// ASGraph in between:
+//
+//   1. the records after the leading headers are split into newline-aligned
+//      chunks, parsed on every worker into per-chunk edge lists over
+//      chunk-local ids, numbered as the chunk first sees each ASN;
+//   2. global ids are assigned by merging the chunks' ASN lists in file
+//      order, so they match build_graph's; edges are then translated in
+//      parallel;
+//   3. neighbor counts are summed into offsets and the edges scattered into
+//      the flat arrays (a counting sort), then repeated edges are dropped.
+//
+// Errors are the ones build_graph throws, for the first bad line in file
+// order.
+namespace detail {
+
+// Open-addressing ASN -> id map.  A load does a few lookups per edge, and
+// linear probing over one flat array is far cheaper than unordered_map.
+class AsnIndex
+{
+  static constexpr uint64_t kFree = UINT64_MAX;
+
+  std::vector<uint64_t> slots_;   // asn << 32 | id
+  unsigned bits_ = 0;
+  std::size_t size_ = 0;
+
+  std::size_t home(uint32_t asn) const noexcept
+  {
+    return static_cast<std::size_t>((uint64_t{asn} * 0x9E3779B97F4A7C15ull) >> (64 - bits_));
+  }
+
+  void grow()
+  {
+    std::vector<uint64_t> old(std::size_t{1} << (bits_ + 1), kFree);
+    old.swap(slots_);
+    ++bits_;
+    const std::size_t mask = slots_.size() - 1;
+    for (uint64_t slot : old)
+      if (slot != kFree)
+      {
+        std::size_t i = home(static_cast<uint32_t>(slot >> 32));
+        while (slots_[i] != kFree) i = (i + 1) & mask;
+        slots_[i] = slot;
+      }
+  }
+
+public:
+  explicit AsnIndex(std::size_t expected = 1024)
+  {
+    while ((std::size_t{1} << bits_) < 2 * expected) ++bits_;
+    slots_.assign(std::size_t{1} << bits_, kFree);
+  }
+
+  // id of asn, which is given `id` if it was not there yet
+  uint32_t insert(uint32_t asn, uint32_t id)
+  {
+    if (2 * (size_ + 1) > slots_.size()) grow();
+    const std::size_t mask = slots_.size() - 1;
+    for (std::size_t i = home(asn);; i = (i + 1) & mask)
+    {
+      if (slots_[i] == kFree)
+      {
+        slots_[i] = (uint64_t{asn} << 32) | id;
+        ++size_;
+        return id;
+      }
+      if (static_cast<uint32_t>(slots_[i] >> 32) == asn)
+        return static_cast<uint32_t>(slots_[i]);
+    }
+  }
+
+  std::size_t size() const noexcept
+  {
+    return size_;
+  }
+};
+
+struct RelEdge
+{
+  uint32_t a, b;   // provider, customer or the two peers; chunk-local ids
+  bool peer;
+};
+
+struct EdgeChunk
+{
+  const char* first = nullptr;
+  const char* last  = nullptr;
+  std::vector<RelEdge> edges;
+  std::vector<uint32_t> asns;   // local id -> ASN, in order of first appearance
+  std::string error;
+};
+
+inline void parse_edge_chunk(EdgeChunk& chunk)
+{
+  constexpr std::size_t kBatch = 1024;
+  DataRecord batch[kBatch];
+  std::string_view bad;
+  AsnIndex local(static_cast<std::size_t>(chunk.last - chunk.first) / 64);
+
+  auto note = [&](uint32_t asn) {
+    const auto next = static_cast<uint32_t>(chunk.asns.size());
+    const uint32_t id = local.insert(asn, next);
+    if (id == next) chunk.asns.push_back(asn);
+    return id;
+  };
+
+  const char* p = chunk.first;
+  while (p < chunk.last)
+  {
+    const std::size_t n = parse_records(p, chunk.last, batch, kBatch, &bad);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      const DataRecord& rec = batch[i];
+      if (rec.indicator != -1 && rec.indicator != 0)
+      {
+        chunk.error = "Unexpected indicator value in CAIDA file";
+        return;
+      }
+      const uint32_t a = note(rec.provider_peer);
+      const uint32_t b = note(rec.customer_peer);
+      chunk.edges.push_back(RelEdge{a, b, rec.indicator == 0});
+    }
+    if (bad.data())
+    {
+      chunk.error = "Malformed line found: " + std::string(bad);
+      return;
+    }
+  }
+}
+
+} // namespace detail
+
+inline CSRGraph build_csr_graph(std::string_view text, unsigned threads = 1)
+{
+  using detail::EdgeChunk;
+  using detail::RelEdge;
+
+  const char* p   = text.data();
+  const char* end = p + text.size();
+
+  // skips past all headers and empty lines
+  while (p < end)
+  {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (nl != p && *p != '#') break;
+    p = nl ? nl + 1 : end;
+  }
+
+  ThreadPool pool(threads);
+  constexpr std::size_t kMinChunk = std::size_t{1} << 18;
+  const std::size_t bytes = static_cast<std::size_t>(end - p);
+  const std::size_t want = std::max<std::size_t>(
+    1, std::min<std::size_t>(4 * pool.size(), bytes / kMinChunk));
+
+  std::vector<EdgeChunk> chunks;
+  for (std::size_t k = 0; k < want && p < end; ++k)
+  {
+    const char* last = k + 1 == want ? end : p + bytes / want;
+    if (last < end)
+    {
+      const char* nl = static_cast<const char*>(std::memchr(last, '\n', end - last));
+      last = nl ? nl + 1 : end;
+    }
+    if (last <= p) continue;
+    chunks.emplace_back();
+    chunks.back().first = p;
+    chunks.back().last = last;
+    p = last;
+  }
+
+  pool.parallel_for(chunks.size(), 1, [&](std::size_t begin, std::size_t stop, unsigned) {
+    for (std::size_t k = begin; k < stop; ++k) detail::parse_edge_chunk(chunks[k]);
+  });
+  for (const EdgeChunk& c : chunks)
+    if (!c.error.empty()) throw std::runtime_error(c.error);
+
+  // ids in order of first appearance anywhere in the file; to_global[k]
+  // maps chunk k's local ids
+  std::vector<uint32_t> asns(1, 0);
+  std::vector<std::vector<uint32_t>> to_global(chunks.size());
+  detail::AsnIndex ids(chunks.empty() ? 1 : chunks.front().asns.size());
+  for (std::size_t k = 0; k < chunks.size(); ++k)
+  {
+    to_global[k].reserve(chunks[k].asns.size());
+    for (uint32_t asn : chunks[k].asns)
+    {
+      const auto next = static_cast<uint32_t>(asns.size());
+      const uint32_t id = ids.insert(asn, next);
+      if (id == next) asns.push_back(asn);
+      to_global[k].push_back(id);
+    }
+    chunks[k].asns = std::vector<uint32_t>();
+  }
+  const std::size_t n = asns.size();
+
+  // translate, and count neighbors per id and kind
+  std::unique_ptr<std::atomic<uint32_t>[]> count(new std::atomic<uint32_t>[3 * n]);
+  for (std::size_t i = 0; i < 3 * n; ++i) count[i].store(0, std::memory_order_relaxed);
+  enum : std::size_t { PROVIDERS = 0, CUSTOMERS = 1, PEERS = 2 };
+  auto slot = [n](std::size_t kind, uint32_t id) { return kind * n + id; };
+
+  pool.parallel_for(chunks.size(), 1, [&](std::size_t begin, std::size_t stop, unsigned) {
+    for (std::size_t k = begin; k < stop; ++k)
+      for (RelEdge& e : chunks[k].edges)
+      {
+        e.a = to_global[k][e.a];
+        e.b = to_global[k][e.b];
+        if (e.peer)
+        {
+          count[slot(PEERS, e.a)].fetch_add(1, std::memory_order_relaxed);
+          count[slot(PEERS, e.b)].fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+          count[slot(CUSTOMERS, e.a)].fetch_add(1, std::memory_order_relaxed);
+          count[slot(PROVIDERS, e.b)].fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+  });
+
+  // prefix sums; the counters become each list's write cursor
+  std::vector<uint32_t> off[3], adj[3];
+  for (std::size_t kind = 0; kind < 3; ++kind)
+  {
+    off[kind].assign(n + 1, 0);
+    for (uint32_t id = 0; id < n; ++id)
+    {
+      const uint32_t c = count[slot(kind, id)].load(std::memory_order_relaxed);
+      off[kind][id + 1] = off[kind][id] + c;
+      count[slot(kind, id)].store(off[kind][id], std::memory_order_relaxed);
+    }
+    adj[kind].resize(off[kind][n]);
+  }
+
+  auto put = [&](std::size_t kind, uint32_t id, uint32_t neighbor) {
+    adj[kind][count[slot(kind, id)].fetch_add(1, std::memory_order_relaxed)] = neighbor;
+  };
+  pool.parallel_for(chunks.size(), 1, [&](std::size_t begin, std::size_t stop, unsigned) {
+    for (std::size_t k = begin; k < stop; ++k)
+    {
+      for (const RelEdge& e : chunks[k].edges)
+      {
+        if (e.peer)
+        {
+          put(PEERS, e.a, e.b);
+          put(PEERS, e.b, e.a);
+        }
+        else
+        {
+          put(CUSTOMERS, e.a, e.b);
+          put(PROVIDERS, e.b, e.a);
+        }
+      }
+      chunks[k].edges = std::vector<RelEdge>();
+    }
+  });
+
+  for (std::size_t kind = 0; kind < 3; ++kind)
+    CSRGraph::dedup(off[kind], adj[kind], &pool);
+
+  return CSRGraph(std::move(asns),
+                  std::move(off[PROVIDERS]), std::move(adj[PROVIDERS]),
+                  std::move(off[CUSTOMERS]), std::move(adj[CUSTOMERS]),
+                  std::move(off[PEERS]), std::move(adj[PEERS]));
+}
+
+inline CSRGraph load_csr_graph(const std::string& filename, unsigned threads = 1)
+{
+  MappedFile file(filename);
+  return build_csr_graph(file.view(), threads);
+}
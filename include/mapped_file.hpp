@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file.  An empty file maps to an empty
+// view without calling mmap.
+class MappedFile
+{
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+
+public:
+  explicit MappedFile(const std::string& filename)
+  {
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("Failed to open file: " + filename);
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+      ::close(fd);
+      throw std::runtime_error("Failed to stat file: " + filename);
+    }
+
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ > 0)
+    {
+      void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED)
+      {
+        ::close(fd);
+        throw std::runtime_error("Failed to map file: " + filename);
+      }
+      data_ = static_cast<const char*>(p);
+      ::madvise(p, size_, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+  }
+
+  ~MappedFile()
+  {
+    if (data_) ::munmap(const_cast<char*>(data_), size_);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view view() const noexcept
+  {
+    return std::string_view(data_, size_);
+  }
+};
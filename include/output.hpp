@@ -1,10 +1,122 @@
+#pragma once
 #include <fstream>
-#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <stdexcept>
 #include "bgp_sim.hpp"
+#include "columnar_sim.hpp"
+#include "thread_pool.hpp"
 
-inline void write_routing_csv(const BGPSim& sim,
-                              const std::string& filename)
+// ENGINE writes rows as the engine holds them, which is fastest, but within an
+// AS the order follows hash-map iteration.  CANONICAL sorts rows by ASN, then
+// by prefix name, so equal RIBs always give byte-identical files whatever
+// the engine, thread count, sharding or id order.
+enum class RowOrder : uint8_t
+{
+    ENGINE,
+    CANONICAL
+};
+
+namespace detail {
+
+inline void append_uint(std::string& buf, uint32_t v)
+{
+    char tmp[10];
+    const auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buf.append(tmp, res.ptr);
+}
+
+// asn,prefix,"(asn, next_hop, ..., origin)" with the path read straight
+// out of the path store; a lone origin is written as "(asn,)"
+inline void append_routing_row(std::string& buf,
+                               uint32_t asn,
+                               std::string_view prefix,
+                               const PathStore& paths,
+                               uint32_t path)
+{
+    append_uint(buf, asn);
+    buf += ',';
+    buf.append(prefix);
+    buf += ",\"(";
+    append_uint(buf, asn);
+
+    if (path == kEmptyPath) {
+        buf += ",)\"\n";
+        return;
+    }
+    paths.for_each(path, [&](uint32_t hop) {
+        buf += ", ";
+        append_uint(buf, hop);
+    });
+    buf += ")\"\n";
+}
+
+// fn(prefix_id, path_handle) for every route held by graph id `id`, in the
+// order rows are written
+template <typename Fn>
+inline void for_each_route(const BGPSim& sim, uint32_t id, Fn&& fn)
+{
+    for (const auto& [prefix_id, ann] : sim.policy_at(id).local_rib()) {
+        fn(prefix_id, ann.path);
+    }
+}
+
+template <typename Fn>
+inline void for_each_route(const ColumnarSim& sim, uint32_t id, Fn&& fn)
+{
+    const uint32_t num_prefixes = static_cast<uint32_t>(sim.prefixes().size());
+    for (uint32_t prefix_id = 0; prefix_id < num_prefixes; ++prefix_id) {
+        const auto& rib = sim.rib(prefix_id);
+        if (rib.rel[id] != ColumnarSim::kNoRoute) fn(prefix_id, rib.path[id]);
+    }
+}
+
+// prefix_rank[prefix_id], when given, orders the AS's rows
+template <typename Sim>
+inline void append_as_rows(const Sim& sim, uint32_t id, std::string& buf,
+                           const std::vector<uint32_t>* prefix_rank = nullptr)
+{
+    const uint32_t asn = sim.graph().asn_of(id);
+    if (!prefix_rank) {
+        for_each_route(sim, id, [&](uint32_t prefix_id, uint32_t path) {
+            append_routing_row(buf, asn, sim.prefixes().name(prefix_id),
+                               sim.paths(), path);
+        });
+        return;
+    }
+
+    // (rank, prefix_id, path)
+    static thread_local std::vector<std::array<uint32_t, 3>> routes;
+    routes.clear();
+    for_each_route(sim, id, [&](uint32_t prefix_id, uint32_t path) {
+        routes.push_back({(*prefix_rank)[prefix_id], prefix_id, path});
+    });
+    std::sort(routes.begin(), routes.end());
+    for (const auto& r : routes)
+        append_routing_row(buf, asn, sim.prefixes().name(r[1]), sim.paths(), r[2]);
+}
+
+// rank[prefix_id] = position of the prefix in name order
+inline std::vector<uint32_t> prefix_name_ranks(const PrefixTable& prefixes)
+{
+    std::vector<uint32_t> order(prefixes.size());
+    for (uint32_t p = 0; p < order.size(); ++p) order[p] = p;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return prefixes.name(a) < prefixes.name(b);
+    });
+    std::vector<uint32_t> rank(order.size());
+    for (uint32_t i = 0; i < order.size(); ++i) rank[order[i]] = i;
+    return rank;
+}
+
+} // end of namespace detail
+
+inline std::ofstream open_routing_csv(const std::string& filename)
 {
     std::ofstream out(filename);
     if (!out.is_open()) {
@@ -12,31 +124,101 @@ inline void write_routing_csv(const BGPSim& sim,
     }
 
     out << "asn,prefix,as_path\n";
+    return out;
+}
+
+namespace detail {
 
-    // assuming ASNs start at 1
-    const uint32_t max = sim.max_asn();
-    for (uint32_t asn = 1; asn <= max; ++asn) {
-        const auto& rib = sim.policy(asn).local_rib();
-
-        for (const auto& [prefix, ann] : rib) {
-            out << asn << ',' << prefix << ',';
-
-            const auto& path = ann.as_path;
-            std::ostringstream path_ss;
-
-            if (path.empty()) {
-                path_ss << "()";
-            } else if (path.size() == 1) {
-                path_ss << '(' << path[0] << ",)";
-            } else {
-                path_ss << '(' << path[0];
-                for (std::size_t i = 1; i < path.size(); ++i) {
-                    path_ss << ", " << path[i];
-                }
-                path_ss << ')';
+// Formats the rows of id_at(0) .. id_at(count - 1) in chunks into reusable
+// buffers, several chunks at a time on `pool` when given, and writes each
+// buffer in order as one large write.
+template <typename Sim, typename IdAt>
+inline void write_rows_chunked(const Sim& sim, std::size_t count, IdAt id_at,
+                               std::ostream& out, ThreadPool* pool,
+                               const std::vector<uint32_t>* prefix_rank = nullptr)
+{
+    constexpr std::size_t kChunkAses = 512;
+    constexpr std::size_t kChunkReserve = 1 << 16;
+    if (count == 0) return;
+
+    const std::size_t num_chunks = (count + kChunkAses - 1) / kChunkAses;
+    const std::size_t window =
+        std::min<std::size_t>(num_chunks, std::size_t{pool ? pool->size() : 1u} * 4);
+    std::vector<std::string> bufs(window);
+    for (auto& buf : bufs) buf.reserve(kChunkReserve);
+
+    for (std::size_t first = 0; first < num_chunks; first += window) {
+        const std::size_t n = std::min(window, num_chunks - first);
+
+        auto format = [&](std::size_t begin, std::size_t end, unsigned) {
+            for (std::size_t c = begin; c < end; ++c) {
+                std::string& buf = bufs[c];
+                buf.clear();
+                const std::size_t lo = (first + c) * kChunkAses;
+                const std::size_t hi = std::min(count, lo + kChunkAses);
+                for (std::size_t i = lo; i < hi; ++i)
+                    append_as_rows(sim, id_at(i), buf, prefix_rank);
             }
+        };
+        if (pool) pool->parallel_for(n, 1, format);
+        else      format(0, n, 0);
+
+        for (std::size_t c = 0; c < n; ++c)
+            out.write(bufs[c].data(), static_cast<std::streamsize>(bufs[c].size()));
+    }
+    if (!out) {
+        throw std::runtime_error("Failed to write routing rows");
+    }
+}
+
+} // end of namespace detail
 
-            out << '"' << path_ss.str() << '"' << '\n';
-        }
+// Rows only, no header; sharded runs append one simulator after another.
+// Rows go out in id order (ASN order when canonical), formatted on
+// `threads` threads.
+template <typename Sim>
+inline void write_routing_rows(const Sim& sim, std::ostream& out,
+                               unsigned threads = 1,
+                               RowOrder order = RowOrder::ENGINE)
+{
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 1) pool = std::make_unique<ThreadPool>(threads);
+
+    // id 0 is the graph's sentinel
+    const CSRGraph& g = sim.graph();
+    const std::size_t n = g.size();
+    if (order == RowOrder::ENGINE) {
+        detail::write_rows_chunked(sim, n > 0 ? n - 1 : 0,
+                                   [](std::size_t i) { return static_cast<uint32_t>(i + 1); },
+                                   out, pool.get());
+        return;
     }
+
+    std::vector<uint32_t> ids(n > 0 ? n - 1 : 0);
+    for (std::size_t i = 0; i < ids.size(); ++i) ids[i] = static_cast<uint32_t>(i + 1);
+    std::sort(ids.begin(), ids.end(),
+              [&](uint32_t a, uint32_t b) { return g.asn_of(a) < g.asn_of(b); });
+    const std::vector<uint32_t> rank = detail::prefix_name_ranks(sim.prefixes());
+    detail::write_rows_chunked(sim, ids.size(), [&](std::size_t i) { return ids[i]; },
+                               out, pool.get(), &rank);
+}
+
+// Rows of just `ids`, in that order; used with
+// BGPSim::propagate_down_streaming to write RIBs as they become final.
+template <typename Sim>
+inline void write_routing_rows(const Sim& sim, const std::vector<uint32_t>& ids,
+                               std::ostream& out, ThreadPool* pool = nullptr)
+{
+    detail::write_rows_chunked(sim, ids.size(),
+                               [&](std::size_t i) { return ids[i]; },
+                               out, pool);
+}
+
+template <typename Sim>
+inline void write_routing_csv(const Sim& sim, const std::string& filename,
+                              unsigned threads = 1,
+                              RowOrder order = RowOrder::ENGINE)
+{
+    std::ofstream out = open_routing_csv(filename);
+    write_routing_rows(sim, out, threads, order);
 }
@@ -1,6 +1,20 @@
 #pragma once
+#include <cstddef>
 #include <string_view>
 #include "data_record.hpp"
 
+// Parses "provider|customer|indicator|..." into rec.  ASNs must be plain
+// decimal numbers that fit in 32 bits and the indicator a signed integer;
+// anything else makes the line malformed.
 bool parse_line(std::string_view line, DataRecord& rec);
 int fast_atoi(std::string_view sv) noexcept;
+
+// Bulk form of parse_line over a buffer of newline separated records.
+// Delimiters are located 64 bytes at a time (AVX2 or SSE2 when the CPU has
+// it, a scalar loop otherwise).  Parses up to `capacity` lines starting at
+// `cursor` into `out` and advances `cursor` past them.  Stops early at a
+// malformed line, which is then reported through `bad_line` and left at
+// `cursor`.
+std::size_t parse_records(const char*& cursor, const char* end,
+                          DataRecord* out, std::size_t capacity,
+                          std::string_view* bad_line);
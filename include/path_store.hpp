@@ -0,0 +1,155 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <stdexcept>
+
+// Route paths are stored as cons-lists: every node prepends one ASN to a
+// parent path.  An announcement only carries the handle of the path it was
+// received with (which starts at its next hop), so forwarding a route to N
+// neighbors costs a single node instead of N vector copies.
+constexpr uint32_t kEmptyPath = UINT32_MAX;
+
+struct PathNode
+{
+  uint32_t asn;
+  uint32_t parent;
+};
+
+class PathStore
+{
+  static constexpr uint32_t kChunkBits = 16;
+  static constexpr uint32_t kChunkSize = 1u << kChunkBits;
+  static constexpr uint32_t kChunkMask = kChunkSize - 1;
+  static constexpr uint32_t kMaxChunks = 1u << (32 - kChunkBits);
+
+public:
+  // Range of handles reserved by one writer; lets several threads append
+  // without contending on every node.
+  struct Block
+  {
+    uint32_t next = 0;
+    uint32_t end  = 0;
+  };
+
+  static constexpr uint32_t kBlockSize = 256;
+
+private:
+  // fixed directory of fixed-size chunks: handles stay valid, growth never
+  // copies nodes, and readers never race with a reallocation
+  std::unique_ptr<std::atomic<PathNode*>[]> chunks_;
+  std::atomic<uint64_t> size_{0};
+  std::mutex grow_mutex_;
+  Block serial_;
+
+  void ensure_chunk(uint32_t chunk)
+  {
+    if (chunks_[chunk].load(std::memory_order_acquire)) return;
+
+    std::lock_guard<std::mutex> lock(grow_mutex_);
+    if (!chunks_[chunk].load(std::memory_order_relaxed))
+      chunks_[chunk].store(new PathNode[kChunkSize], std::memory_order_release);
+  }
+
+  void reserve(Block& block)
+  {
+    // kChunkSize is a multiple of kBlockSize, so a block never spans chunks
+    const uint64_t start = size_.fetch_add(kBlockSize, std::memory_order_relaxed);
+    if (start + kBlockSize > kEmptyPath)
+      throw std::length_error("PathStore: out of path handles");
+
+    ensure_chunk(static_cast<uint32_t>(start >> kChunkBits));
+    block.next = static_cast<uint32_t>(start);
+    block.end  = static_cast<uint32_t>(start + kBlockSize);
+  }
+
+public:
+  PathStore() : chunks_(new std::atomic<PathNode*>[kMaxChunks])
+  {
+    for (uint32_t i = 0; i < kMaxChunks; ++i)
+      chunks_[i].store(nullptr, std::memory_order_relaxed);
+  }
+
+  ~PathStore()
+  {
+    clear();
+  }
+
+  PathStore(const PathStore&) = delete;
+  PathStore& operator=(const PathStore&) = delete;
+
+  // Safe to call concurrently as long as each thread owns its Block.
+  uint32_t append(Block& block, uint32_t asn, uint32_t parent)
+  {
+    if (block.next == block.end) reserve(block);
+
+    const uint32_t handle = block.next++;
+    chunks_[handle >> kChunkBits].load(std::memory_order_relaxed)
+      [handle & kChunkMask] = PathNode{asn, parent};
+    return handle;
+  }
+
+  uint32_t append(uint32_t asn, uint32_t parent)
+  {
+    return append(serial_, asn, parent);
+  }
+
+  const PathNode& node(uint32_t handle) const noexcept
+  {
+    return chunks_[handle >> kChunkBits].load(std::memory_order_relaxed)
+      [handle & kChunkMask];
+  }
+
+  template <typename Fn>
+  void for_each(uint32_t path, Fn&& fn) const
+  {
+    for (; path != kEmptyPath; path = node(path).parent)
+      fn(node(path).asn);
+  }
+
+  // full AS path as seen by `holder`: holder first, origin last
+  void expand_into(uint32_t holder, uint32_t path,
+                   std::vector<uint32_t>& out) const
+  {
+    out.clear();
+    out.push_back(holder);
+    for_each(path, [&](uint32_t asn) { out.push_back(asn); });
+  }
+
+  std::vector<uint32_t> expand(uint32_t holder, uint32_t path) const
+  {
+    std::vector<uint32_t> out;
+    expand_into(holder, path, out);
+    return out;
+  }
+
+  // handles reserved so far, including unused tails of writer blocks
+  std::size_t size() const noexcept
+  {
+    return static_cast<std::size_t>(size_.load(std::memory_order_relaxed));
+  }
+
+  // forget every path but keep the chunks for reuse; outstanding Blocks
+  // must be reset by their owners
+  void reset() noexcept
+  {
+    size_.store(0);
+    serial_ = Block{};
+  }
+
+  void clear()
+  {
+    // chunks are allocated front to back, and reset() may have kept more
+    // than size_ covers
+    for (uint32_t i = 0; i < kMaxChunks; ++i)
+    {
+      PathNode* chunk = chunks_[i].exchange(nullptr);
+      if (!chunk) break;
+      delete[] chunk;
+    }
+    size_.store(0);
+    serial_ = Block{};
+  }
+};
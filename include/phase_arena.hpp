@@ -0,0 +1,70 @@
+#pragma once
+#include <memory_resource>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <cstddef>
+
+// Memory for data that only lives until its receiver's rank layer is
+// processed, such as the candidates a policy queues until process_pending.
+// There is one arena per rank layer, chosen by the receiving policy's rank,
+// and within it every thread allocates from its own monotonic buffer, so
+// allocation takes no lock and freeing is a no-op.  Once a layer has been
+// processed nothing allocated from its arena is held any more, and whoever
+// runs the propagation releases every thread's buffer for that layer (see
+// BGPSim::release_layer_memory).
+class PhaseArena final : public std::pmr::memory_resource
+{
+  static constexpr std::size_t kInitialBuffer = std::size_t{1} << 16;
+
+  std::size_t layer_;
+
+  // the calling thread's buffers, one per layer it has allocated for
+  static std::deque<std::pmr::monotonic_buffer_resource>& buffers()
+  {
+    static thread_local std::deque<std::pmr::monotonic_buffer_resource> local;
+    return local;
+  }
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    auto& local = buffers();
+    while (local.size() <= layer_)
+      local.emplace_back(kInitialBuffer);
+    return local[layer_].allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+  {
+    return this == &other;
+  }
+
+  explicit PhaseArena(std::size_t layer) noexcept : layer_(layer) {}
+
+public:
+  static PhaseArena& for_layer(std::size_t layer)
+  {
+    static std::mutex mutex;
+    static std::deque<std::unique_ptr<PhaseArena>> arenas;
+    std::lock_guard<std::mutex> lock(mutex);
+    while (arenas.size() <= layer)
+      arenas.emplace_back(new PhaseArena(arenas.size()));
+    return *arenas[layer];
+  }
+
+  // Returns the calling thread's buffer for `layer` to the heap.
+  static void release_local(std::size_t layer) noexcept
+  {
+    auto& local = buffers();
+    if (layer < local.size()) local[layer].release();
+  }
+
+  // Returns all of the calling thread's buffers to the heap.
+  static void release_local() noexcept
+  {
+    for (auto& buffer : buffers())
+      buffer.release();
+  }
+};
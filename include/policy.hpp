@@ -1,5 +1,4 @@
 #pragma once
-#include <string>
 #include <unordered_map>
 #include <vector>
 #include <cstdint>
@@ -13,6 +12,17 @@ public:
   virtual void enqueue(const Announcement& ann) = 0;
   virtual bool has_pending() const = 0;
   virtual void process_pending() = 0;
-  virtual const std::unordered_map<std::string, Announcement>& local_rib() const = 0;
+
+  // import filter applied to every candidate, queued or pulled
+  virtual bool accepts(const Announcement& ann) const = 0;
+  // install `ann` if it beats the current route; returns true if installed
+  virtual bool adopt(const Announcement& ann) = 0;
+  virtual const std::unordered_map<uint32_t, Announcement>& local_rib() const = 0;
+  // remove the route for one prefix, if any
+  virtual void withdraw(uint32_t prefix_id) = 0;
+  // drop the RIB and its memory once nothing will read it again
+  virtual void release_rib() = 0;
+  // forget all routes and pending candidates, keeping allocated storage
+  virtual void reset() = 0;
 
 };
@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <stdexcept>
+
+// Interns prefix strings into dense uint32_t ids so RIBs and announcements
+// never copy or rehash the string during propagation.  Names live in a deque,
+// whose elements never move, so the index is keyed by views of them and
+// interning a view of an input buffer only copies prefixes not seen before.
+class PrefixTable
+{
+  std::deque<std::string> names_;
+  std::unordered_map<std::string_view, uint32_t> ids_;
+
+public:
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  PrefixTable() = default;
+  PrefixTable(PrefixTable&&) = default;
+  PrefixTable& operator=(PrefixTable&&) = default;
+
+  // a copy re-keys its index on its own names
+  PrefixTable(const PrefixTable& o) : names_(o.names_)
+  {
+    ids_.reserve(names_.size());
+    for (uint32_t id = 0; id < names_.size(); ++id)
+      ids_.emplace(names_[id], id);
+  }
+
+  PrefixTable& operator=(const PrefixTable& o)
+  {
+    if (this != &o) *this = PrefixTable(o);
+    return *this;
+  }
+
+  uint32_t intern(std::string_view prefix)
+  {
+    auto it = ids_.find(prefix);
+    if (it != ids_.end()) return it->second;
+    const uint32_t id = static_cast<uint32_t>(names_.size());
+    names_.emplace_back(prefix);
+    ids_.emplace(names_.back(), id);
+    return id;
+  }
+
+  // room for `n` prefixes in total, so bulk interning never rehashes
+  void reserve(std::size_t n)
+  {
+    ids_.reserve(n);
+  }
+
+  uint32_t find(std::string_view prefix) const
+  {
+    auto it = ids_.find(prefix);
+    return it == ids_.end() ? npos : it->second;
+  }
+
+  const std::string& name(uint32_t id) const
+  {
+    if (id >= names_.size())
+      throw std::runtime_error("PrefixTable: unknown prefix id");
+    return names_[id];
+  }
+
+  std::size_t size() const noexcept
+  {
+    return names_.size();
+  }
+
+  void clear()
+  {
+    names_.clear();
+    ids_.clear();
+  }
+};
@@ -2,8 +2,11 @@
 #include <fstream>
 #include <string>
 #include <stdexcept>
+#include <string_view>
+#include <cstring>
 #include "parser.hpp"
 #include "data_record.hpp"
+#include "mapped_file.hpp"
 
 template <typename Fn>
 void read_caida_data(const std::string& filename, Fn&& handle_record) {
@@ -32,3 +35,38 @@ void read_caida_data(const std::string& filename, Fn&& handle_record) {
     handle_record(rec);
   } while (std::getline(data, line));
 }
+
+// Same contract as read_caida_data, but parses straight out of a memory
+// mapping: records are decoded in batches by parse_records, nothing is
+// copied.  `mapped` must hold the full file contents.
+template <typename Fn>
+void read_caida_buffer(std::string_view mapped, Fn&& handle_record) {
+  constexpr std::size_t kBatch = 1024;
+  const char* p   = mapped.data();
+  const char* end = p + mapped.size();
+
+  // skips past all headers and empty lines
+  while (p < end) {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (nl != p && *p != '#') break;
+    p = nl ? nl + 1 : end;
+  }
+
+  DataRecord batch[kBatch];
+  std::string_view bad;
+  while (p < end) {
+    const std::size_t n = parse_records(p, end, batch, kBatch, &bad);
+    for (std::size_t i = 0; i < n; ++i) {
+      handle_record(batch[i]);
+    }
+    if (bad.data()) {
+      throw std::runtime_error("Malformed line found: " + std::string(bad));
+    }
+  }
+}
+
+template <typename Fn>
+void read_caida_mapped(const std::string& filename, Fn&& handle_record) {
+  MappedFile file(filename);
+  read_caida_buffer(file.view(), handle_record);
+}
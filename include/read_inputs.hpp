@@ -0,0 +1,175 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include "mapped_file.hpp"
+#include "seed.hpp"
+
+// Readers for the announcements and ROV ASN files.  Both parse straight out
+// of a memory mapping with string_views, one memchr per line and no stream
+// or per-field string copies.
+//
+//   announcements: seed_asn,prefix,rov_invalid
+//   ROV ASNs:      asn[,...]
+//
+// Fields are trimmed, empty and '#' lines are skipped, and a first line
+// whose ASN field is not a number is taken as the header.  Announcement
+// lines with fewer than three fields are skipped; rov_invalid accepts
+// true/t/1 and false/f/0 in any case.  A bad ASN or boolean throws.
+
+// One announcement row; prefix points into the parsed buffer.
+struct SeedView
+{
+  std::string_view prefix;
+  uint32_t origin_asn = 0;
+  bool rov_invalid = false;
+};
+
+namespace detail {
+
+inline std::string_view trim_field(std::string_view s) noexcept
+{
+  auto space = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+  while (!s.empty() && space(s.front())) s.remove_prefix(1);
+  while (!s.empty() && space(s.back())) s.remove_suffix(1);
+  return s;
+}
+
+inline bool is_number(std::string_view s) noexcept
+{
+  return !s.empty() &&
+         std::all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+inline uint32_t parse_asn_field(std::string_view field, std::string_view line)
+{
+  uint64_t v = 0;
+  if (is_number(field) && field.size() <= 10)
+    for (char c : field) v = v * 10 + static_cast<uint64_t>(c - '0');
+  if (!is_number(field) || field.size() > 10 || v > UINT32_MAX)
+    throw std::runtime_error("Malformed ASN in line: " + std::string(line));
+  return static_cast<uint32_t>(v);
+}
+
+inline bool parse_bool_field(std::string_view field)
+{
+  char s[6] = {};
+  if (field.size() < sizeof(s))
+    for (std::size_t i = 0; i < field.size(); ++i)
+      s[i] = static_cast<char>(field[i] | 0x20);   // ASCII lower case
+
+  if (!std::strcmp(s, "true") || !std::strcmp(s, "t") || !std::strcmp(s, "1"))
+    return true;
+  if (!std::strcmp(s, "false") || !std::strcmp(s, "f") || !std::strcmp(s, "0"))
+    return false;
+  throw std::runtime_error("Cannot parse boolean value: '" + std::string(field) + "'");
+}
+
+// fn(line) for every non-empty, non-comment line, trimmed
+template <typename Fn>
+void for_each_data_line(std::string_view text, Fn&& fn)
+{
+  const char* p   = text.data();
+  const char* end = p + text.size();
+  while (p < end)
+  {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    const char* eol = nl ? nl : end;
+    const std::string_view line = trim_field(std::string_view(p, eol - p));
+    if (!line.empty() && line.front() != '#') fn(line);
+    p = nl ? nl + 1 : end;
+  }
+}
+
+inline std::size_t count_lines(std::string_view text) noexcept
+{
+  return static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n')) + 1;
+}
+
+} // namespace detail
+
+// Calls fn(const SeedView&) for every announcement in `text`.
+template <typename Fn>
+void parse_announcements(std::string_view text, Fn&& fn)
+{
+  bool first = true;
+  detail::for_each_data_line(text, [&](std::string_view line) {
+    const std::size_t c1 = line.find(',');
+    if (c1 == std::string_view::npos) return;
+    const std::size_t c2 = line.find(',', c1 + 1);
+    if (c2 == std::string_view::npos || c2 + 1 == line.size()) return;
+
+    const std::string_view asn = detail::trim_field(line.substr(0, c1));
+    if (first)
+    {
+      first = false;
+      if (!detail::is_number(asn)) return;   // header
+    }
+
+    SeedView seed;
+    seed.origin_asn  = detail::parse_asn_field(asn, line);
+    seed.prefix      = detail::trim_field(line.substr(c1 + 1, c2 - c1 - 1));
+    seed.rov_invalid = detail::parse_bool_field(detail::trim_field(line.substr(c2 + 1)));
+    fn(seed);
+  });
+}
+
+inline std::vector<uint32_t> parse_rov_asns(std::string_view text)
+{
+  std::vector<uint32_t> asns;
+  asns.reserve(detail::count_lines(text));
+  bool first = true;
+  detail::for_each_data_line(text, [&](std::string_view line) {
+    const std::string_view asn = detail::trim_field(line.substr(0, line.find(',')));
+    if (first)
+    {
+      first = false;
+      if (!detail::is_number(asn)) return;   // header
+    }
+    if (!asn.empty()) asns.push_back(detail::parse_asn_field(asn, line));
+  });
+  return asns;
+}
+
+inline std::vector<Seed> read_announcements(const std::string& filename)
+{
+  MappedFile file(filename);
+  std::vector<Seed> seeds;
+  seeds.reserve(detail::count_lines(file.view()));
+  parse_announcements(file.view(), [&](const SeedView& s) {
+    seeds.push_back(Seed{std::string(s.prefix), s.origin_asn, s.rov_invalid});
+  });
+  return seeds;
+}
+
+// An announcements file kept mapped for as long as this lives, its rows
+// parsed into views of the mapping, so seeding one simulator from seeds()
+// copies no prefix.  Shards, which outlive the file, own theirs as Seed.
+class AnnouncementsFile
+{
+  MappedFile file_;
+  std::vector<SeedView> seeds_;
+
+public:
+  explicit AnnouncementsFile(const std::string& filename)
+    : file_(filename)
+  {
+    seeds_.reserve(detail::count_lines(file_.view()));
+    parse_announcements(file_.view(), [&](const SeedView& s) { seeds_.push_back(s); });
+  }
+
+  const std::vector<SeedView>& seeds() const noexcept
+  {
+    return seeds_;
+  }
+};
+
+inline std::vector<uint32_t> read_rov_asns(const std::string& filename)
+{
+  MappedFile file(filename);
+  return parse_rov_asns(file.view());
+}
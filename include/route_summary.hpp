@@ -0,0 +1,195 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <ostream>
+#include <fstream>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include "bgp_sim.hpp"
+#include "columnar_sim.hpp"
+#include "thread_pool.hpp"
+
+// Route-distribution summaries computed straight from the RIBs, without
+// formatting a row per route: per prefix, how many ASes hold a route, how
+// many of those routes lead to an ROV-invalid origin (the hijacker), how many
+// ROV ASes still picked such a route, and a histogram of path lengths.
+//
+// A RouteSummarizer accumulates over any number of add() calls, so it can
+// follow propagate_down_streaming batch by batch (before the RIBs are
+// released) or collect shard after shard; prefixes are keyed by name and kept
+// in the order first seen.
+struct PrefixSummary
+{
+  std::string prefix;
+  uint64_t ases = 0;          // ASes summarized
+  uint64_t routed = 0;        // of those, ASes holding a route
+  uint64_t invalid = 0;       // routes to an ROV-invalid origin
+  uint64_t rov_ases = 0;      // ROV ASes summarized
+  uint64_t rov_invalid = 0;   // ROV ASes holding an invalid route
+  std::vector<uint64_t> path_lengths;   // [k] = routes whose path has k ASes
+
+  double rov_invalid_fraction() const noexcept
+  {
+    return rov_ases ? static_cast<double>(rov_invalid) / rov_ases : 0.0;
+  }
+};
+
+class RouteSummarizer
+{
+  // route counts by slot, one set per worker so threads never share one
+  struct Counts
+  {
+    uint64_t routed = 0;
+    uint64_t invalid = 0;
+    uint64_t rov_invalid = 0;
+    std::vector<uint64_t> path_lengths;
+
+    void count(uint32_t path_len, bool invalid_route, bool rov)
+    {
+      ++routed;
+      invalid += invalid_route;
+      rov_invalid += invalid_route && rov;
+      if (path_len >= path_lengths.size()) path_lengths.resize(path_len + 1, 0);
+      ++path_lengths[path_len];
+    }
+  };
+
+  std::vector<PrefixSummary> summaries_;
+  std::unordered_map<std::string, uint32_t> slot_of_;
+  std::vector<std::vector<Counts>> counts_;   // [worker][slot]
+  std::vector<uint32_t> slot_;                // current simulator's prefix id -> slot
+
+  // maps every prefix of `sim` to its slot and credits the slots with the
+  // ASes being summarized
+  template <typename Sim>
+  void enter(const Sim& sim, const std::vector<uint32_t>& ids, unsigned workers)
+  {
+    uint64_t rov = 0;
+    for (uint32_t id : ids) rov += sim.deploys_rov(id);
+
+    const PrefixTable& prefixes = sim.prefixes();
+    slot_.resize(prefixes.size());
+    for (uint32_t p = 0; p < prefixes.size(); ++p)
+    {
+      const std::string& name = prefixes.name(p);
+      auto [it, added] = slot_of_.try_emplace(name, static_cast<uint32_t>(summaries_.size()));
+      if (added)
+      {
+        summaries_.emplace_back();
+        summaries_.back().prefix = name;
+      }
+      slot_[p] = it->second;
+      summaries_[it->second].ases += ids.size();
+      summaries_[it->second].rov_ases += rov;
+    }
+
+    if (counts_.size() < workers) counts_.resize(workers);
+    for (auto& c : counts_) c.resize(summaries_.size());
+  }
+
+  void count(const BGPSim& sim, const std::vector<uint32_t>& ids, ThreadPool* pool)
+  {
+    auto run = [&](std::size_t begin, std::size_t end, unsigned worker) {
+      std::vector<Counts>& counts = counts_[worker];
+      for (std::size_t i = begin; i < end; ++i)
+      {
+        const bool rov = sim.deploys_rov(ids[i]);
+        for (const auto& [prefix_id, ann] : sim.policy_at(ids[i]).local_rib())
+          counts[slot_[prefix_id]].count(ann.path_len, ann.rov_invalid, rov);
+      }
+    };
+    if (pool) pool->parallel_for(ids.size(), 256, run);
+    else      run(0, ids.size(), 0);
+  }
+
+  // columns are scanned a prefix at a time, so each slot has one writer
+  void count(const ColumnarSim& sim, const std::vector<uint32_t>& ids, ThreadPool* pool)
+  {
+    std::vector<Counts>& counts = counts_[0];
+    auto run = [&](std::size_t begin, std::size_t end, unsigned) {
+      for (std::size_t p = begin; p < end; ++p)
+      {
+        const ColumnarSim::PrefixRib& rib = sim.rib(static_cast<uint32_t>(p));
+        Counts& c = counts[slot_[p]];
+        for (uint32_t id : ids)
+          if (rib.rel[id] != ColumnarSim::kNoRoute)
+            c.count(rib.path_len[id], rib.invalid[id] != 0, sim.deploys_rov(id));
+      }
+    };
+    if (pool) pool->parallel_for(sim.prefixes().size(), 1, run);
+    else      run(0, sim.prefixes().size(), 0);
+  }
+
+public:
+  // Summarizes the routes held by graph ids `ids`; with a pool the work is
+  // split across its workers.
+  template <typename Sim>
+  void add(const Sim& sim, const std::vector<uint32_t>& ids, ThreadPool* pool = nullptr)
+  {
+    enter(sim, ids, pool ? pool->size() : 1u);
+    count(sim, ids, pool);
+  }
+
+  // every AS of the simulator
+  template <typename Sim>
+  void add(const Sim& sim, ThreadPool* pool = nullptr)
+  {
+    // id 0 is the graph's sentinel
+    std::vector<uint32_t> ids(sim.graph().size() > 0 ? sim.graph().size() - 1 : 0);
+    for (std::size_t i = 0; i < ids.size(); ++i) ids[i] = static_cast<uint32_t>(i + 1);
+    add(sim, ids, pool);
+  }
+
+  // per-prefix totals, in the order prefixes were first seen
+  std::vector<PrefixSummary> summaries() const
+  {
+    std::vector<PrefixSummary> out = summaries_;
+    for (const auto& worker : counts_)
+      for (std::size_t s = 0; s < worker.size(); ++s)
+      {
+        const Counts& c = worker[s];
+        PrefixSummary& sum = out[s];
+        sum.routed += c.routed;
+        sum.invalid += c.invalid;
+        sum.rov_invalid += c.rov_invalid;
+        if (sum.path_lengths.size() < c.path_lengths.size())
+          sum.path_lengths.resize(c.path_lengths.size(), 0);
+        for (std::size_t k = 0; k < c.path_lengths.size(); ++k)
+          sum.path_lengths[k] += c.path_lengths[k];
+      }
+    return out;
+  }
+};
+
+// prefix,ases,routed,invalid,rov_ases,rov_invalid,rov_invalid_fraction,path_lengths
+// with path_lengths as space-separated length:count pairs
+inline void write_route_summary(const std::vector<PrefixSummary>& summaries, std::ostream& out)
+{
+  out << "prefix,ases,routed,invalid,rov_ases,rov_invalid,rov_invalid_fraction,path_lengths\n";
+  for (const PrefixSummary& s : summaries)
+  {
+    out << s.prefix << ',' << s.ases << ',' << s.routed << ',' << s.invalid << ','
+        << s.rov_ases << ',' << s.rov_invalid << ',' << s.rov_invalid_fraction() << ',';
+    bool first = true;
+    for (std::size_t k = 0; k < s.path_lengths.size(); ++k)
+      if (s.path_lengths[k])
+      {
+        out << (first ? "" : " ") << k << ':' << s.path_lengths[k];
+        first = false;
+      }
+    out << '\n';
+  }
+}
+
+inline void write_route_summary(const RouteSummarizer& summary, const std::string& filename)
+{
+  std::ofstream out(filename);
+  if (!out.is_open())
+    throw std::runtime_error("Failed to open output file: " + filename);
+  write_route_summary(summary.summaries(), out);
+  if (!out)
+    throw std::runtime_error("Failed to write route summary: " + filename);
+}
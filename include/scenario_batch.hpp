@@ -0,0 +1,83 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+#include "seed.hpp"
+#include "topology.hpp"
+#include "thread_pool.hpp"
+
+// Batches of what-if runs (hijacks, ROV deployments, ...) against one shared
+// Topology.  The graph, ranks and layers are built once; each worker owns a
+// single simulator that is reset() between scenarios, so a scenario costs
+// only the routes it produces rather than a fresh set of per-AS policies.
+
+// One scenario: the announcements to seed and the ASes that deploy ROV.
+struct Scenario
+{
+  std::vector<Seed> seeds;
+  std::vector<uint32_t> rov_asns;
+};
+
+// Runs scenarios 0 .. count - 1 on up to `threads` workers; load(k) returns
+// scenario k and is called on the worker that runs it, so inputs need not
+// all be in memory at once.  configure(sim) is called once per simulator,
+// before its first scenario.  on_done(k, sim) runs on the worker right after
+// scenario k propagates, concurrently with other scenarios: it must not
+// touch shared state without synchronization.  After an exception no new
+// scenarios are started and the first one is rethrown.
+template <typename Sim, typename Load, typename Configure, typename Done>
+void run_scenarios(const std::shared_ptr<const Topology>& topo,
+                   std::size_t count,
+                   unsigned threads,
+                   Load&& load,
+                   Configure&& configure,
+                   Done&& on_done)
+{
+  std::atomic<std::size_t> next{0};
+  std::atomic<bool> failed{false};
+
+  ThreadPool pool(threads);
+  pool.run([&](unsigned) {
+    std::unique_ptr<Sim> sim;
+    while (!failed.load(std::memory_order_relaxed))
+    {
+      const std::size_t k = next.fetch_add(1);
+      if (k >= count) return;
+
+      try
+      {
+        const Scenario& scenario = load(k);
+        if (!sim)
+        {
+          sim = std::make_unique<Sim>(topo, scenario.rov_asns);
+          configure(*sim);
+        }
+        else
+          sim->reset(scenario.rov_asns);
+
+        seed_all(*sim, scenario.seeds);
+        sim->propagate_all();
+        on_done(k, static_cast<const Sim&>(*sim));
+      }
+      catch (...)
+      {
+        failed = true;
+        throw;
+      }
+    }
+  });
+}
+
+template <typename Sim, typename Configure, typename Done>
+void run_scenarios(const std::shared_ptr<const Topology>& topo,
+                   const std::vector<Scenario>& scenarios,
+                   unsigned threads,
+                   Configure&& configure,
+                   Done&& on_done)
+{
+  run_scenarios<Sim>(topo, scenarios.size(), threads,
+                     [&](std::size_t k) -> const Scenario& { return scenarios[k]; },
+                     configure, on_done);
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// One row of the announcements file: `origin_asn` originates `prefix`.
+struct Seed
+{
+  std::string prefix;
+  uint32_t origin_asn = 0;
+  bool rov_invalid = false;
+};
+
+template <typename Sim, typename Seeds>
+void seed_all(Sim& sim, const Seeds& seeds)
+{
+  sim.seed_prefixes(seeds);
+}
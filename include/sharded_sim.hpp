@@ -0,0 +1,237 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+#include <map>
+#include <thread>
+#include <exception>
+#include <cstdint>
+
+#include "seed.hpp"
+#include "topology.hpp"
+#include "thread_pool.hpp"
+#include "bounded_queue.hpp"
+
+// Prefixes never interact during propagation, so the seeded prefixes can be
+// split into shards that are simulated independently against one shared,
+// read-only Topology.  Only `threads` shards are alive at any time, which
+// bounds peak RIB memory no matter how many prefixes are seeded.
+
+// Groups seeds into shards of at most `prefixes_per_shard` distinct prefixes,
+// keeping every seed of a prefix in the same shard.  Shards follow the order
+// in which prefixes first appear.  `seeds` holds Seed or SeedView rows; the
+// shards own copies of their prefixes either way.
+template <typename Seeds>
+std::vector<std::vector<Seed>> shard_seeds(const Seeds& seeds,
+                                           std::size_t prefixes_per_shard)
+{
+  if (prefixes_per_shard == 0) prefixes_per_shard = 1;
+
+  std::unordered_map<std::string_view, std::size_t> shard_of;
+  std::vector<std::size_t> prefix_count;
+  std::vector<std::vector<Seed>> shards;
+
+  for (const auto& s : seeds)
+  {
+    const std::string_view prefix = s.prefix;
+    auto it = shard_of.find(prefix);
+    if (it == shard_of.end())
+    {
+      if (shards.empty() || prefix_count.back() == prefixes_per_shard)
+      {
+        shards.emplace_back();
+        prefix_count.push_back(0);
+      }
+      ++prefix_count.back();
+      it = shard_of.emplace(prefix, shards.size() - 1).first;
+    }
+    shards[it->second].push_back(Seed{std::string(prefix), s.origin_asn, s.rov_invalid});
+  }
+
+  return shards;
+}
+
+// Runs every shard on up to `threads` workers.  Each worker builds one `Sim`
+// and reset()s it between shards.  Each simulator is passed to
+// configure(sim) once, before its first shard, and to
+// on_shard_done(shard_index, sim) once propagated: strictly in shard order
+// and never concurrently, so callers can append straight to one output.
+template <typename Sim, typename Configure, typename ShardDone>
+void run_sharded(const std::shared_ptr<const Topology>& topo,
+                 const std::vector<uint32_t>& rov_asns,
+                 const std::vector<std::vector<Seed>>& shards,
+                 unsigned threads,
+                 Configure&& configure,
+                 ShardDone&& on_shard_done)
+{
+  std::atomic<std::size_t> next{0};
+  std::mutex mutex;
+  std::condition_variable turn_cv;
+  std::size_t turn = 0;
+  bool failed = false;
+
+  ThreadPool pool(threads);
+  pool.run([&](unsigned) {
+    std::unique_ptr<Sim> owned;
+    for (;;)
+    {
+      const std::size_t k = next.fetch_add(1);
+      if (k >= shards.size()) return;
+
+      try
+      {
+        if (!owned)
+        {
+          owned = std::make_unique<Sim>(topo, rov_asns);
+          configure(*owned);
+        }
+        else
+          owned->reset(rov_asns);
+
+        Sim& sim = *owned;
+        seed_all(sim, shards[k]);
+        sim.propagate_all();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        turn_cv.wait(lock, [&] { return failed || turn == k; });
+        if (failed) return;
+        lock.unlock();
+
+        on_shard_done(k, static_cast<const Sim&>(sim));
+
+        lock.lock();
+        ++turn;
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        turn_cv.notify_all();
+        throw;
+      }
+      turn_cv.notify_all();
+    }
+  });
+}
+
+// Same contract as run_sharded, but on_shard_done runs on a writer thread of
+// its own, so writing shard k overlaps propagating the shards after it.
+// Finished simulators travel to the writer through a bounded queue and come
+// back through another once written; at most `threads + depth` simulators
+// exist, and never more than there are shards, bounding how far propagation
+// runs ahead of a slow writer.
+template <typename Sim, typename Configure, typename ShardDone>
+void run_sharded_pipelined(const std::shared_ptr<const Topology>& topo,
+                           const std::vector<uint32_t>& rov_asns,
+                           const std::vector<std::vector<Seed>>& shards,
+                           unsigned threads,
+                           Configure&& configure,
+                           ShardDone&& on_shard_done,
+                           std::size_t depth = 2)
+{
+  struct Finished
+  {
+    std::size_t shard;
+    std::unique_ptr<Sim> sim;
+  };
+
+  const std::size_t limit = std::max<std::size_t>(1, threads) + depth;
+  const std::size_t max_sims = std::min(limit, shards.size());
+  BoundedQueue<std::unique_ptr<Sim>> free_sims(limit);
+  BoundedQueue<Finished> finished(limit);
+  std::atomic<std::size_t> created{0}, next{0};
+  std::exception_ptr write_error;
+
+  auto stop = [&] {
+    free_sims.close();
+    finished.close();
+  };
+
+  // written strictly in shard order; early shards wait in `held`
+  std::thread writer([&] {
+    try
+    {
+      std::map<std::size_t, std::unique_ptr<Sim>> held;
+      std::size_t turn = 0;
+      while (auto f = finished.pop())
+      {
+        held.emplace(f->shard, std::move(f->sim));
+        for (auto it = held.begin(); it != held.end() && it->first == turn;
+             it = held.erase(it), ++turn)
+        {
+          on_shard_done(turn, static_cast<const Sim&>(*it->second));
+          free_sims.push(std::move(it->second));
+        }
+      }
+    }
+    catch (...)
+    {
+      write_error = std::current_exception();
+      stop();
+    }
+  });
+
+  try
+  {
+    ThreadPool pool(threads);
+    pool.run([&](unsigned) {
+      try
+      {
+        for (;;)
+        {
+          if (next.load() >= shards.size()) return;
+
+          // a simulator is taken before a shard, so every claimed shard can
+          // finish whatever the writer is holding
+          std::unique_ptr<Sim> sim;
+          bool fresh = false;
+          if (created.fetch_add(1) < max_sims)
+          {
+            sim = std::make_unique<Sim>(topo, rov_asns);
+            configure(*sim);
+            fresh = true;
+          }
+          else if (auto reused = free_sims.pop())
+            sim = std::move(*reused);
+          else
+            return;
+
+          const std::size_t k = next.fetch_add(1);
+          if (k >= shards.size())
+          {
+            // hand it on, so a worker still waiting for a simulator wakes
+            // up and sees there is nothing left
+            free_sims.push(std::move(sim));
+            return;
+          }
+
+          if (!fresh) sim->reset(rov_asns);
+          seed_all(*sim, shards[k]);
+          sim->propagate_all();
+          if (!finished.push(Finished{k, std::move(sim)})) return;
+        }
+      }
+      catch (...)
+      {
+        stop();
+        throw;
+      }
+    });
+  }
+  catch (...)
+  {
+    stop();
+    writer.join();
+    throw;
+  }
+
+  finished.close();
+  writer.join();
+  if (write_error) std::rethrow_exception(write_error);
+}
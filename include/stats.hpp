@@ -0,0 +1,160 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+#include <ostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstddef>
+
+// Run statistics: wall times for the stages of a run, and per propagation
+// phase the announcement counters (total and per worker thread), per-layer
+// activity and RIB sizes.  Building with -DBGPSIM_STATS=0 compiles all of it
+// out: the counter macro expands to nothing and BGPSim keeps no state.
+#ifndef BGPSIM_STATS
+#define BGPSIM_STATS 1
+#endif
+
+constexpr bool kStatsCompiled = BGPSIM_STATS != 0;
+
+struct PropagationCounters
+{
+  uint64_t enqueued = 0;    // candidates offered to a policy, pushed or pulled
+  uint64_t dropped = 0;     // candidates rejected by the import filter (ROV)
+  uint64_t installed = 0;   // routes adopted into a RIB
+  uint64_t replaced = 0;    // installs that displaced an existing route
+
+  PropagationCounters& operator+=(const PropagationCounters& o) noexcept
+  {
+    enqueued += o.enqueued;
+    dropped += o.dropped;
+    installed += o.installed;
+    replaced += o.replaced;
+    return *this;
+  }
+
+  PropagationCounters operator-(const PropagationCounters& o) const noexcept
+  {
+    return {enqueued - o.enqueued, dropped - o.dropped,
+            installed - o.installed, replaced - o.replaced};
+  }
+};
+
+// Counters of the calling thread.  Each thread only touches its own, so the
+// hot paths increment them without synchronization; BGPSim takes per-worker
+// differences around each phase.
+inline PropagationCounters& thread_counters() noexcept
+{
+  static thread_local PropagationCounters counters;
+  return counters;
+}
+
+#if BGPSIM_STATS
+#define BGPSIM_COUNT(field) (++thread_counters().field)
+#else
+#define BGPSIM_COUNT(field) ((void)0)
+#endif
+
+struct LayerStats
+{
+  std::size_t rank = 0;
+  std::size_t ases = 0;
+  uint64_t active = 0;      // ASes that received candidates in this layer
+};
+
+struct PhaseStats
+{
+  std::string name;
+  double seconds = 0;
+  PropagationCounters total;
+  std::vector<PropagationCounters> per_thread;
+  std::vector<LayerStats> layers;
+  uint64_t rib_entries = 0;  // routes held by all ASes at the end of the phase
+  uint64_t max_rib = 0;      // largest single RIB at the end of the phase
+};
+
+struct RunStats
+{
+  std::vector<std::pair<std::string, double>> stages;   // name, seconds
+  std::vector<PhaseStats> phases;
+};
+
+class StatsTimer
+{
+  std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+public:
+  double seconds() const
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+  }
+};
+
+namespace detail {
+
+inline void write_counters_json(std::ostream& out, const PropagationCounters& c)
+{
+  out << "{\"enqueued\":" << c.enqueued << ",\"dropped\":" << c.dropped
+      << ",\"installed\":" << c.installed << ",\"replaced\":" << c.replaced << '}';
+}
+
+} // namespace detail
+
+inline void write_stats_text(std::ostream& out, const RunStats& stats)
+{
+  out << std::fixed << std::setprecision(3);
+  out << "stages (s):\n";
+  for (const auto& s : stats.stages)
+    out << "  " << std::left << std::setw(22) << s.first << std::right
+        << std::setw(10) << s.second << '\n';
+
+  for (const auto& p : stats.phases)
+  {
+    out << "phase " << p.name << ": " << p.seconds << " s, enqueued "
+        << p.total.enqueued << ", dropped " << p.total.dropped << ", installed "
+        << p.total.installed << ", replaced " << p.total.replaced
+        << ", rib entries " << p.rib_entries << " (max " << p.max_rib << ")\n";
+    if (p.per_thread.size() > 1)
+      for (std::size_t w = 0; w < p.per_thread.size(); ++w)
+      {
+        const auto& c = p.per_thread[w];
+        out << "  thread " << w << ": enqueued " << c.enqueued << ", dropped "
+            << c.dropped << ", installed " << c.installed << ", replaced "
+            << c.replaced << '\n';
+      }
+    for (const auto& l : p.layers)
+      out << "  layer " << l.rank << ": " << l.ases << " ases, " << l.active
+          << " active\n";
+  }
+  out << std::defaultfloat;
+}
+
+inline void write_stats_json(std::ostream& out, const RunStats& stats)
+{
+  out << "{\"stages\":{";
+  for (std::size_t i = 0; i < stats.stages.size(); ++i)
+    out << (i ? "," : "") << '"' << stats.stages[i].first << "\":"
+        << stats.stages[i].second;
+  out << "},\"phases\":[";
+  for (std::size_t i = 0; i < stats.phases.size(); ++i)
+  {
+    const PhaseStats& p = stats.phases[i];
+    out << (i ? "," : "") << "{\"name\":\"" << p.name << "\",\"seconds\":"
+        << p.seconds << ",\"total\":";
+    detail::write_counters_json(out, p.total);
+    out << ",\"per_thread\":[";
+    for (std::size_t w = 0; w < p.per_thread.size(); ++w)
+    {
+      if (w) out << ',';
+      detail::write_counters_json(out, p.per_thread[w]);
+    }
+    out << "],\"layers\":[";
+    for (std::size_t l = 0; l < p.layers.size(); ++l)
+      out << (l ? "," : "") << "{\"rank\":" << p.layers[l].rank
+          << ",\"ases\":" << p.layers[l].ases
+          << ",\"active\":" << p.layers[l].active << '}';
+    out << "],\"rib_entries\":" << p.rib_entries
+        << ",\"max_rib\":" << p.max_rib << '}';
+  }
+  out << "]}\n";
+}
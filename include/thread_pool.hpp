@@ -0,0 +1,122 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+
+// Fixed set of worker threads that run one job at a time.  The calling
+// thread takes part as worker 0, so a pool of size 1 spawns no threads.
+class ThreadPool
+{
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  std::function<void(unsigned)> job_;
+  uint64_t generation_ = 0;
+  unsigned running_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+
+  void record_error()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) error_ = std::current_exception();
+  }
+
+  void worker_loop(unsigned index)
+  {
+    uint64_t seen = 0;
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_) return;
+        seen = generation_;
+      }
+
+      try { job_(index); }
+      catch (...) { record_error(); }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--running_ == 0) done_cv_.notify_one();
+    }
+  }
+
+public:
+  explicit ThreadPool(unsigned num_threads)
+  {
+    const unsigned n = std::max(1u, num_threads);
+    threads_.reserve(n - 1);
+    for (unsigned i = 1; i < n; ++i)
+      threads_.emplace_back([this, i] { worker_loop(i); });
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& t : threads_) t.join();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned size() const noexcept
+  {
+    return static_cast<unsigned>(threads_.size()) + 1;
+  }
+
+  // Runs job(worker_index) once on every worker and waits for all of them.
+  void run(std::function<void(unsigned)> job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = std::move(job);
+      running_ = static_cast<unsigned>(threads_.size());
+      error_ = nullptr;
+      ++generation_;
+    }
+    start_cv_.notify_all();
+
+    try { job_(0); }
+    catch (...) { record_error(); }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] { return running_ == 0; });
+    if (error_) std::rethrow_exception(error_);
+  }
+
+  // Calls fn(begin, end, worker_index) over [0, n) in chunks of `grain`,
+  // handed out dynamically so uneven work still balances.
+  template <typename Fn>
+  void parallel_for(std::size_t n, std::size_t grain, Fn&& fn)
+  {
+    if (n == 0) return;
+    grain = std::max<std::size_t>(1, grain);
+    if (size() == 1 || n <= grain)
+    {
+      fn(std::size_t{0}, n, 0u);
+      return;
+    }
+
+    std::atomic<std::size_t> next{0};
+    run([&](unsigned worker) {
+      for (;;)
+      {
+        const std::size_t begin = next.fetch_add(grain, std::memory_order_relaxed);
+        if (begin >= n) break;
+        fn(begin, std::min(begin + grain, n), worker);
+      }
+    });
+  }
+};
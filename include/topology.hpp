@@ -0,0 +1,106 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include "as_graph.hpp"
+#include "csr_graph.hpp"
+
+// Everything the engines need from the AS graph, computed once and shared
+// read-only between simulators.
+struct Topology
+{
+  CSRGraph graph;
+  std::vector<int> ranks;
+  std::vector<std::vector<uint32_t>> layers;
+};
+
+// How graph ids are numbered.  INPUT keeps the loader's ids, in order of
+// first appearance.  LAYER renumbers them contiguously by rank layer, with
+// customers of the same provider next to each other, so each layer sweep
+// walks the CSR arrays, the policies and the RIB columns front to back.
+enum class IdOrder : uint8_t
+{
+  INPUT,
+  LAYER
+};
+
+// new_id[id] for LAYER order.  Layers are ordered top down first: an AS's
+// place within its layer follows its earliest-placed provider, so siblings
+// end up adjacent, breadth-first from the roots.  Ids are then handed out
+// from layer 0 upward.
+inline std::vector<uint32_t> layer_order(const CSRGraph& graph,
+                                         const std::vector<std::vector<uint32_t>>& layers)
+{
+  const std::size_t n = graph.size();
+  std::vector<uint32_t> pos(n, UINT32_MAX);
+  std::vector<std::vector<uint32_t>> placed(layers.size());
+  std::vector<uint32_t> key(n, 0);
+  uint32_t next_pos = 0;
+
+  for (std::size_t r = layers.size(); r-- > 0;)
+  {
+    std::vector<uint32_t>& layer = placed[r];
+    layer = layers[r];
+    for (uint32_t id : layer)
+    {
+      uint32_t k = 0;   // roots first
+      for (uint32_t p : graph.providers(id))
+        if (pos[p] != UINT32_MAX) k = k ? std::min(k, pos[p] + 1) : pos[p] + 1;
+      key[id] = k;
+    }
+    std::stable_sort(layer.begin(), layer.end(),
+                     [&](uint32_t a, uint32_t b) { return key[a] < key[b]; });
+    for (uint32_t id : layer) pos[id] = next_pos++;
+  }
+
+  std::vector<uint32_t> new_id(n, UINT32_MAX);
+  uint32_t next = 0;
+  if (n > 0) new_id[0] = next++;
+  for (const auto& layer : placed)
+    for (uint32_t id : layer) new_id[id] = next++;
+  for (uint32_t id = 1; id < n; ++id)   // unranked ids keep their order at the end
+    if (new_id[id] == UINT32_MAX) new_id[id] = next++;
+  return new_id;
+}
+
+// Copy of `topo` renumbered in LAYER order; ranks and layers carry over.
+inline std::shared_ptr<const Topology> relabel_by_layer(const Topology& topo)
+{
+  const std::vector<uint32_t> new_id = layer_order(topo.graph, topo.layers);
+
+  auto out = std::make_shared<Topology>();
+  out->graph = topo.graph.relabeled(new_id);
+  out->ranks.assign(topo.ranks.size(), -1);
+  for (std::size_t id = 0; id < topo.ranks.size(); ++id)
+    out->ranks[new_id[id]] = topo.ranks[id];
+  out->graph.order_neighbors_by_rank(out->ranks);
+  out->layers = layers_from_ranks(out->ranks);
+  return out;
+}
+
+// Ranking runs on `threads` workers; it also rejects provider cycles with a
+// ProviderCycleError naming the ASNs on one of them.
+inline std::shared_ptr<const Topology> make_topology(CSRGraph graph, unsigned threads = 1,
+                                                     IdOrder order = IdOrder::INPUT)
+{
+  auto topo = std::make_shared<Topology>();
+  topo->graph  = std::move(graph);
+  if (threads > 1)
+  {
+    ThreadPool pool(threads);
+    topo->ranks = compute_propagation_ranks(topo->graph, &pool);
+  }
+  else
+    topo->ranks = compute_propagation_ranks(topo->graph);
+  topo->graph.order_neighbors_by_rank(topo->ranks);
+  topo->layers = layers_from_ranks(topo->ranks);
+  if (order == IdOrder::LAYER) return relabel_by_layer(*topo);
+  return topo;
+}
+
+inline std::shared_ptr<const Topology> make_topology(const ASGraph& g, unsigned threads = 1,
+                                                     IdOrder order = IdOrder::INPUT)
+{
+  return make_topology(CSRGraph(g), threads, order);
+}
@@ -0,0 +1,271 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <ostream>
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include "seed.hpp"
+
+// Synthetic Internet-like topologies for scaling tests.  ASes are split into
+// levels: a fully peered tier-1 clique (level 0), `transit_levels` levels of
+// transit ASes that grow geometrically towards the edge, and stubs.  Every
+// provider sits on a strictly higher level than its customers, so the graph
+// is acyclic; every transit AS buys from the level right above it, so the
+// topology has exactly transit_levels + 2 ranks.
+// Providers and peers are picked by preferential attachment, which gives the
+// power-law customer degrees of the real graph.
+//
+// The output depends only on the config: the generator uses its own PRNG and
+// no std distributions, so a seed reproduces the same files everywhere.
+struct GeneratorConfig
+{
+  std::size_t num_ases = 75000;
+  std::size_t tier1 = 16;
+  std::size_t transit_levels = 4;
+  double transit_fraction = 0.15;   // share of ASes that are transit (incl. tier-1)
+  double providers = 1.8;           // mean providers per non-tier-1 AS
+  double peering = 2.0;             // mean peer links added per transit AS
+  std::size_t num_prefixes = 1000;
+  double hijack_fraction = 0.05;    // prefixes also originated, ROV invalid, by a second AS
+  double rov_fraction = 0.1;        // ASes deploying ROV
+  uint64_t seed = 1;
+};
+
+struct SyntheticTopology
+{
+  std::vector<uint32_t> asns;       // AS index -> ASN
+  std::vector<uint32_t> level;      // AS index -> level, 0 = tier-1
+  std::vector<std::pair<uint32_t, uint32_t>> provider_customer;   // ASNs
+  std::vector<std::pair<uint32_t, uint32_t>> peers;               // ASNs
+  std::vector<Seed> seeds;
+  std::vector<uint32_t> rov_asns;
+};
+
+namespace detail {
+
+// splitmix64: tiny, fast and identical on every platform
+class GeneratorRng
+{
+  uint64_t state_;
+
+public:
+  explicit GeneratorRng(uint64_t seed) : state_(seed) {}
+
+  uint64_t next() noexcept
+  {
+    uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  uint32_t below(std::size_t n) noexcept
+  {
+    return static_cast<uint32_t>(next() % n);
+  }
+
+  double uniform() noexcept
+  {
+    return static_cast<double>(next() >> 11) * 0x1.0p-53;
+  }
+
+  // 1 + geometric, with the given mean (>= 1)
+  uint32_t count_with_mean(double mean, uint32_t cap) noexcept
+  {
+    const double more = mean > 1 ? 1 - 1 / mean : 0;
+    uint32_t k = 1;
+    while (k < cap && uniform() < more) ++k;
+    return k;
+  }
+};
+
+inline std::string synthetic_prefix(std::size_t k)
+{
+  return std::to_string(1 + k / 65536) + '.' + std::to_string(k / 256 % 256) +
+         '.' + std::to_string(k % 256) + ".0/24";
+}
+
+} // namespace detail
+
+inline SyntheticTopology generate_topology(const GeneratorConfig& cfg)
+{
+  const std::size_t levels = cfg.transit_levels + 2;
+  if (cfg.tier1 == 0 || cfg.num_ases < cfg.tier1 + cfg.transit_levels + 1)
+    throw std::runtime_error("Generator: need at least one tier-1, one AS per "
+                             "transit level and one stub");
+  if (cfg.num_ases >= UINT32_MAX / 4 || cfg.transit_levels > 30)
+    throw std::runtime_error("Generator: too many ASes or transit levels");
+
+  detail::GeneratorRng rng(cfg.seed);
+
+  // level sizes: tier-1s, transit levels doubling towards the edge, stubs
+  const std::size_t n = cfg.num_ases;
+  const std::size_t wanted = static_cast<std::size_t>(cfg.transit_fraction * n);
+  std::size_t transit = wanted > cfg.tier1 ? wanted - cfg.tier1 : 0;
+  transit = std::min(std::max(transit, cfg.transit_levels), n - cfg.tier1 - 1);
+
+  std::vector<std::size_t> size(levels, 0);
+  size[0] = cfg.tier1;
+  const std::size_t weight = (std::size_t{1} << cfg.transit_levels) - 1;
+  std::size_t placed = cfg.tier1;
+  for (std::size_t l = 1; l < cfg.transit_levels; ++l)
+  {
+    size[l] = std::max<std::size_t>(1, transit * (std::size_t{1} << (l - 1)) / weight);
+    placed += size[l];
+  }
+  if (cfg.transit_levels > 0)
+  {
+    size[cfg.transit_levels] = std::max<std::size_t>(1, cfg.tier1 + transit - placed);
+    placed += size[cfg.transit_levels];
+  }
+  if (placed >= n)
+    throw std::runtime_error("Generator: transit levels leave no room for stubs");
+  size[levels - 1] = n - placed;
+
+  SyntheticTopology topo;
+  std::vector<std::size_t> first(levels + 1, 0);
+  for (std::size_t l = 0; l < levels; ++l)
+  {
+    first[l + 1] = first[l] + size[l];
+    topo.level.insert(topo.level.end(), size[l], static_cast<uint32_t>(l));
+  }
+
+  // sparse, shuffled ASNs: slot i of a permutation owns ASNs 4i+1 .. 4i+4
+  std::vector<uint32_t> slot(n);
+  for (uint32_t i = 0; i < n; ++i) slot[i] = i;
+  for (std::size_t i = n; i-- > 1;) std::swap(slot[i], slot[rng.below(i + 1)]);
+  topo.asns.resize(n);
+  for (std::size_t i = 0; i < n; ++i)
+    topo.asns[i] = 4 * slot[i] + 1 + rng.below(4);
+
+  // attachment pools: an AS appears once, plus once per neighbor it gained
+  std::vector<std::vector<uint32_t>> pool(levels);
+  for (uint32_t i = 0; i < first[levels - 1]; ++i) pool[topo.level[i]].push_back(i);
+
+  auto pick_in = [&](std::size_t lo, std::size_t hi) {
+    std::size_t total = 0;
+    for (std::size_t l = lo; l < hi; ++l) total += pool[l].size();
+    std::size_t k = rng.below(total);
+    for (std::size_t l = lo;; ++l)
+    {
+      if (k < pool[l].size()) return pool[l][k];
+      k -= pool[l].size();
+    }
+  };
+
+  // tier-1 clique
+  for (uint32_t a = 0; a < cfg.tier1; ++a)
+    for (uint32_t b = a + 1; b < cfg.tier1; ++b)
+      topo.peers.emplace_back(topo.asns[a], topo.asns[b]);
+
+  // providers: the first from the level right above (for transits) or any
+  // transit level (for stubs), the rest from any higher level
+  std::vector<uint32_t> chosen;
+  for (uint32_t c = static_cast<uint32_t>(cfg.tier1); c < n; ++c)
+  {
+    const std::size_t l = topo.level[c];
+    const bool stub = l == levels - 1;
+    const uint32_t want = rng.count_with_mean(cfg.providers, 8);
+
+    chosen.clear();
+    if (stub && c == first[l])
+      chosen.push_back(static_cast<uint32_t>(first[l - 1]));   // pins the depth
+    else if (stub)
+      chosen.push_back(pick_in(cfg.transit_levels ? 1 : 0, l));
+    else
+      chosen.push_back(pick_in(l - 1, l));
+
+    for (uint32_t tries = 0; chosen.size() < want && tries < 4 * want; ++tries)
+    {
+      const uint32_t p = pick_in(0, l);
+      if (std::find(chosen.begin(), chosen.end(), p) == chosen.end())
+        chosen.push_back(p);
+    }
+
+    for (uint32_t p : chosen)
+    {
+      topo.provider_customer.emplace_back(topo.asns[p], topo.asns[c]);
+      pool[topo.level[p]].push_back(p);
+    }
+  }
+
+  // peering among transits of the same level
+  std::unordered_set<uint64_t> linked;
+  for (uint32_t a = static_cast<uint32_t>(cfg.tier1); a < first[levels - 1]; ++a)
+  {
+    const std::size_t l = topo.level[a];
+    if (size[l] < 2 || cfg.peering <= 0) continue;
+
+    const uint32_t want = rng.count_with_mean(cfg.peering + 1, 64) - 1;
+    for (uint32_t k = 0; k < want; ++k)
+    {
+      const uint32_t b = pick_in(l, l + 1);
+      if (b == a) continue;
+      const uint64_t key = (uint64_t{std::min(a, b)} << 32) | std::max(a, b);
+      if (!linked.insert(key).second) continue;
+      topo.peers.emplace_back(topo.asns[a], topo.asns[b]);
+      pool[l].push_back(a);
+      pool[l].push_back(b);
+    }
+  }
+
+  // announcements: mostly stub origins, some hijacked by a second origin
+  for (std::size_t k = 0; k < cfg.num_prefixes; ++k)
+  {
+    const std::string prefix = detail::synthetic_prefix(k);
+    const uint32_t origin = rng.uniform() < 0.8 && size[levels - 1] > 0
+      ? static_cast<uint32_t>(first[levels - 1] + rng.below(size[levels - 1]))
+      : rng.below(n);
+    topo.seeds.push_back(Seed{prefix, topo.asns[origin], false});
+
+    if (rng.uniform() < cfg.hijack_fraction)
+    {
+      uint32_t hijacker = rng.below(n);
+      if (hijacker == origin) hijacker = (hijacker + 1) % n;
+      topo.seeds.push_back(Seed{prefix, topo.asns[hijacker], true});
+    }
+  }
+
+  for (uint32_t i = 0; i < n; ++i)
+    if (rng.uniform() < cfg.rov_fraction)
+      topo.rov_asns.push_back(topo.asns[i]);
+
+  return topo;
+}
+
+// serial-2 relationships, provider|customer|-1 and peer|peer|0, sorted by
+// ASN like the CAIDA files
+inline void write_caida(const SyntheticTopology& topo, std::ostream& out)
+{
+  struct Line { uint32_t a, b; int rel; };
+  std::vector<Line> lines;
+  lines.reserve(topo.provider_customer.size() + topo.peers.size());
+  for (const auto& [p, c] : topo.provider_customer) lines.push_back({p, c, -1});
+  for (const auto& [a, b] : topo.peers)
+    lines.push_back({std::min(a, b), std::max(a, b), 0});
+  std::sort(lines.begin(), lines.end(), [](const Line& x, const Line& y) {
+    return x.a != y.a ? x.a < y.a : x.b < y.b;
+  });
+
+  out << "# synthetic serial-2 relationships: " << topo.asns.size() << " ASes, "
+      << lines.size() << " links\n";
+  for (const Line& l : lines)
+    out << l.a << '|' << l.b << '|' << l.rel << "|synthetic\n";
+}
+
+inline void write_announcements(const SyntheticTopology& topo, std::ostream& out)
+{
+  out << "seed_asn,prefix,rov_invalid\n";
+  for (const Seed& s : topo.seeds)
+    out << s.origin_asn << ',' << s.prefix << ',' << (s.rov_invalid ? "True" : "False") << '\n';
+}
+
+inline void write_rov_asns(const SyntheticTopology& topo, std::ostream& out)
+{
+  out << "asn\n";
+  for (uint32_t asn : topo.rov_asns) out << asn << '\n';
+}
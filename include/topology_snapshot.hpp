@@ -0,0 +1,231 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <ostream>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include "topology.hpp"
+#include "mapped_file.hpp"
+
+// Binary snapshot of a Topology, so a run can skip parsing the CAIDA text and
+// recomputing ranks.  Layout (native byte order, checked on load):
+//
+//   header   magic "BGPTOPO", version, byte-order mark, id count, layer
+//            count, total file size
+//   arrays   the CSRGraph arrays, ranks, layer offsets and layer ids, each
+//            a uint64 element count followed by that many uint32 values,
+//            padded to 8 bytes
+//
+// Bump kTopologySnapshotVersion whenever the layout or CSRGraph's arrays
+// change.
+constexpr uint32_t kTopologySnapshotVersion = 1;
+
+namespace detail {
+
+constexpr char     kSnapshotMagic[8] = {'B', 'G', 'P', 'T', 'O', 'P', 'O', '\0'};
+constexpr uint32_t kSnapshotByteOrder = 0x01020304;
+
+struct SnapshotHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t num_ids;
+  uint64_t num_layers;
+  uint64_t file_size;
+};
+
+static_assert(sizeof(int) == sizeof(uint32_t), "ranks are stored as 32-bit");
+
+class SnapshotWriter
+{
+  std::ostream& out_;
+  uint64_t written_ = 0;
+
+public:
+  explicit SnapshotWriter(std::ostream& out) : out_(out) {}
+
+  void raw(const void* p, std::size_t n)
+  {
+    out_.write(static_cast<const char*>(p), static_cast<std::streamsize>(n));
+    written_ += n;
+  }
+
+  template <typename T>
+  void array(const std::vector<T>& v)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "arrays are copied raw");
+    const uint64_t count = v.size();
+    raw(&count, sizeof(count));
+    raw(v.data(), v.size() * sizeof(T));
+    static const char pad[8] = {};
+    if (written_ % 8) raw(pad, 8 - written_ % 8);
+  }
+
+  uint64_t written() const noexcept { return written_; }
+};
+
+class SnapshotReader
+{
+  const char* p_;
+  const char* end_;
+
+  [[noreturn]] static void fail(const std::string& what)
+  {
+    throw std::runtime_error("Topology snapshot: " + what);
+  }
+
+public:
+  explicit SnapshotReader(std::string_view data)
+    : p_(data.data()), end_(data.data() + data.size()) {}
+
+  void raw(void* dst, std::size_t n)
+  {
+    if (static_cast<std::size_t>(end_ - p_) < n) fail("truncated file");
+    std::memcpy(dst, p_, n);
+    p_ += n;
+  }
+
+  template <typename T>
+  void array(std::vector<T>& v)
+  {
+    uint64_t count;
+    raw(&count, sizeof(count));
+    if (count > static_cast<uint64_t>(end_ - p_) / sizeof(T))
+      fail("truncated file");
+    v.resize(static_cast<std::size_t>(count));
+    raw(v.data(), v.size() * sizeof(T));
+
+    const std::size_t misalign = (v.size() * sizeof(T)) % 8;
+    if (misalign)
+    {
+      char pad[8];
+      raw(pad, 8 - misalign);
+    }
+  }
+
+  bool at_end() const noexcept { return p_ == end_; }
+
+  static void check(bool ok, const char* what)
+  {
+    if (!ok) fail(what);
+  }
+};
+
+} // namespace detail
+
+// Writes to any seekable stream (a file, or a std::stringstream to send the
+// snapshot elsewhere); the header is rewritten at the stream's start.
+inline void write_topology_snapshot(const Topology& topo, std::ostream& out)
+{
+  std::vector<uint32_t> layer_off(1, 0), layer_ids;
+  for (const auto& layer : topo.layers)
+  {
+    layer_ids.insert(layer_ids.end(), layer.begin(), layer.end());
+    layer_off.push_back(static_cast<uint32_t>(layer_ids.size()));
+  }
+
+  detail::SnapshotHeader header{};
+  std::memcpy(header.magic, detail::kSnapshotMagic, sizeof(header.magic));
+  header.version    = kTopologySnapshotVersion;
+  header.byte_order = detail::kSnapshotByteOrder;
+  header.num_ids    = topo.graph.size();
+  header.num_layers = topo.layers.size();
+
+  // the file size is only known at the end; the header is rewritten then
+  detail::SnapshotWriter w(out);
+  w.raw(&header, sizeof(header));
+  CSRGraph::for_each_array(topo.graph, [&](const std::vector<uint32_t>& v) {
+    w.array(v);
+  });
+  w.array(topo.ranks);
+  w.array(layer_off);
+  w.array(layer_ids);
+
+  header.file_size = w.written();
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+inline void write_topology_snapshot(const Topology& topo,
+                                    const std::string& filename)
+{
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  if (!out.is_open())
+    throw std::runtime_error("Failed to open snapshot file: " + filename);
+  write_topology_snapshot(topo, out);
+  if (!out)
+    throw std::runtime_error("Failed to write snapshot file: " + filename);
+}
+
+// Copies the arrays of an in-memory snapshot into a fresh Topology; nothing
+// is parsed and neither ranks nor layers are recomputed.  Throws
+// std::runtime_error on a foreign, stale or corrupt snapshot.
+inline std::shared_ptr<const Topology> parse_topology_snapshot(std::string_view data)
+{
+  using detail::SnapshotReader;
+
+  SnapshotReader r(data);
+
+  detail::SnapshotHeader header;
+  r.raw(&header, sizeof(header));
+  SnapshotReader::check(std::memcmp(header.magic, detail::kSnapshotMagic,
+                                    sizeof(header.magic)) == 0,
+                        "not a topology snapshot");
+  SnapshotReader::check(header.byte_order == detail::kSnapshotByteOrder,
+                        "written with a different byte order");
+  if (header.version != kTopologySnapshotVersion)
+    throw std::runtime_error("Topology snapshot: unsupported version " +
+                             std::to_string(header.version));
+  SnapshotReader::check(header.file_size == data.size(),
+                        "size mismatch");
+
+  auto topo = std::make_shared<Topology>();
+  CSRGraph::for_each_array(topo->graph, [&](std::vector<uint32_t>& v) {
+    r.array(v);
+  });
+
+  std::vector<uint32_t> layer_off, layer_ids;
+  r.array(topo->ranks);
+  r.array(layer_off);
+  r.array(layer_ids);
+  SnapshotReader::check(r.at_end(), "trailing data");
+
+  const std::size_t n = topo->graph.size();
+  SnapshotReader::check(n == header.num_ids && topo->graph.well_formed(),
+                        "corrupt graph arrays");
+  SnapshotReader::check(topo->ranks.size() == n &&
+                        layer_off.size() == header.num_layers + 1 &&
+                        layer_off.front() == 0 &&
+                        layer_off.back() == layer_ids.size(),
+                        "corrupt layers");
+
+  topo->layers.resize(static_cast<std::size_t>(header.num_layers));
+  for (std::size_t i = 0; i < topo->layers.size(); ++i)
+  {
+    SnapshotReader::check(layer_off[i] <= layer_off[i + 1], "corrupt layers");
+    for (uint32_t k = layer_off[i]; k < layer_off[i + 1]; ++k)
+    {
+      const uint32_t id = layer_ids[k];
+      SnapshotReader::check(id > 0 && id < n &&
+                            topo->ranks[id] == static_cast<int>(i),
+                            "corrupt layers");
+    }
+    topo->layers[i].assign(layer_ids.begin() + layer_off[i],
+                           layer_ids.begin() + layer_off[i + 1]);
+  }
+  return topo;
+}
+
+// Maps the snapshot file and parses it as above.
+inline std::shared_ptr<const Topology>
+load_topology_snapshot(const std::string& filename)
+{
+  MappedFile file(filename);
+  return parse_topology_snapshot(file.view());
+}
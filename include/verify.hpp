@@ -0,0 +1,184 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <unordered_map>
+#include <algorithm>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+#include "binary_output.hpp"
+
+// Route-by-route comparison of two routing tables, e.g. an optimized run's
+// against the serial reference run's.  Routes are matched by (ASN, prefix
+// name), so ids, engines and row order play no part, and their full AS
+// paths are compared.
+struct RibDiff
+{
+  std::size_t compared = 0;    // routes held in both
+  std::size_t missing = 0;     // held only in the expected table
+  std::size_t extra = 0;       // held only in the actual table
+  std::size_t different = 0;   // held in both, with different paths
+  std::vector<std::string> examples;   // the first mismatches, described
+
+  bool same() const noexcept
+  {
+    return missing == 0 && extra == 0 && different == 0;
+  }
+};
+
+namespace detail {
+
+inline std::string describe_path(const BinaryRibs& ribs, std::size_t row)
+{
+  std::string out = "(";
+  const std::vector<uint32_t> path = ribs.path(row);
+  for (std::size_t i = 0; i < path.size(); ++i)
+    out += (i ? ", " : "") + std::to_string(path[i]);
+  return out + ")";
+}
+
+inline bool same_path(const BinaryRibs& a, std::size_t row_a,
+                      const BinaryRibs& b, std::size_t row_b)
+{
+  uint32_t x = a.path_offset[row_a], y = b.path_offset[row_b];
+  for (; x != kEmptyPath && y != kEmptyPath; x = a.pool_parent[x], y = b.pool_parent[y])
+    if (a.pool_asn[x] != b.pool_asn[y]) return false;
+  return x == y;   // both ran out
+}
+
+} // namespace detail
+
+// Compares a run delivered in pieces, e.g. shard by shard, against one
+// expected table, so only the piece at hand is held besides it.  Pieces
+// must hold disjoint prefixes; expected routes of prefixes no piece held
+// count as missing.
+class RibDiffer
+{
+  const BinaryRibs& expected_;
+  std::size_t max_examples_;
+  RibDiff diff_;
+
+  std::unordered_map<std::string_view, uint32_t> prefix_of_;   // name -> expected id
+  std::vector<std::vector<std::size_t>> rows_of_;   // expected rows per prefix, by ASN
+  std::vector<char> held_;                          // prefix was in some piece
+
+  void note(std::string what)
+  {
+    if (diff_.examples.size() < max_examples_) diff_.examples.push_back(std::move(what));
+  }
+
+  static std::pair<uint32_t, std::string_view> key(const BinaryRibs& r, std::size_t row)
+  {
+    return std::make_pair(r.asn[row], std::string_view(r.prefixes[r.prefix_id[row]]));
+  }
+
+  static std::string where(const BinaryRibs& r, std::size_t row)
+  {
+    return "asn " + std::to_string(r.asn[row]) + " prefix " + r.prefixes[r.prefix_id[row]];
+  }
+
+  // ea and ac are rows of expected_ and actual in canonical order
+  void merge(const std::vector<std::size_t>& ea,
+             const BinaryRibs& actual, const std::vector<std::size_t>& ac)
+  {
+    const BinaryRibs& expected = expected_;
+    std::size_t i = 0, j = 0;
+    while (i < ea.size() || j < ac.size())
+    {
+      if (j == ac.size() || (i < ea.size() && key(expected, ea[i]) < key(actual, ac[j])))
+      {
+        ++diff_.missing;
+        note(where(expected, ea[i]) + ": missing, expected " +
+             detail::describe_path(expected, ea[i]));
+        ++i;
+      }
+      else if (i == ea.size() || key(actual, ac[j]) < key(expected, ea[i]))
+      {
+        ++diff_.extra;
+        note(where(actual, ac[j]) + ": unexpected route " +
+             detail::describe_path(actual, ac[j]));
+        ++j;
+      }
+      else
+      {
+        ++diff_.compared;
+        if (!detail::same_path(expected, ea[i], actual, ac[j]))
+        {
+          ++diff_.different;
+          note(where(expected, ea[i]) + ": expected " +
+               detail::describe_path(expected, ea[i]) + ", got " +
+               detail::describe_path(actual, ac[j]));
+        }
+        ++i;
+        ++j;
+      }
+    }
+  }
+
+  // the expected rows of `prefixes`, in canonical order
+  std::vector<std::size_t> expected_rows(const std::vector<uint32_t>& prefixes) const
+  {
+    std::vector<std::size_t> rows;
+    for (uint32_t p : prefixes)
+      rows.insert(rows.end(), rows_of_[p].begin(), rows_of_[p].end());
+    std::sort(rows.begin(), rows.end(), [&](std::size_t a, std::size_t b) {
+      return key(expected_, a) < key(expected_, b);
+    });
+    return rows;
+  }
+
+public:
+  explicit RibDiffer(const BinaryRibs& expected, std::size_t max_examples = 10)
+    : expected_(expected), max_examples_(max_examples),
+      rows_of_(expected.prefixes.size()), held_(expected.prefixes.size(), 0)
+  {
+    for (uint32_t p = 0; p < expected.prefixes.size(); ++p)
+      prefix_of_.emplace(expected.prefixes[p], p);
+    for (std::size_t row = 0; row < expected.size(); ++row)
+      rows_of_[expected.prefix_id[row]].push_back(row);
+  }
+
+  void add(const BinaryRibs& actual)
+  {
+    std::vector<uint32_t> prefixes;
+    for (const std::string& name : actual.prefixes)
+    {
+      auto it = prefix_of_.find(name);
+      if (it != prefix_of_.end() && !held_[it->second])
+      {
+        held_[it->second] = 1;
+        prefixes.push_back(it->second);
+      }
+    }
+    merge(expected_rows(prefixes), actual, canonical_rows(actual));
+  }
+
+  // the differences of every piece added, plus the routes none of them held
+  RibDiff finish()
+  {
+    std::vector<uint32_t> unheld;
+    for (uint32_t p = 0; p < held_.size(); ++p)
+      if (!held_[p]) unheld.push_back(p);
+    merge(expected_rows(unheld), BinaryRibs{}, {});
+    return std::move(diff_);
+  }
+};
+
+inline RibDiff diff_ribs(const BinaryRibs& expected, const BinaryRibs& actual,
+                         std::size_t max_examples = 10)
+{
+  RibDiffer differ(expected, max_examples);
+  differ.add(actual);
+  return differ.finish();
+}
+
+inline void write_rib_diff(const RibDiff& diff, std::ostream& out)
+{
+  out << "verify: " << diff.compared << " routes compared, " << diff.different
+      << " different, " << diff.missing << " missing, " << diff.extra << " extra: "
+      << (diff.same() ? "OK" : "MISMATCH") << '\n';
+  for (const std::string& e : diff.examples)
+    out << "  " << e << '\n';
+}
@@ -6,13 +6,31 @@
 #include <cstdint>
 #include <sstream>
 #include <cctype>
+#include <cstdlib>
+#include <memory>
+#include <type_traits>
+#include <future>
+#include <chrono>
 
 #include "parser.hpp"
 #include "data_record.hpp"
 #include "read_caida.hpp"
 #include "as_graph.hpp"
+#include "graph_loader.hpp"
+#include "topology.hpp"
+#include "topology_snapshot.hpp"
 #include "bgp_sim.hpp"
+#include "columnar_sim.hpp"
+#include "seed.hpp"
+#include "read_inputs.hpp"
+#include "sharded_sim.hpp"
+#include "stats.hpp"
+#include "scenario_batch.hpp"
 #include "output.hpp"
+#include "binary_output.hpp"
+#include "route_summary.hpp"
+#include "distributed.hpp"
+#include "verify.hpp"
 
 // ----------------- small helpers -----------------
 
@@ -30,142 +48,486 @@ static inline std::string trim(const std::string& s) {
     return s.substr(start, end - start);
 }
 
-static bool parse_bool(const std::string& raw) {
-    std::string s = trim(raw);
-    for (char& c : s)
-        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+// Parses a whole decimal argument into `out`; false if it is empty, has
+// trailing characters, or lies outside [min, max].
+static bool parse_count(const std::string& s, unsigned long min, unsigned long max,
+                        unsigned long& out) {
+    if (s.empty() || !std::isdigit(static_cast<unsigned char>(s[0]))) return false;
+    try {
+        std::size_t used = 0;
+        out = std::stoul(s, &used);
+        return used == s.size() && out >= min && out <= max;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
 
-    if (s == "true" || s == "t" || s == "1")  return true;
-    if (s == "false" || s == "f" || s == "0") return false;
+// ----------------- run configuration -----------------
 
-    throw std::runtime_error("Cannot parse boolean value: '" + raw + "'");
+constexpr unsigned long kMaxThreads = 4096;
+constexpr unsigned long kMaxResultTimeout = 7 * 24 * 3600;   // seconds
+
+struct Options {
+    std::string rel_file;
+    std::string ann_file;
+    std::string rov_file;
+    std::string snapshot_file;          // load the topology from here
+    std::string write_snapshot_file;    // save the topology here
+    std::string out_file = "ribs.csv";  // default output name
+    std::string output_format = "csv";  // csv | binary | summary
+    std::string engine = "policy";
+    unsigned threads = 1;
+    Strategy strategy = Strategy::PUSH;
+    Selection selection = Selection::FUSED;
+    IdOrder id_order = IdOrder::INPUT;  // how graph ids are laid out
+    std::size_t shard_size = 0;         // prefixes per shard, 0 = no sharding
+    bool stream_output = false;         // write RIBs during propagate_down
+    std::string scenario_file;          // batch of scenarios, one per line
+    bool stats = false;                 // print run statistics to stderr
+    std::string stats_json_file;        // write them as JSON here
+    int coordinator_port = -1;          // serve shards to remote workers
+    std::size_t workers = 0;            // ... this many of them
+    std::string worker_of;              // host:port of the coordinator to serve
+    unsigned long result_timeout = 1800;  // seconds per shard, 0 = no limit
+    bool pipeline = false;              // overlap loading, propagating and writing
+    RowOrder row_order = RowOrder::ENGINE;  // CANONICAL with --canonical-output
+    bool verify = false;                // diff against the serial reference run
+};
+
+static bool wants_stats(const Options& opts) {
+    return opts.stats || !opts.stats_json_file.empty();
 }
 
-// Load list of ROV ASNs from CSV (one ASN per line, header allowed)
-static std::vector<uint32_t> load_rov_asns(const std::string& filename) {
-    std::ifstream in(filename);
-    if (!in.is_open()) {
-        throw std::runtime_error("Failed to open ROV ASNs file: " + filename);
+// Runs fn and records its wall time as stage `name`
+template <typename Fn>
+static void timed(RunStats& stats, const char* name, Fn&& fn) {
+    if (!kStatsCompiled) {
+        fn();
+        return;
     }
+    StatsTimer timer;
+    fn();
+    stats.stages.emplace_back(name, timer.seconds());
+}
 
-    std::vector<uint32_t> rov_asns;
-    std::string line;
-    bool first = true;
+// Per-phase statistics come from the policy engine's single-simulator runs
+static void collect_phase_stats(BGPSim& sim, const Options& opts) {
+    sim.set_collect_stats(wants_stats(opts));
+}
 
-    while (std::getline(in, line)) {
-        line = trim(line);
-        if (line.empty()) continue;
-        if (!line.empty() && line[0] == '#') continue;
+static void collect_phase_stats(ColumnarSim&, const Options&) {}
 
-        // Handle possible header on first non-empty line
-        if (first) {
-            first = false;
-            bool all_digits = !line.empty();
-            for (char c : line) {
-                if (!std::isdigit(static_cast<unsigned char>(c))) {
-                    all_digits = false;
-                    break;
-                }
-            }
-            if (!all_digits) {
-                // treat as header, skip
-                continue;
-            }
-        }
+static void report_stats(const RunStats& stats, const Options& opts) {
+    if (opts.stats)
+        write_stats_text(std::cerr, stats);
+    if (!opts.stats_json_file.empty()) {
+        std::ofstream out(opts.stats_json_file);
+        if (!out.is_open())
+            throw std::runtime_error("Failed to open stats file: " + opts.stats_json_file);
+        write_stats_json(out, stats);
+    }
+}
+
+// In sharded and scenario modes the threads run whole simulators, so each
+// simulator stays serial
+static void configure(BGPSim& sim, const Options& opts) {
+    const bool serial = opts.shard_size != 0 || !opts.scenario_file.empty();
+    sim.set_num_threads(serial ? 1 : opts.threads);
+    sim.set_strategy(opts.strategy);
+    sim.set_selection(opts.selection);
+}
+
+static void configure(ColumnarSim&, const Options&) {}
+
+// Writes the propagated RIBs of sim to `filename` in the chosen format; a
+// summary is computed straight from the RIBs, with no per-route rows
+template <typename Sim>
+static void write_output(const Sim& sim, const std::string& filename,
+                         const Options& opts, unsigned threads) {
+    if (opts.output_format == "binary") {
+        write_routing_binary(sim, filename);
+    } else if (opts.output_format == "summary") {
+        std::unique_ptr<ThreadPool> pool;
+        if (threads > 1) pool = std::make_unique<ThreadPool>(threads);
+        RouteSummarizer summary;
+        summary.add(sim, pool.get());
+        write_route_summary(summary, filename);
+    } else {
+        write_routing_csv(sim, filename, threads, opts.row_order);
+    }
+}
+
+// Rows are written (or summarized) as propagate_down finalizes each batch of
+// ASes, and those RIBs are freed right away
+static void propagate_and_stream(BGPSim& sim, const Options& opts) {
+    std::unique_ptr<ThreadPool> pool;
+    if (opts.threads > 1) pool = std::make_unique<ThreadPool>(opts.threads);
+
+    sim.propagate_up();
+    sim.propagate_across_peers();
+    if (opts.output_format == "summary") {
+        RouteSummarizer summary;
+        sim.propagate_down_streaming([&](const std::vector<uint32_t>& ids) {
+            summary.add(sim, ids, pool.get());
+        });
+        write_route_summary(summary, opts.out_file);
+        return;
+    }
+
+    std::ofstream out = open_routing_csv(opts.out_file);
+    sim.propagate_down_streaming([&](const std::vector<uint32_t>& ids) {
+        write_routing_rows(sim, ids, out, pool.get());
+    });
+}
+
+static void propagate_and_stream(ColumnarSim&, const Options&) {
+    throw std::runtime_error("--stream-output requires the policy engine");
+}
+
+// with --pipeline, shards are written on a thread of their own while the
+// later ones propagate
+template <typename Sim, typename ShardDone>
+static void run_shard_list(const std::shared_ptr<const Topology>& topo,
+                           const std::vector<uint32_t>& rov_asns,
+                           const std::vector<std::vector<Seed>>& shards,
+                           const Options& opts,
+                           ShardDone&& on_done)
+{
+    auto setup = [&](Sim& sim) { configure(sim, opts); };
+    if (opts.pipeline)
+        run_sharded_pipelined<Sim>(topo, rov_asns, shards, opts.threads, setup, on_done);
+    else
+        run_sharded<Sim>(topo, rov_asns, shards, opts.threads, setup, on_done);
+}
 
-        // If there are commas, take first field as ASN
-        std::string asn_str;
-        {
-            std::stringstream ss(line);
-            std::getline(ss, asn_str, ',');
+// Seed, propagate and write with either engine
+template <typename Sim>
+static void run_simulation(std::shared_ptr<const Topology> topo,
+                           const std::vector<uint32_t>& rov_asns,
+                           const std::vector<SeedView>& seeds,
+                           const Options& opts,
+                           RunStats& stats)
+{
+    if (opts.shard_size == 0) {
+        std::unique_ptr<Sim> sim;
+        timed(stats, "setup", [&] {
+            sim = std::make_unique<Sim>(std::move(topo), rov_asns);
+            configure(*sim, opts);
+            collect_phase_stats(*sim, opts);
+        });
+
+        timed(stats, "seed", [&] { seed_all(*sim, seeds); });
+        if (opts.stream_output) {
+            timed(stats, "propagate_and_write", [&] { propagate_and_stream(*sim, opts); });
+        } else {
+            timed(stats, "propagate", [&] { sim->propagate_all(); });
+            timed(stats, "write_output", [&] {
+                write_output(*sim, opts.out_file, opts, opts.threads);
+            });
         }
-        asn_str = trim(asn_str);
-        if (asn_str.empty()) continue;
 
-        uint32_t asn = static_cast<uint32_t>(std::stoul(asn_str));
-        rov_asns.push_back(asn);
+        if constexpr (std::is_same<Sim, BGPSim>::value)
+            stats.phases = sim->phase_stats();
+        return;
+    }
+
+    auto shards = shard_seeds(seeds, opts.shard_size);
+    auto run_shards = [&](auto&& on_done) {
+        run_shard_list<Sim>(topo, rov_asns, shards, opts, on_done);
+    };
+
+    // every shard is written as a segment of its own as soon as it is done
+    if (opts.output_format == "binary") {
+        BinaryRibFile file(opts.out_file);
+        timed(stats, "run_shards_and_write", [&] {
+            run_shards([&](std::size_t, const Sim& sim) { file.add(sim); });
+            file.finish();
+        });
+        return;
     }
 
-    return rov_asns;
+    if (opts.output_format == "summary") {
+        RouteSummarizer summary;
+        timed(stats, "run_shards", [&] {
+            run_shards([&](std::size_t, const Sim& sim) { summary.add(sim); });
+        });
+        timed(stats, "write_output", [&] { write_route_summary(summary, opts.out_file); });
+        return;
+    }
+
+    // canonical rows interleave the shards, so each shard's sorted rows are
+    // spilled next to the output and merged at the end
+    if (opts.row_order == RowOrder::CANONICAL) {
+        CanonicalRowSpill spill(opts.out_file + ".spill");
+        timed(stats, "run_shards", [&] {
+            run_shards([&](std::size_t, const Sim& sim) { spill.add(sim); });
+        });
+        timed(stats, "write_output", [&] {
+            std::ofstream out = open_routing_csv(opts.out_file);
+            spill.finish(out);
+        });
+        return;
+    }
+
+    std::ofstream out = open_routing_csv(opts.out_file);
+    timed(stats, "run_shards_and_write", [&] {
+        run_shards([&](std::size_t, const Sim& sim) { write_routing_rows(sim, out); });
+    });
 }
 
-// Load announcements CSV: ASN,prefix,rov_invalid
-static void load_and_seed_announcements(const std::string& filename,
-                                        BGPSim& sim)
+// without --shard-size every worker gets about four shards
+static std::vector<std::vector<Seed>> coordinator_shards(const std::vector<SeedView>& seeds,
+                                                         const Options& opts) {
+    const std::size_t per_shard = opts.shard_size != 0
+        ? opts.shard_size
+        : std::max<std::size_t>(1, seeds.size() / (4 * opts.workers));
+    return shard_seeds(seeds, per_shard);
+}
+
+static Coordinator make_coordinator(const Options& opts) {
+    Coordinator coordinator(static_cast<uint16_t>(opts.coordinator_port));
+    coordinator.set_result_timeout(std::chrono::seconds(opts.result_timeout));
+    return coordinator;
+}
+
+// Shards are simulated by `opts.workers` remote workers; their binary RIBs
+// are written in shard order as they come back
+static void run_coordinator(const Topology& topo,
+                            const std::vector<uint32_t>& rov_asns,
+                            const std::vector<SeedView>& seeds,
+                            const Options& opts,
+                            RunStats& stats)
+{
+    auto shards = coordinator_shards(seeds, opts);
+    Coordinator coordinator = make_coordinator(opts);
+    auto run_workers = [&](auto&& on_result) {
+        coordinator.run(topo, rov_asns, shards, opts.workers, on_result);
+    };
+
+    if (opts.output_format == "binary") {
+        BinaryRibFile file(opts.out_file);
+        timed(stats, "run_workers_and_write", [&] {
+            run_workers([&](std::size_t, const BinaryRibs& ribs) { file.add(ribs); });
+            file.finish();
+        });
+        return;
+    }
+
+    if (opts.row_order == RowOrder::CANONICAL) {
+        CanonicalRowSpill spill(opts.out_file + ".spill");
+        timed(stats, "run_workers", [&] {
+            run_workers([&](std::size_t, const BinaryRibs& ribs) { spill.add(ribs); });
+        });
+        timed(stats, "write_output", [&] {
+            std::ofstream out = open_routing_csv(opts.out_file);
+            spill.finish(out);
+        });
+        return;
+    }
+
+    std::ofstream out = open_routing_csv(opts.out_file);
+    timed(stats, "run_workers_and_write", [&] {
+        run_workers([&](std::size_t, const BinaryRibs& ribs) { write_routing_rows(ribs, out); });
+    });
+}
+
+// Runs the engine as configured (one simulator, shards, pipelined shards or
+// remote workers) and hands every shard to `differ` as soon as it is done
+template <typename Sim>
+static void diff_routes(const std::shared_ptr<const Topology>& topo,
+                        const std::vector<uint32_t>& rov_asns,
+                        const std::vector<SeedView>& seeds,
+                        const Options& opts,
+                        RibDiffer& differ)
+{
+    auto add = [&](const Sim& sim) {
+        BinaryRibWriter writer;
+        writer.add(sim);
+        differ.add(writer.take());
+    };
+
+    if (opts.coordinator_port > 0) {
+        make_coordinator(opts).run(*topo, rov_asns, coordinator_shards(seeds, opts), opts.workers,
+                                   [&](std::size_t, const BinaryRibs& ribs) { differ.add(ribs); });
+    } else if (opts.shard_size != 0) {
+        run_shard_list<Sim>(topo, rov_asns, shard_seeds(seeds, opts.shard_size), opts,
+                            [&](std::size_t, const Sim& sim) { add(sim); });
+    } else {
+        Sim sim(topo, rov_asns);
+        configure(sim, opts);
+        seed_all(sim, seeds);
+        sim.propagate_all();
+        add(sim);
+    }
+}
+
+// Runs the configured engine and the reference (one serial BGPSim with the
+// default strategy and selection, seeded one announcement at a time, on the
+// topology in input id order) and reports every route they disagree on.
+// Returns whether they matched.
+static bool run_verify(const std::shared_ptr<const Topology>& topo,
+                       const std::shared_ptr<const Topology>& reference_topo,
+                       const std::vector<uint32_t>& rov_asns,
+                       const std::vector<SeedView>& seeds,
+                       const Options& opts,
+                       RunStats& stats)
+{
+    BinaryRibs reference;
+    timed(stats, "run_reference", [&] {
+        BGPSim sim(reference_topo, rov_asns);
+        for (const SeedView& s : seeds)
+            sim.seed_prefix(s.prefix, s.origin_asn, s.rov_invalid);
+        sim.propagate_all();
+        BinaryRibWriter writer;
+        writer.add(sim);
+        reference = writer.take();
+    });
+
+    RibDiffer differ(reference);
+    timed(stats, "run_and_diff", [&] {
+        if (opts.engine == "columnar")
+            diff_routes<ColumnarSim>(topo, rov_asns, seeds, opts, differ);
+        else
+            diff_routes<BGPSim>(topo, rov_asns, seeds, opts, differ);
+    });
+
+    const RibDiff diff = differ.finish();
+    write_rib_diff(diff, std::cout);
+    return diff.same();
+}
+
+// Serves shards for the coordinator at host:port until it is done
+static int run_worker_mode(const Options& opts) {
+    const std::size_t colon = opts.worker_of.rfind(':');
+    const int port = colon == std::string::npos
+        ? 0 : std::atoi(opts.worker_of.c_str() + colon + 1);
+    if (port <= 0 || port > 65535) {
+        std::cerr << "--worker needs <host>:<port>\n";
+        return 1;
+    }
+
+    try {
+        const std::size_t served = run_worker(
+            opts.worker_of.substr(0, colon), static_cast<uint16_t>(port),
+            [&](BGPSim& sim) {
+                sim.set_num_threads(opts.threads);
+                sim.set_strategy(opts.strategy);
+                sim.set_selection(opts.selection);
+            });
+        std::cerr << "Worker served " << served << " shards\n";
+        return 0;
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << "\n";
+        return 1;
+    }
+}
+
+// One line of the scenario list: announcements,rov_asns,output
+struct ScenarioFiles {
+    std::string ann_file;
+    std::string rov_file;
+    std::string out_file;
+};
+
+static std::vector<ScenarioFiles> load_scenario_list(const std::string& filename)
 {
     std::ifstream in(filename);
     if (!in.is_open()) {
-        throw std::runtime_error("Failed to open announcements file: " + filename);
+        throw std::runtime_error("Failed to open scenarios file: " + filename);
     }
 
+    std::vector<ScenarioFiles> list;
     std::string line;
     bool first = true;
 
     while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        if (line[0] == '#') continue;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') continue;
 
+        ScenarioFiles files;
         std::stringstream ss(line);
-        std::string asn_str, prefix_str, rov_str;
-
-        if (!std::getline(ss, asn_str, ',')) continue;
-        if (!std::getline(ss, prefix_str, ',')) continue;
-        if (!std::getline(ss, rov_str,  '\n'))  continue;
-
-        if (first) {
+        std::getline(ss, files.ann_file, ',');
+        std::getline(ss, files.rov_file, ',');
+        std::getline(ss, files.out_file, '\n');
+        files.ann_file = trim(files.ann_file);
+        files.rov_file = trim(files.rov_file);
+        files.out_file = trim(files.out_file);
+
+        // optional header naming the columns
+        if (first && files.ann_file == "announcements") {
             first = false;
-            // Heuristic: if ASN column is not numeric, treat this as header and skip
-            bool all_digits = true;
-            std::string tmp = trim(asn_str);
-            if (tmp.empty()) all_digits = false;
-            for (char c : tmp) {
-                if (!std::isdigit(static_cast<unsigned char>(c))) {
-                    all_digits = false;
-                    break;
-                }
-            }
-            if (!all_digits) {
-                // header line
-                continue;
-            }
+            continue;
         }
+        first = false;
 
-        uint32_t asn = static_cast<uint32_t>(std::stoul(trim(asn_str)));
-        std::string prefix = trim(prefix_str);
-        bool rov_invalid = parse_bool(rov_str);
-
-        sim.seed_prefix(prefix, asn, rov_invalid);
+        if (files.ann_file.empty() || files.rov_file.empty() ||
+            files.out_file.empty()) {
+            throw std::runtime_error("Malformed scenario line: " + line);
+        }
+        list.push_back(std::move(files));
     }
-}
 
-// Compute maximum ASN in CAIDA relationships (first pass)
-static uint32_t find_max_asn(const std::string& rel_filename) {
-    uint32_t max_asn = 0;
-
-    read_caida_data(rel_filename, [&](const DataRecord& rec) {
-        if (rec.provider_peer > max_asn) max_asn = rec.provider_peer;
-        if (rec.customer_peer > max_asn) max_asn = rec.customer_peer;
-    });
+    return list;
+}
 
-    return max_asn;
+// Every scenario reuses the topology and a per-thread simulator; inputs are
+// loaded and results written on the worker that runs the scenario
+template <typename Sim>
+static void run_scenario_batch(const std::shared_ptr<const Topology>& topo,
+                               const std::vector<ScenarioFiles>& list,
+                               const Options& opts)
+{
+    run_scenarios<Sim>(topo, list.size(), opts.threads,
+        [&](std::size_t k) {
+            return Scenario{read_announcements(list[k].ann_file),
+                            read_rov_asns(list[k].rov_file)};
+        },
+        [&](Sim& sim) { configure(sim, opts); },
+        [&](std::size_t k, const Sim& sim) {
+            write_output(sim, list[k].out_file, opts, 1);
+        });
 }
 
 static void print_usage(const char* prog) {
     std::cerr
         << "Usage: " << prog
-        << " --relationships <as-rel-file>"
+        << " (--relationships <as-rel-file> | --snapshot <topology.bin>)"
         << " --announcements <announcements.csv>"
         << " --rov-asns <rov_asns.csv>"
-        << " [--output <ribs.csv>]\n";
+        << " [--write-snapshot <topology.bin>]"
+        << " [--output <ribs.csv>]"
+        << " [--output-format csv|binary|summary]"
+        << " [--engine policy|columnar]"
+        << " [--threads <n>]"
+        << " [--strategy push|pull]"
+        << " [--selection fused|buffered]"
+        << " [--id-order input|layer]"
+        << " [--shard-size <prefixes>]"
+        << " [--stream-output]"
+        << " [--pipeline]"
+        << " [--canonical-output]"
+        << " [--verify]"
+        << " [--stats] [--stats-json <stats.json>]\n"
+        << "       " << prog
+        << " (--relationships <as-rel-file> | --snapshot <topology.bin>)"
+        << " --scenarios <scenarios.csv> [--engine ...] [--threads <n>]"
+        << " [--strategy ...] [--output-format ...]\n"
+        << "       (each scenario line: announcements.csv,rov_asns.csv,output)\n"
+        << "       " << prog
+        << " (--relationships <as-rel-file> | --snapshot <topology.bin>)"
+        << " --announcements ... --rov-asns ... --coordinator <port>"
+        << " --workers <n> [--shard-size <prefixes>] [--output ...]"
+        << " [--output-format csv|binary] [--result-timeout <seconds>]\n"
+        << "       " << prog
+        << " --worker <host>:<port> [--threads <n>] [--strategy ...]"
+        << " [--selection ...]\n";
 }
 
 // ----------------- main -----------------
 
 int main(int argc, char** argv) {
-    std::string rel_file;
-    std::string ann_file;
-    std::string rov_file;
-    std::string out_file = "ribs.csv";  // default output name
+    Options opts;
 
     // Simple manual flag parsing
     for (int i = 1; i < argc; ++i) {
@@ -181,16 +543,135 @@ int main(int argc, char** argv) {
 
         if (arg == "--relationships") {
             need_value(arg);
-            rel_file = argv[++i];
+            opts.rel_file = argv[++i];
+        } else if (arg == "--snapshot") {
+            need_value(arg);
+            opts.snapshot_file = argv[++i];
+        } else if (arg == "--write-snapshot") {
+            need_value(arg);
+            opts.write_snapshot_file = argv[++i];
         } else if (arg == "--announcements") {
             need_value(arg);
-            ann_file = argv[++i];
+            opts.ann_file = argv[++i];
         } else if (arg == "--rov-asns") {
             need_value(arg);
-            rov_file = argv[++i];
+            opts.rov_file = argv[++i];
         } else if (arg == "--output") {
             need_value(arg);
-            out_file = argv[++i];
+            opts.out_file = argv[++i];
+        } else if (arg == "--output-format") {
+            need_value(arg);
+            opts.output_format = argv[++i];
+            if (opts.output_format != "csv" && opts.output_format != "binary" &&
+                opts.output_format != "summary") {
+                std::cerr << "Unknown output format: " << opts.output_format << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--engine") {
+            need_value(arg);
+            opts.engine = argv[++i];
+            if (opts.engine != "policy" && opts.engine != "columnar") {
+                std::cerr << "Unknown engine: " << opts.engine << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--threads") {
+            need_value(arg);
+            unsigned long n = 0;
+            if (!parse_count(argv[++i], 1, kMaxThreads, n)) {
+                std::cerr << "--threads must be an integer from 1 to " << kMaxThreads << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+            opts.threads = static_cast<unsigned>(n);
+        } else if (arg == "--shard-size") {
+            need_value(arg);
+            long n = std::atol(argv[++i]);
+            if (n <= 0) {
+                std::cerr << "--shard-size must be a positive integer\n";
+                return 1;
+            }
+            opts.shard_size = static_cast<std::size_t>(n);
+        } else if (arg == "--scenarios") {
+            need_value(arg);
+            opts.scenario_file = argv[++i];
+        } else if (arg == "--canonical-output") {
+            opts.row_order = RowOrder::CANONICAL;
+        } else if (arg == "--verify") {
+            opts.verify = true;
+        } else if (arg == "--pipeline") {
+            opts.pipeline = true;
+        } else if (arg == "--stream-output") {
+            opts.stream_output = true;
+        } else if (arg == "--stats") {
+            opts.stats = true;
+        } else if (arg == "--stats-json") {
+            need_value(arg);
+            opts.stats_json_file = argv[++i];
+        } else if (arg == "--strategy") {
+            need_value(arg);
+            std::string v = argv[++i];
+            if (v == "push") {
+                opts.strategy = Strategy::PUSH;
+            } else if (v == "pull") {
+                opts.strategy = Strategy::PULL;
+            } else {
+                std::cerr << "Unknown strategy: " << v << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--selection") {
+            need_value(arg);
+            std::string v = argv[++i];
+            if (v == "buffered") {
+                opts.selection = Selection::BUFFERED;
+            } else if (v == "fused") {
+                opts.selection = Selection::FUSED;
+            } else {
+                std::cerr << "Unknown selection: " << v << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--coordinator") {
+            need_value(arg);
+            int port = std::atoi(argv[++i]);
+            if (port <= 0 || port > 65535) {
+                std::cerr << "--coordinator must be a TCP port\n";
+                return 1;
+            }
+            opts.coordinator_port = port;
+        } else if (arg == "--workers") {
+            need_value(arg);
+            int n = std::atoi(argv[++i]);
+            if (n <= 0) {
+                std::cerr << "--workers must be a positive integer\n";
+                return 1;
+            }
+            opts.workers = static_cast<std::size_t>(n);
+        } else if (arg == "--result-timeout") {
+            need_value(arg);
+            if (!parse_count(argv[++i], 0, kMaxResultTimeout, opts.result_timeout)) {
+                std::cerr << "--result-timeout must be a number of seconds from 0"
+                          << " (no limit) to " << kMaxResultTimeout << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--worker") {
+            need_value(arg);
+            opts.worker_of = argv[++i];
+        } else if (arg == "--id-order") {
+            need_value(arg);
+            std::string v = argv[++i];
+            if (v == "input") {
+                opts.id_order = IdOrder::INPUT;
+            } else if (v == "layer") {
+                opts.id_order = IdOrder::LAYER;
+            } else {
+                std::cerr << "Unknown id order: " << v << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
         } else {
             std::cerr << "Unknown argument: " << arg << "\n";
             print_usage(argv[0]);
@@ -198,36 +679,160 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (rel_file.empty() || ann_file.empty() || rov_file.empty()) {
+    if (!opts.worker_of.empty())
+        return run_worker_mode(opts);
+
+    // --write-snapshot on its own just converts the relationships file
+    const bool snapshot_only = !opts.write_snapshot_file.empty() &&
+                               opts.ann_file.empty() && opts.rov_file.empty();
+    const bool batch = !opts.scenario_file.empty();
+    if (opts.rel_file.empty() == opts.snapshot_file.empty() ||
+        (!snapshot_only && !batch &&
+         (opts.ann_file.empty() || opts.rov_file.empty()))) {
         print_usage(argv[0]);
         return 1;
     }
+    if (batch && (opts.shard_size != 0 || opts.stream_output ||
+                  !opts.ann_file.empty() || !opts.rov_file.empty())) {
+        std::cerr << "--scenarios replaces --announcements and --rov-asns and"
+                  << " cannot be combined with --shard-size or --stream-output\n";
+        return 1;
+    }
+    if (opts.engine != "policy" &&
+        ((opts.threads > 1 && opts.shard_size == 0 && !batch) ||
+         opts.strategy != Strategy::PUSH ||
+         opts.selection != Selection::FUSED)) {
+        std::cerr << "--strategy, --selection, and --threads without --shard-size or"
+                  << " --scenarios, are only supported by the policy engine\n";
+        return 1;
+    }
+    if (opts.stream_output &&
+        (opts.engine != "policy" || opts.shard_size != 0 ||
+         opts.output_format == "binary")) {
+        std::cerr << "--stream-output needs the policy engine, csv or summary"
+                  << " output and no --shard-size\n";
+        return 1;
+    }
+
+    const bool coordinator = opts.coordinator_port > 0;
+    if (coordinator != (opts.workers > 0) ||
+        (coordinator && (batch || opts.stream_output || opts.engine != "policy" ||
+                         opts.output_format == "summary"))) {
+        std::cerr << "--coordinator and --workers go together, with the policy engine,"
+                  << " csv or binary output and no --scenarios or --stream-output\n";
+        return 1;
+    }
 
+    if (opts.row_order == RowOrder::CANONICAL &&
+        (opts.stream_output || opts.output_format != "csv")) {
+        std::cerr << "--canonical-output needs csv output and no --stream-output\n";
+        return 1;
+    }
+    if (opts.verify && (batch || opts.stream_output)) {
+        std::cerr << "--verify cannot be combined with --scenarios or --stream-output\n";
+        return 1;
+    }
+
+    if (wants_stats(opts) && !kStatsCompiled) {
+        std::cerr << "--stats and --stats-json need a build with BGPSIM_STATS enabled\n";
+        return 1;
+    }
+
+    RunStats stats;
     try {
-        // 1) First pass over CAIDA relationships: find maximum ASN
-        uint32_t max_asn = find_max_asn(rel_file);
-        if (max_asn == 0) {
-            std::cerr << "Error: no ASNs found in relationships file.\n";
-            return 1;
+        // 3) Load ROV ASNs and 4) announcements; with --pipeline this runs on
+        //    its own thread while the graph is loaded and ranked
+        std::vector<uint32_t> rov_asns;
+        // seeds are views into the mapped announcements file, which stays
+        // open for the whole run
+        std::unique_ptr<AnnouncementsFile> anns;
+        auto load_inputs = [&] {
+            StatsTimer timer;
+            rov_asns = read_rov_asns(opts.rov_file);
+            anns = std::make_unique<AnnouncementsFile>(opts.ann_file);
+            return timer.seconds();
+        };
+        std::future<double> inputs;
+        if (opts.pipeline && !batch && !snapshot_only)
+            inputs = std::async(std::launch::async, load_inputs);
+
+        // 1) Load the AS graph straight into CSR form; ASNs are mapped to
+        //    dense ids as they appear.  A snapshot already holds the frozen,
+        //    ranked topology.
+        std::shared_ptr<const Topology> topo;
+        if (!opts.snapshot_file.empty()) {
+            timed(stats, "load_snapshot", [&] {
+                topo = load_topology_snapshot(opts.snapshot_file);
+            });
+        } else {
+            CSRGraph graph;
+            timed(stats, "load_graph", [&] {
+                graph = load_csr_graph(opts.rel_file, opts.threads);
+            });
+            if (graph.size() <= 1) {
+                std::cerr << "Error: no ASNs found in relationships file.\n";
+                return 1;
+            }
+
+            // 2) Rank and flatten the CSR graph
+            timed(stats, "rank", [&] {
+                topo = make_topology(std::move(graph), opts.threads);
+            });
         }
 
-        // 2) Build AS graph
-        ASGraph graph(max_asn);
-        build_graph(rel_file, graph);
+        // snapshots are always in input id order; --id-order layer is
+        // applied after loading one, so a --verify reference built from a
+        // snapshot still checks the relabeling
+        if (!opts.write_snapshot_file.empty()) {
+            timed(stats, "write_snapshot", [&] {
+                write_topology_snapshot(*topo, opts.write_snapshot_file);
+            });
+            if (snapshot_only) {
+                report_stats(stats, opts);
+                return 0;
+            }
+        }
 
-        // 3) Build simulator with ROV ASNs
-        auto rov_asns = load_rov_asns(rov_file);
-        BGPSim sim(graph, rov_asns); // flatten_graph called inside
+        // the reference run of --verify keeps the input id order
+        const std::shared_ptr<const Topology> reference_topo = topo;
+        if (opts.id_order == IdOrder::LAYER)
+            timed(stats, "relabel", [&] { topo = relabel_by_layer(*topo); });
+
+        if (batch) {
+            auto list = load_scenario_list(opts.scenario_file);
+            timed(stats, "run_scenarios", [&] {
+                if (opts.engine == "columnar")
+                    run_scenario_batch<ColumnarSim>(topo, list, opts);
+                else
+                    run_scenario_batch<BGPSim>(topo, list, opts);
+            });
+            report_stats(stats, opts);
+            return 0;
+        }
 
-        // 4) Load announcements and seed them
-        load_and_seed_announcements(ann_file, sim);
+        if (inputs.valid()) {
+            const double seconds = inputs.get();
+            if (kStatsCompiled) stats.stages.emplace_back("load_inputs_overlapped", seconds);
+        } else {
+            timed(stats, "load_inputs", [&] { load_inputs(); });
+        }
+        const std::vector<SeedView>& seeds = anns->seeds();
 
-        // 5) Propagate
-        sim.propagate_all();
+        if (opts.verify) {
+            const bool same = run_verify(topo, reference_topo, rov_asns, seeds, opts, stats);
+            report_stats(stats, opts);
+            return same ? 0 : 1;
+        }
 
-        // 6) Write ribs.csv (or user-specified)
-        write_routing_csv(sim, out_file);
+        // 5) Seed, propagate and write ribs.csv (or user-specified)
+        if (coordinator)
+            run_coordinator(*topo, rov_asns, seeds, opts, stats);
+        else if (opts.engine == "columnar")
+            run_simulation<ColumnarSim>(topo, rov_asns, seeds, opts, stats);
+        else
+            run_simulation<BGPSim>(topo, rov_asns, seeds, opts, stats);
 
+        report_stats(stats, opts);
         return 0;
     }
     catch (const std::runtime_error& ex) {
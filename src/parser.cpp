@@ -1,11 +1,19 @@
 #include <fstream>
 #include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <limits>
 #include "parser.hpp"
 
-inline int fast_atoi(std::string_view sv) noexcept {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BGPSIM_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+int fast_atoi(std::string_view sv) noexcept {
   const char* p = sv.data();
   const char* end = p + sv.size();
-  
+
   if (p != end && *p == '-') {
     return -1;
   }
@@ -18,22 +26,250 @@ inline int fast_atoi(std::string_view sv) noexcept {
   return value;
 }
 
+namespace {
+
+// ----------------- digit conversion -----------------
+
+constexpr uint64_t kZeros = 0x3030303030303030ull;
+
+// The SWAR steps below treat the first byte of a field as the lowest byte of
+// a word; on a big-endian host the loaded word is swapped to match.
+inline uint64_t load_word(const char* s) noexcept {
+  uint64_t v;
+  std::memcpy(&v, s, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64(v);
+#elif !defined(__BYTE_ORDER__) && !defined(_WIN32)
+#error "parser.cpp: cannot tell the byte order of this target"
+#endif
+  return v;
+}
+
+inline bool eight_digits(uint64_t v) noexcept {
+  return ((v & 0xF0F0F0F0F0F0F0F0ull) |
+          (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+         0x3333333333333333ull;
+}
+
+// eight ASCII digits, first digit in the lowest byte
+inline uint32_t convert_eight(uint64_t v) noexcept {
+  const uint64_t mask = 0x000000FF000000FFull;
+  const uint64_t mul1 = 0x000F424000000064ull;   // 100 + (1000000 << 32)
+  const uint64_t mul2 = 0x0000271000000001ull;   // 1 + (10000 << 32)
+  v -= kZeros;
+  v = (v * 10) + (v >> 8);
+  v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+  return static_cast<uint32_t>(v);
+}
+
+inline bool scalar_digits(const char* s, std::size_t len, uint64_t& out) noexcept {
+  uint64_t v = 0;
+  for (std::size_t i = 0; i < len; ++i) {
+    const unsigned d = static_cast<unsigned char>(s[i]) - '0';
+    if (d > 9) return false;
+    v = v * 10 + d;
+  }
+  out = v;
+  return true;
+}
+
+// Validated unsigned field.  When at least 8 bytes are readable from `s`
+// (s + 8 <= limit) the last eight digits are converted in one SWAR step.
+inline bool parse_u32(const char* s, std::size_t len, const char* limit,
+                      uint32_t& out) noexcept {
+  if (len == 0 || len > 10) return false;
+
+  uint64_t value = 0;
+  if (len <= 8 && s + 8 <= limit) {
+    uint64_t chunk = load_word(s);
+    if (len < 8)
+      chunk = (chunk << ((8 - len) * 8)) | (kZeros >> (len * 8));
+    if (!eight_digits(chunk)) return false;
+    value = convert_eight(chunk);
+  } else if (len > 8 && s + len <= limit) {
+    uint64_t high;
+    if (!scalar_digits(s, len - 8, high)) return false;
+    const uint64_t chunk = load_word(s + len - 8);
+    if (!eight_digits(chunk)) return false;
+    value = high * 100000000ull + convert_eight(chunk);
+  } else if (!scalar_digits(s, len, value)) {
+    return false;
+  }
+
+  if (value > std::numeric_limits<uint32_t>::max()) return false;
+  out = static_cast<uint32_t>(value);
+  return true;
+}
+
+inline bool parse_indicator(const char* s, std::size_t len, int& out) noexcept {
+  const bool negative = len > 0 && s[0] == '-';
+  if (negative) { ++s; --len; }
+  if (len == 0 || len > 9) return false;
+
+  uint64_t v;
+  if (!scalar_digits(s, len, v)) return false;
+  out = negative ? -static_cast<int>(v) : static_cast<int>(v);
+  return true;
+}
+
+// fields are [begin, p1) [p1+1, p2) [p2+1, p3); `limit` bounds readahead
+inline bool parse_fields(const char* begin, const char* p1, const char* p2,
+                         const char* p3, const char* limit,
+                         DataRecord& rec) noexcept {
+  return parse_u32(begin, static_cast<std::size_t>(p1 - begin), limit,
+                   rec.provider_peer) &&
+         parse_u32(p1 + 1, static_cast<std::size_t>(p2 - p1 - 1), limit,
+                   rec.customer_peer) &&
+         parse_indicator(p2 + 1, static_cast<std::size_t>(p3 - p2 - 1),
+                         rec.indicator);
+}
+
+// ----------------- delimiter scanning -----------------
+
+constexpr std::size_t kBlock = 64;
+
+struct BlockMasks {
+  uint64_t pipes;
+  uint64_t newlines;
+};
+
+BlockMasks scan_block_scalar(const char* p) noexcept {
+  BlockMasks m{0, 0};
+  for (std::size_t i = 0; i < kBlock; ++i) {
+    m.pipes    |= uint64_t{p[i] == '|'}  << i;
+    m.newlines |= uint64_t{p[i] == '\n'} << i;
+  }
+  return m;
+}
+
+#ifdef BGPSIM_X86_SIMD
+__attribute__((target("sse2")))
+BlockMasks scan_block_sse2(const char* p) noexcept {
+  const __m128i pipe = _mm_set1_epi8('|');
+  const __m128i nl   = _mm_set1_epi8('\n');
+  BlockMasks m{0, 0};
+  for (int i = 0; i < 4; ++i) {
+    const __m128i v =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+    const uint64_t pm = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, pipe)));
+    const uint64_t nm = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+    m.pipes    |= pm << (16 * i);
+    m.newlines |= nm << (16 * i);
+  }
+  return m;
+}
+
+__attribute__((target("avx2")))
+BlockMasks scan_block_avx2(const char* p) noexcept {
+  const __m256i pipe = _mm256_set1_epi8('|');
+  const __m256i nl   = _mm256_set1_epi8('\n');
+  const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+  const auto mask = [](__m256i v, __m256i c) __attribute__((target("avx2"))) {
+    return static_cast<uint64_t>(static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, c))));
+  };
+  return BlockMasks{mask(lo, pipe) | (mask(hi, pipe) << 32),
+                    mask(lo, nl)   | (mask(hi, nl)   << 32)};
+}
+#endif
+
+using ScanFn = BlockMasks (*)(const char*) noexcept;
+
+ScanFn select_scanner() noexcept {
+#ifdef BGPSIM_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return scan_block_avx2;
+  if (__builtin_cpu_supports("sse2")) return scan_block_sse2;
+#endif
+  return scan_block_scalar;
+}
+
+const ScanFn scan_block = select_scanner();
+
+} // end of anonymous namespace
+
 bool parse_line(std::string_view line, DataRecord& rec) {
   size_t pos1 = line.find('|');
-  size_t pos2 = line.find('|', pos1 + 1);
-  size_t pos3 = line.find('|', pos2 + 1);
   if (pos1 == std::string_view::npos) return false;
+  size_t pos2 = line.find('|', pos1 + 1);
   if (pos2 == std::string_view::npos) return false;
+  size_t pos3 = line.find('|', pos2 + 1);
   if (pos3 == std::string_view::npos) return false;
 
-  std::string_view s1 = line.substr(0, pos1);
-  std::string_view s2 = line.substr(pos1 + 1, pos2 - pos1 - 1);
-  std::string_view s3 = line.substr(pos2 + 1, pos3 - pos2 - 1);
-  
-  rec.provider_peer = fast_atoi(s1);
-  rec.customer_peer = fast_atoi(s2);
-  rec.indicator     = fast_atoi(s3);
-
-  return true;
+  const char* b = line.data();
+  return parse_fields(b, b + pos1, b + pos2, b + pos3, b + line.size(), rec);
 }
 
+std::size_t parse_records(const char*& cursor, const char* end,
+                          DataRecord* out, std::size_t capacity,
+                          std::string_view* bad_line) {
+  const char* line_start = cursor;
+  const char* pipe[3] = {nullptr, nullptr, nullptr};
+  int npipes = 0;
+  std::size_t n = 0;
+  if (bad_line) *bad_line = std::string_view();
+
+  // returns false and stops on a malformed line
+  auto finish_line = [&](const char* line_end) {
+    if (npipes < 3 ||
+        !parse_fields(line_start, pipe[0], pipe[1], pipe[2], end, out[n])) {
+      if (bad_line)
+        *bad_line = std::string_view(line_start,
+                                     static_cast<std::size_t>(line_end - line_start));
+      return false;
+    }
+    ++n;
+    npipes = 0;
+    return true;
+  };
+
+  alignas(64) char tail[kBlock];
+  for (const char* block = cursor; block < end && n < capacity; block += kBlock) {
+    const std::size_t avail = static_cast<std::size_t>(end - block);
+    BlockMasks m;
+    if (avail >= kBlock) {
+      m = scan_block(block);
+    } else {
+      std::memset(tail, 0, kBlock);
+      std::memcpy(tail, block, avail);
+      m = scan_block(tail);
+      const uint64_t valid = (uint64_t{1} << avail) - 1;
+      m.pipes &= valid;
+      m.newlines &= valid;
+    }
+
+    uint64_t any = m.pipes | m.newlines;
+    while (any) {
+      const unsigned bit = static_cast<unsigned>(__builtin_ctzll(any));
+      any &= any - 1;
+      const char* pos = block + bit;
+
+      if ((m.newlines >> bit) & 1) {
+        if (!finish_line(pos)) {
+          cursor = line_start;
+          return n;
+        }
+        line_start = pos + 1;
+        if (n == capacity) {
+          cursor = line_start;
+          return n;
+        }
+      } else if (npipes < 3) {
+        pipe[npipes++] = pos;
+      }
+    }
+  }
+
+  // last line without a trailing newline
+  if (line_start < end && n < capacity) {
+    if (!finish_line(end)) {
+      cursor = line_start;
+      return n;
+    }
+    line_start = end;
+  }
+
+  cursor = line_start;
+  return n;
+}
@@ -3,19 +3,38 @@
 #include "../include/read_caida.hpp"
 #include "../include/data_record.hpp"
 #include "../include/as_graph.hpp"
+#include "../include/csr_graph.hpp"
+#include "../include/graph_loader.hpp"
+#include "../include/topology.hpp"
+#include "../include/topology_snapshot.hpp"
 #include "../include/announcement.hpp"
 #include "../include/policy.hpp"
 #include "../include/bgp.hpp"
 #include "../include/bgp_sim.hpp"
+#include "../include/columnar_sim.hpp"
+#include "../include/sharded_sim.hpp"
+#include "../include/scenario_batch.hpp"
 #include "../include/output.hpp"
+#include "../include/binary_output.hpp"
+#include "../include/stats.hpp"
+#include "../include/topology_generator.hpp"
+#include "../include/read_inputs.hpp"
+#include "../include/route_summary.hpp"
+#include "../include/distributed.hpp"
+#include "../include/verify.hpp"
 
 #include <fstream>
+#include <cstdio>
+#include <random>
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <filesystem>
+#include <memory_resource>
 #include <iostream>
 #include <sstream>
+#include <thread>
+#include <atomic>
 
 // -------------------- PARSER TESTS --------------------
 
@@ -50,6 +69,57 @@ TEST(ParserTest, HandlesPeerIndicator) {
     EXPECT_EQ(rec.indicator, 0);
 }
 
+TEST(ParserTest, RejectsBadDigitsAndOverflow) {
+    DataRecord rec;
+    EXPECT_TRUE(parse_line("4294967295|4000000000|-1|x", rec));
+    EXPECT_EQ(rec.provider_peer, 4294967295u);
+    EXPECT_EQ(rec.customer_peer, 4000000000u);
+
+    EXPECT_FALSE(parse_line("4294967296|1|-1|x", rec));   // > UINT32_MAX
+    EXPECT_FALSE(parse_line("12a|1|-1|x", rec));
+    EXPECT_FALSE(parse_line("|1|-1|x", rec));
+    EXPECT_FALSE(parse_line("1| 2|0|x", rec));
+    EXPECT_FALSE(parse_line("1|2|x|x", rec));
+}
+
+TEST(ParserTest, BulkParserMatchesParseLine) {
+    // lines of varying width so delimiters land on every block offset
+    std::string buf;
+    std::vector<DataRecord> expected;
+    for (uint32_t i = 0; i < 3000; ++i) {
+        const uint32_t a = i * 2654435761u;
+        const uint32_t b = i % 7 == 0 ? i : i * 40503u;
+        const int ind = i % 3 == 0 ? 0 : -1;
+        const std::string line = std::to_string(a) + "|" + std::to_string(b) +
+                                 "|" + std::to_string(ind) + "|bgp";
+        buf += line;
+        if (i + 1 < 3000) buf += "\n";
+        expected.push_back(DataRecord{a, b, ind});
+    }
+
+    std::vector<DataRecord> got(expected.size());
+    const char* p = buf.data();
+    std::size_t n = 0;
+    std::string_view bad;
+    while (p < buf.data() + buf.size()) {   // small batches resume mid-block
+        n += parse_records(p, buf.data() + buf.size(), got.data() + n, 7, &bad);
+        ASSERT_EQ(bad.data(), nullptr);
+    }
+
+    ASSERT_EQ(n, expected.size());
+    for (std::size_t i = 0; i < n; ++i) {
+        EXPECT_EQ(got[i].provider_peer, expected[i].provider_peer);
+        EXPECT_EQ(got[i].customer_peer, expected[i].customer_peer);
+        EXPECT_EQ(got[i].indicator, expected[i].indicator);
+    }
+
+    const std::string broken = "1|2|0|x\n3|4|0|x\n5|99999999999|0|x\n6|7|0|x\n";
+    p = broken.data();
+    n = parse_records(p, broken.data() + broken.size(), got.data(), 16, &bad);
+    EXPECT_EQ(n, 2u);
+    EXPECT_EQ(bad, "5|99999999999|0|x");
+}
+
 // -------------------- READ_CAIDA TESTS --------------------
 
 TEST(ReadCaidaTest, ReadsValidRecords) {
@@ -76,6 +146,55 @@ TEST(ReadCaidaTest, ReadsValidRecords) {
     EXPECT_EQ(records[1].indicator, 0);
 }
 
+TEST(ReadCaidaTest, MappedReaderMatchesStreamReader) {
+    {
+        std::ofstream tmp("mapped_data.txt");
+        tmp << "# header line\n";
+        tmp << "\n";
+        tmp << "1|2|-1|meta\n";
+        tmp << "3|4|0|meta\n";
+        tmp << "400000|5|-1|meta";   // no trailing newline
+    }
+
+    std::vector<DataRecord> streamed, mapped;
+    read_caida_data("mapped_data.txt", [&](const DataRecord& rec) {
+        streamed.push_back(rec);
+    });
+    read_caida_mapped("mapped_data.txt", [&](const DataRecord& rec) {
+        mapped.push_back(rec);
+    });
+
+    ASSERT_EQ(mapped.size(), 3u);
+    ASSERT_EQ(streamed.size(), mapped.size());
+    for (std::size_t i = 0; i < mapped.size(); ++i) {
+        EXPECT_EQ(mapped[i].provider_peer, streamed[i].provider_peer);
+        EXPECT_EQ(mapped[i].customer_peer, streamed[i].customer_peer);
+        EXPECT_EQ(mapped[i].indicator, streamed[i].indicator);
+    }
+    std::remove("mapped_data.txt");
+}
+
+TEST(ReadCaidaTest, MappedReaderRejectsMalformedAndHandlesEmpty) {
+    { std::ofstream tmp("mapped_bad.txt"); tmp << "1|2|-1|x\n1|2\n"; }
+    { std::ofstream tmp("mapped_empty.txt"); }
+
+    std::size_t n = 0;
+    EXPECT_THROW(read_caida_mapped("mapped_bad.txt",
+                                   [&](const DataRecord&) { ++n; }),
+                 std::runtime_error);
+    EXPECT_EQ(n, 1u);
+
+    n = 0;
+    read_caida_mapped("mapped_empty.txt", [&](const DataRecord&) { ++n; });
+    EXPECT_EQ(n, 0u);
+
+    EXPECT_THROW(read_caida_mapped("does_not_exist.txt",
+                                   [](const DataRecord&) {}),
+                 std::runtime_error);
+    std::remove("mapped_bad.txt");
+    std::remove("mapped_empty.txt");
+}
+
 // -------------------- AS GRAPH TESTS --------------------
 
 TEST(ASGraphTest, AddEdges) {
@@ -121,6 +240,147 @@ TEST(ASGraphTest, BuildGraphFromFile) {
     EXPECT_EQ(g.get(4).peers[0], 3u);
 }
 
+TEST(ASGraphTest, MapsSparseAsnsToDenseIds) {
+    ASGraph g;
+    g.add_provider_customer(4200000001u, 65000);
+    g.add_peer(65000, 13335);
+
+    // sentinel + three real ASes, regardless of ASN magnitude
+    EXPECT_EQ(g.size(), 4u);
+
+    const uint32_t big = g.id_of(4200000001u);
+    const uint32_t mid = g.id_of(65000);
+    ASSERT_NE(big, kNoId);
+    ASSERT_NE(mid, kNoId);
+    EXPECT_EQ(g.asn_of(big), 4200000001u);
+    EXPECT_EQ(g.get(big).customers[0], mid);
+    EXPECT_EQ(g.asn_of(g.get(mid).peers[0]), 13335u);
+    EXPECT_EQ(g.id_of(1), kNoId);
+}
+
+TEST(CSRGraphTest, FreezesAdjacencyInRankOrder) {
+    // 1 is provider of 2, 3 and 5; 3 is provider of 2 -> rank(3) > rank(2)
+    ASGraph g(5);
+    g.add_provider_customer(1, 3);
+    g.add_provider_customer(1, 2);
+    g.add_provider_customer(3, 2);
+    g.add_provider_customer(1, 5);
+    g.add_peer(4, 5);
+
+    CSRGraph csr(g);
+    std::vector<int> ranks = compute_propagation_ranks(csr);
+    EXPECT_EQ(ranks, compute_propagation_ranks(g));
+
+    csr.order_neighbors_by_rank(ranks);
+
+    ASSERT_EQ(csr.customers(1).size(), 3u);
+    EXPECT_EQ(csr.customers(1)[0], 2u);   // rank 0
+    EXPECT_EQ(csr.customers(1)[1], 5u);   // rank 0, higher id
+    EXPECT_EQ(csr.customers(1)[2], 3u);   // rank 1
+    EXPECT_EQ(csr.providers(2).size(), 2u);
+    EXPECT_EQ(csr.peers(4)[0], 5u);
+    EXPECT_TRUE(csr.peers(1).empty());
+
+    EXPECT_EQ(csr.id_of(4), 4u);
+    EXPECT_EQ(csr.id_of(6), kNoId);
+}
+
+static void expect_same_csr(const CSRGraph& a, const CSRGraph& b) {
+    ASSERT_EQ(a.size(), b.size());
+    for (uint32_t id = 1; id < a.size(); ++id) {
+        ASSERT_EQ(a.asn_of(id), b.asn_of(id));
+        auto x = a.get(id), y = b.get(id);
+        EXPECT_TRUE(std::equal(x.providers.begin(), x.providers.end(),
+                               y.providers.begin(), y.providers.end()));
+        EXPECT_TRUE(std::equal(x.customers.begin(), x.customers.end(),
+                               y.customers.begin(), y.customers.end()));
+        EXPECT_TRUE(std::equal(x.peers.begin(), x.peers.end(),
+                               y.peers.begin(), y.peers.end()));
+    }
+}
+
+TEST(CSRGraphTest, ChunkedLoaderMatchesBuilderAndDropsRepeats) {
+    const std::string text =
+        "# header\n"
+        "7018|3356|-1|bgp\n"
+        "3356|64512|-1|bgp\n"
+        "7018|3356|-1|bgp\n"       // repeated line
+        "3356|174|0|bgp\n"
+        "174|3356|0|bgp\n"         // same peering, other direction
+        "174|64513|-1|mlp\n";
+    CSRGraph csr = build_csr_graph(text, 3);
+
+    ASSERT_EQ(csr.size(), 6u);
+    EXPECT_EQ(csr.asn_of(1), 7018u);   // ids in first-seen order
+    EXPECT_EQ(csr.asn_of(4), 174u);
+    EXPECT_EQ(csr.customers(1).size(), 1u);
+    EXPECT_EQ(csr.providers(2).size(), 1u);
+    EXPECT_EQ(csr.peers(2).size(), 1u);
+    EXPECT_EQ(csr.peers(4).size(), 1u);
+
+    ASGraph g;
+    const std::string file = "chunked_test.txt";
+    std::ofstream(file) << text;
+    build_graph(file, g);
+    expect_same_csr(CSRGraph(g), csr);
+    expect_same_csr(load_csr_graph(file), csr);
+
+    EXPECT_THROW(build_csr_graph("1|2|-1|x\n1|2|x\n"), std::runtime_error);
+    EXPECT_THROW(build_csr_graph("1|2|5|x\n"), std::runtime_error);
+    EXPECT_EQ(build_csr_graph("# only a header\n").size(), 1u);
+    std::remove(file.c_str());
+}
+
+TEST(TopologySnapshotTest, RoundTripsAndRejectsCorruptFiles) {
+    ASGraph g;
+    g.add_provider_customer(7018, 3356);
+    g.add_provider_customer(3356, 64512);
+    g.add_provider_customer(7018, 64513);
+    g.add_peer(3356, 174);
+    auto topo = make_topology(g);
+
+    write_topology_snapshot(*topo, "topo_snapshot.bin");
+    auto loaded = load_topology_snapshot("topo_snapshot.bin");
+
+    ASSERT_EQ(loaded->graph.size(), topo->graph.size());
+    EXPECT_EQ(loaded->ranks, topo->ranks);
+    EXPECT_EQ(loaded->layers, topo->layers);
+    for (uint32_t id = 1; id < topo->graph.size(); ++id) {
+        EXPECT_EQ(loaded->graph.asn_of(id), topo->graph.asn_of(id));
+        EXPECT_EQ(loaded->graph.id_of(topo->graph.asn_of(id)), id);
+        auto a = topo->graph.get(id), b = loaded->graph.get(id);
+        EXPECT_TRUE(std::equal(a.providers.begin(), a.providers.end(),
+                               b.providers.begin(), b.providers.end()));
+        EXPECT_TRUE(std::equal(a.customers.begin(), a.customers.end(),
+                               b.customers.begin(), b.customers.end()));
+        EXPECT_TRUE(std::equal(a.peers.begin(), a.peers.end(),
+                               b.peers.begin(), b.peers.end()));
+    }
+
+    std::string bytes;
+    {
+        std::ifstream in("topo_snapshot.bin", std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    {
+        std::ofstream out("topo_truncated.bin", std::ios::binary);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 4));
+    }
+    {
+        std::string bumped = bytes;
+        bumped[8] = static_cast<char>(bumped[8] + 1);   // version field
+        std::ofstream out("topo_version.bin", std::ios::binary);
+        out << bumped;
+    }
+    { std::ofstream out("topo_junk.bin"); out << "1|2|-1\n"; }
+    EXPECT_THROW(load_topology_snapshot("topo_truncated.bin"), std::runtime_error);
+    EXPECT_THROW(load_topology_snapshot("topo_version.bin"), std::runtime_error);
+    EXPECT_THROW(load_topology_snapshot("topo_junk.bin"), std::runtime_error);
+    for (const char* f : {"topo_snapshot.bin", "topo_truncated.bin", "topo_version.bin",
+                          "topo_junk.bin"})
+        std::remove(f);
+}
+
 // -------------------- PROVIDER CYCLE TESTS --------------------
 
 // Simple API-level test using add_provider_customer
@@ -191,6 +451,41 @@ TEST(CycleTest, DetectsCycleFromSyntheticFile) {
     EXPECT_THROW(assert_provider_acyclic(g), std::runtime_error);
 }
 
+TEST(CycleTest, ReportsAsnsOnTheCycle) {
+    ASGraph g;
+    g.add_provider_customer(7, 100);
+    g.add_provider_customer(100, 200);
+    g.add_provider_customer(200, 300);
+    g.add_provider_customer(300, 100);   // cycle below a provider
+    g.add_provider_customer(300, 9);
+
+    try {
+        assert_provider_acyclic(g);
+        FAIL() << "expected a ProviderCycleError";
+    } catch (const ProviderCycleError& e) {
+        auto asns = e.cycle_asns();
+        std::sort(asns.begin(), asns.end());
+        EXPECT_EQ(asns, (std::vector<uint32_t>{100, 200, 300}));
+        EXPECT_NE(std::string(e.what()).find("200"), std::string::npos);
+    }
+
+    RankResult result = rank_providers(CSRGraph(g));
+    EXPECT_FALSE(result.acyclic());
+    EXPECT_EQ(result.ranks[g.id_of(9)], 0);
+    EXPECT_EQ(result.ranks[g.id_of(7)], -1);
+}
+
+TEST(CycleTest, DeepChainNeedsNoRecursion) {
+    const uint32_t depth = 200000;
+    ASGraph g;
+    for (uint32_t asn = 1; asn < depth; ++asn)
+        g.add_provider_customer(asn + 1, asn);
+
+    EXPECT_FALSE(has_provider_cycle(g));
+    auto ranks = compute_propagation_ranks(g);
+    EXPECT_EQ(ranks[g.id_of(depth)], static_cast<int>(depth - 1));
+}
+
 // ----------- INTEGRATION TEST ON CAIDA DATASET ---------------
 
 TEST(CaidaRealDataTest, CanBuildGraphAndQueryCycles)
@@ -235,24 +530,24 @@ TEST(CaidaRealDataTest, CanBuildGraphAndQueryCycles)
 // -------------------- ANNOUNCEMENT TESTS --------------------
 
 TEST(AnnouncementTest, MakeOriginAnnouncementSetsFieldsCorrectly) {
-    const std::string prefix = "1.2.3.0/24";
+    const uint32_t prefix_id = 7;
     uint32_t asn = 12345;
 
-    Announcement a = make_origin_announcement(prefix, asn);
+    Announcement a = make_origin_announcement(prefix_id, asn);
 
-    EXPECT_EQ(a.prefix, prefix);
-    ASSERT_EQ(a.as_path.size(), 1u);
-    EXPECT_EQ(a.as_path[0], asn);
+    EXPECT_EQ(a.prefix_id, prefix_id);
+    EXPECT_EQ(a.path, kEmptyPath);
+    EXPECT_EQ(a.path_len, 1u);
     EXPECT_EQ(a.next_hop_asn, asn);
     EXPECT_EQ(a.received_from, Relationship::ORIGIN);
 }
 
 TEST(AnnouncementTest, OriginBeatsCustomerPeerProvider) {
-    Announcement origin   = make_origin_announcement("10.0.0.0/8", 1);
+    Announcement origin   = make_origin_announcement(0, 1);
 
-    Announcement from_c   = Announcement{"10.0.0.0/8", {2, 1},  2, Relationship::FROM_CUSTOMER};
-    Announcement from_p   = Announcement{"10.0.0.0/8", {3, 1},  3, Relationship::FROM_PEER};
-    Announcement from_prv = Announcement{"10.0.0.0/8", {4, 1},  4, Relationship::FROM_PROVIDER};
+    Announcement from_c   = Announcement{0, kEmptyPath, 2, 2, Relationship::FROM_CUSTOMER};
+    Announcement from_p   = Announcement{0, kEmptyPath, 2, 3, Relationship::FROM_PEER};
+    Announcement from_prv = Announcement{0, kEmptyPath, 2, 4, Relationship::FROM_PROVIDER};
 
     // Origin should beat all non-origin routes
     EXPECT_TRUE(better_announcement(origin, from_c));
@@ -269,14 +564,16 @@ TEST(AnnouncementTest, OriginBeatsCustomerPeerProvider) {
 
 TEST(AnnouncementTest, ShorterPathBeatsLongerWhenRelationshipSame) {
     Announcement a{
-        "1.2.3.0/24",
-        {10, 20, 30},        // path length 3
+        0,
+        kEmptyPath,
+        3,                   // path length 3
         100,
         Relationship::FROM_CUSTOMER
     };
     Announcement b{
-        "1.2.3.0/24",
-        {10, 20, 30, 40},    // path length 4
+        0,
+        kEmptyPath,
+        4,                   // path length 4
         100,
         Relationship::FROM_CUSTOMER
     };
@@ -287,14 +584,16 @@ TEST(AnnouncementTest, ShorterPathBeatsLongerWhenRelationshipSame) {
 
 TEST(AnnouncementTest, LowerNextHopWinsWhenAllElseEqual) {
     Announcement a{
-        "5.6.7.0/24",
-        {10, 20},            // same path
+        0,
+        kEmptyPath,
+        2,                   // same path length
         50,                  // lower next hop
         Relationship::FROM_PEER
     };
     Announcement b{
-        "5.6.7.0/24",
-        {10, 20},
+        0,
+        kEmptyPath,
+        2,
         60,                  // higher next hop
         Relationship::FROM_PEER
     };
@@ -303,13 +602,29 @@ TEST(AnnouncementTest, LowerNextHopWinsWhenAllElseEqual) {
     EXPECT_FALSE(better_announcement(b, a));
 }
 
+// -------------------- PATH STORE TESTS --------------------
+
+TEST(PathStoreTest, SharedParentsExpandIndependently) {
+    PathStore store;
+
+    // origin 3 forwarded by 2, then fanned out by 1 to two receivers
+    uint32_t p3  = store.append(3, kEmptyPath);
+    uint32_t p23 = store.append(2, p3);
+
+    EXPECT_EQ(store.expand(3, kEmptyPath), std::vector<uint32_t>{3});
+    EXPECT_EQ(store.expand(2, p3),  (std::vector<uint32_t>{2, 3}));
+    EXPECT_EQ(store.expand(10, p23), (std::vector<uint32_t>{10, 2, 3}));
+    EXPECT_EQ(store.expand(11, p23), (std::vector<uint32_t>{11, 2, 3}));
+    EXPECT_EQ(store.node(p23).parent, p3);
+}
+
 
 // -------------------- BGP POLICY TESTS --------------------
 
 TEST(BGPPolicyTest, StoresSingleAnnouncement) {
     BGPPolicy pol(1);
 
-    Announcement a = make_origin_announcement("1.2.3.0/24", 1);
+    Announcement a = make_origin_announcement(0, 1);
     pol.enqueue(a);
     EXPECT_TRUE(pol.has_pending());
 
@@ -317,11 +632,11 @@ TEST(BGPPolicyTest, StoresSingleAnnouncement) {
     EXPECT_FALSE(pol.has_pending());
 
     const auto& rib = pol.local_rib();
-    auto it = rib.find("1.2.3.0/24");
+    auto it = rib.find(0);
     ASSERT_NE(it, rib.end());
-    EXPECT_EQ(it->second.prefix, "1.2.3.0/24");
-    EXPECT_EQ(it->second.as_path.size(), 1u);
-    EXPECT_EQ(it->second.as_path[0], 1u);
+    EXPECT_EQ(it->second.prefix_id, 0u);
+    EXPECT_EQ(it->second.path_len, 1u);
+    EXPECT_EQ(it->second.path, kEmptyPath);
 }
 
 TEST(BGPPolicyTest, KeepsBetterRelationship) {
@@ -329,14 +644,16 @@ TEST(BGPPolicyTest, KeepsBetterRelationship) {
 
     // Two announcements for same prefix, different relationships
     Announcement from_provider{
-        "9.9.9.0/24",
-        {20, 30},          // path
+        0,
+        kEmptyPath,
+        2,                 // path length
         20,                // next hop
         Relationship::FROM_PROVIDER
     };
     Announcement from_customer{
-        "9.9.9.0/24",
-        {40, 30},          // path (same length)
+        0,
+        kEmptyPath,
+        2,                 // same path length
         40,
         Relationship::FROM_CUSTOMER
     };
@@ -346,7 +663,7 @@ TEST(BGPPolicyTest, KeepsBetterRelationship) {
     pol.process_pending();
 
     const auto& rib = pol.local_rib();
-    auto it = rib.find("9.9.9.0/24");
+    auto it = rib.find(0);
     ASSERT_NE(it, rib.end());
 
     // Should choose the customer route
@@ -357,14 +674,16 @@ TEST(BGPPolicyTest, ShorterPathBeatsLongerWhenRelationshipSame) {
     BGPPolicy pol(10);
 
     Announcement long_path{
-        "5.5.5.0/24",
-        {10, 20, 30, 40},          // length 4
+        0,
+        kEmptyPath,
+        4,                         // length 4
         99,
         Relationship::FROM_PEER
     };
     Announcement short_path{
-        "5.5.5.0/24",
-        {10, 20},                  // length 2
+        0,
+        kEmptyPath,
+        2,                         // length 2
         99,
         Relationship::FROM_PEER
     };
@@ -374,24 +693,26 @@ TEST(BGPPolicyTest, ShorterPathBeatsLongerWhenRelationshipSame) {
     pol.process_pending();
 
     const auto& rib = pol.local_rib();
-    auto it = rib.find("5.5.5.0/24");
+    auto it = rib.find(0);
     ASSERT_NE(it, rib.end());
 
-    EXPECT_EQ(it->second.as_path.size(), 2u);
+    EXPECT_EQ(it->second.path_len, 2u);
 }
 
 TEST(BGPPolicyTest, LowerNextHopBreaksTie) {
     BGPPolicy pol(10);
 
     Announcement higher_next_hop{
-        "7.7.7.0/24",
-        {100, 200},
+        0,
+        kEmptyPath,
+        2,
         60,
         Relationship::FROM_PEER
     };
     Announcement lower_next_hop{
-        "7.7.7.0/24",
-        {100, 200},
+        0,
+        kEmptyPath,
+        2,
         50,
         Relationship::FROM_PEER
     };
@@ -401,12 +722,62 @@ TEST(BGPPolicyTest, LowerNextHopBreaksTie) {
     pol.process_pending();
 
     const auto& rib = pol.local_rib();
-    auto it = rib.find("7.7.7.0/24");
+    auto it = rib.find(0);
     ASSERT_NE(it, rib.end());
 
     EXPECT_EQ(it->second.next_hop_asn, 50u);
 }
 
+TEST(BGPPolicyTest, FusedSelectionMatchesBuffered) {
+    BGPPolicy buffered(10);
+    BGPPolicy fused(10, Selection::FUSED);
+    EXPECT_EQ(fused.selection(), Selection::FUSED);
+
+    // equal candidates keep the first one, whichever mode
+    const Announcement candidates[] = {
+        {0, kEmptyPath, 3, 70, Relationship::FROM_PROVIDER},
+        {0, kEmptyPath, 2, 60, Relationship::FROM_PEER},
+        {0, 5,          2, 60, Relationship::FROM_PEER},
+        {1, kEmptyPath, 4, 80, Relationship::FROM_CUSTOMER},
+        {0, kEmptyPath, 2, 50, Relationship::FROM_PEER},
+    };
+    for (BGPPolicy* pol : {&buffered, &fused}) {
+        for (const auto& ann : candidates) pol->enqueue(ann);
+        EXPECT_TRUE(pol->has_pending());
+        pol->process_pending();
+        EXPECT_FALSE(pol->has_pending());
+    }
+
+    ASSERT_EQ(fused.local_rib().size(), 2u);
+    for (const auto& [prefix_id, ann] : buffered.local_rib()) {
+        const Announcement& f = fused.local_rib().at(prefix_id);
+        EXPECT_EQ(f.next_hop_asn, ann.next_hop_asn);
+        EXPECT_EQ(f.path, ann.path);
+        EXPECT_EQ(f.received_from, ann.received_from);
+    }
+    EXPECT_EQ(fused.local_rib().at(0).next_hop_asn, 50u);
+}
+
+TEST(BGPPolicyTest, PendingStorageCanBeReleasedWholesale) {
+    // a fixed buffer with no upstream: any allocation outside it throws
+    alignas(std::max_align_t) static char buffer[1 << 14];
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer),
+                                              std::pmr::null_memory_resource());
+
+    for (Selection mode : {Selection::BUFFERED, Selection::FUSED}) {
+        BGPPolicy pol(10, mode, &arena);
+        for (int round = 0; round < 3; ++round) {
+            for (uint32_t p = 0; p < 8; ++p)
+                pol.enqueue({p, kEmptyPath, 2, 60u - round, Relationship::FROM_PEER});
+            pol.process_pending();
+            // nothing pending refers to the arena any more
+            arena.release();
+        }
+        ASSERT_EQ(pol.local_rib().size(), 8u);
+        EXPECT_EQ(pol.local_rib().at(3).next_hop_asn, 58u);
+    }
+}
+
 
 // -------------------- FLATTEN / RANK TESTS --------------------
 
@@ -495,13 +866,15 @@ TEST(BGPSimTest, SeedStoresOriginAnnouncement) {
     sim.seed_prefix(prefix, origin_asn);
 
     const auto& rib3 = sim.policy(origin_asn).local_rib();
-    auto it = rib3.find(prefix);
+    const uint32_t prefix_id = sim.prefixes().find(prefix);
+    ASSERT_NE(prefix_id, PrefixTable::npos);
+    auto it = rib3.find(prefix_id);
     ASSERT_NE(it, rib3.end());
 
     const Announcement& ann = it->second;
-    EXPECT_EQ(ann.prefix, prefix);
-    ASSERT_EQ(ann.as_path.size(), 1u);
-    EXPECT_EQ(ann.as_path[0], origin_asn);
+    EXPECT_EQ(sim.prefixes().name(ann.prefix_id), prefix);
+    EXPECT_EQ(ann.path_len, 1u);
+    EXPECT_EQ(sim.as_path(origin_asn, ann), std::vector<uint32_t>{origin_asn});
     EXPECT_EQ(ann.next_hop_asn, origin_asn);
     EXPECT_EQ(ann.received_from, Relationship::ORIGIN);
 }
@@ -537,31 +910,34 @@ TEST(BGPSimPropagationTest, PropagateUpSimpleChain) {
 
     // AS 3 (origin)
     {
-        auto it = rib3.find("10.0.0.0/24");
+        auto it = rib3.find(sim.prefixes().find("10.0.0.0/24"));
         ASSERT_NE(it, rib3.end());
-        EXPECT_EQ(it->second.as_path.size(), 1u);
-        EXPECT_EQ(it->second.as_path[0], 3u);
+        const auto path = sim.as_path(3, it->second);
+        EXPECT_EQ(path.size(), 1u);
+        EXPECT_EQ(path[0], 3u);
         EXPECT_EQ(it->second.received_from, Relationship::ORIGIN);
     }
 
     // AS 2 (customer of 1, provider of 3): FROM_CUSTOMER
     {
-        auto it = rib2.find("10.0.0.0/24");
+        auto it = rib2.find(sim.prefixes().find("10.0.0.0/24"));
         ASSERT_NE(it, rib2.end());
-        EXPECT_EQ(it->second.as_path.size(), 2u);
-        EXPECT_EQ(it->second.as_path[0], 2u);
-        EXPECT_EQ(it->second.as_path[1], 3u);
+        const auto path = sim.as_path(2, it->second);
+        EXPECT_EQ(path.size(), 2u);
+        EXPECT_EQ(path[0], 2u);
+        EXPECT_EQ(path[1], 3u);
         EXPECT_EQ(it->second.received_from, Relationship::FROM_CUSTOMER);
     }
 
     // AS 1: FROM_CUSTOMER
     {
-        auto it = rib1.find("10.0.0.0/24");
+        auto it = rib1.find(sim.prefixes().find("10.0.0.0/24"));
         ASSERT_NE(it, rib1.end());
-        EXPECT_EQ(it->second.as_path.size(), 3u);
-        EXPECT_EQ(it->second.as_path[0], 1u);
-        EXPECT_EQ(it->second.as_path[1], 2u);
-        EXPECT_EQ(it->second.as_path[2], 3u);
+        const auto path = sim.as_path(1, it->second);
+        EXPECT_EQ(path.size(), 3u);
+        EXPECT_EQ(path[0], 1u);
+        EXPECT_EQ(path[1], 2u);
+        EXPECT_EQ(path[2], 3u);
         EXPECT_EQ(it->second.received_from, Relationship::FROM_CUSTOMER);
     }
 }
@@ -582,20 +958,22 @@ TEST(BGPSimPropagationTest, PropagateAcrossPeersSingleHop) {
 
     // AS 1: origin
     {
-        auto it = rib1.find("1.2.3.0/24");
+        auto it = rib1.find(sim.prefixes().find("1.2.3.0/24"));
         ASSERT_NE(it, rib1.end());
-        EXPECT_EQ(it->second.as_path.size(), 1u);
-        EXPECT_EQ(it->second.as_path[0], 1u);
+        const auto path = sim.as_path(1, it->second);
+        EXPECT_EQ(path.size(), 1u);
+        EXPECT_EQ(path[0], 1u);
         EXPECT_EQ(it->second.received_from, Relationship::ORIGIN);
     }
 
     // AS 2: FROM_PEER
     {
-        auto it = rib2.find("1.2.3.0/24");
+        auto it = rib2.find(sim.prefixes().find("1.2.3.0/24"));
         ASSERT_NE(it, rib2.end());
-        EXPECT_EQ(it->second.as_path.size(), 2u);
-        EXPECT_EQ(it->second.as_path[0], 2u);
-        EXPECT_EQ(it->second.as_path[1], 1u);
+        const auto path = sim.as_path(2, it->second);
+        EXPECT_EQ(path.size(), 2u);
+        EXPECT_EQ(path[0], 2u);
+        EXPECT_EQ(path[1], 1u);
         EXPECT_EQ(it->second.received_from, Relationship::FROM_PEER);
     }
 }
@@ -667,7 +1045,7 @@ TEST(OutputTest, WritesCsvForSimpleGraph) {
 TEST(ROVPolicyTest, DropsInvalidAnnouncements) {
     ROVPolicy pol(10);
 
-    Announcement valid = make_origin_announcement("1.2.3.0/24", 10);
+    Announcement valid = make_origin_announcement(0, 10);
     Announcement invalid = valid;
     invalid.rov_invalid = true;
 
@@ -676,10 +1054,29 @@ TEST(ROVPolicyTest, DropsInvalidAnnouncements) {
     pol.process_pending();
 
     const auto& rib = pol.local_rib();
-    auto it = rib.find("1.2.3.0/24");
+    auto it = rib.find(0);
     ASSERT_NE(it, rib.end());
 }
 
+TEST(ROVPolicyTest, VisitPolicyBindsConcreteType) {
+    static_assert(std::is_final<BGPPolicy>::value && std::is_final<ROVPolicy>::value,
+                  "built-in policies are final so their calls devirtualize");
+
+    ROVPolicy rov(10);
+    BGPPolicy bgp(11);
+    auto kind_of = [](const auto& pol) { return std::decay_t<decltype(pol)>::kind; };
+    EXPECT_EQ(visit_policy(PolicyKind::ROV, static_cast<const Policy&>(rov), kind_of),
+              PolicyKind::ROV);
+    EXPECT_EQ(visit_policy(PolicyKind::BGP, static_cast<const Policy&>(bgp), kind_of),
+              PolicyKind::BGP);
+
+    Announcement invalid = make_origin_announcement(0, 20);
+    invalid.rov_invalid = true;
+    visit_policy(PolicyKind::ROV, static_cast<Policy&>(rov), [&](auto& pol) {
+        EXPECT_FALSE(pol.accepts(invalid));
+    });
+}
+
 
 TEST(BGPSimROVTest, ROVNodeDoesNotStoreInvalidRoute) {
     // Simple 1 <-> 2 peering; 2 is ROV-enabled.
@@ -690,7 +1087,7 @@ TEST(BGPSimROVTest, ROVNodeDoesNotStoreInvalidRoute) {
     BGPSim sim(g, rov_asns);
 
     // Inject an invalid route at AS 1 (pretend it hijacked some prefix)
-    Announcement hijack = make_origin_announcement("10.10.0.0/16", 1);
+    Announcement hijack = make_origin_announcement(0, 1);
     hijack.rov_invalid = true;
 
     sim.policy(1).enqueue(hijack);
@@ -704,14 +1101,1432 @@ TEST(BGPSimROVTest, ROVNodeDoesNotStoreInvalidRoute) {
 
     // AS 1 (non-ROV) keeps its own invalid route
     {
-        auto it = rib1.find("10.10.0.0/16");
+        auto it = rib1.find(0);
         ASSERT_NE(it, rib1.end());
         EXPECT_TRUE(it->second.rov_invalid);
     }
 
     // AS 2 (ROV) should have dropped it
     {
-        auto it = rib2.find("10.10.0.0/16");
+        auto it = rib2.find(0);
         EXPECT_EQ(it, rib2.end());
     }
 }
+
+
+// -------------------- COLUMNAR ENGINE TESTS --------------------
+
+// Small mixed topology used to cross-check engines: 1 and 2 peer,
+// 1 -> 3, 2 -> 4, 3 -> 5, 4 -> 5 and 4 -> 6 are provider -> customer.
+static ASGraph make_mixed_graph() {
+    ASGraph g(6);
+    g.add_peer(1, 2);
+    g.add_provider_customer(1, 3);
+    g.add_provider_customer(2, 4);
+    g.add_provider_customer(3, 5);
+    g.add_provider_customer(4, 5);
+    g.add_provider_customer(4, 6);
+    return g;
+}
+
+TEST(ColumnarSimTest, MatchesPolicyEngine) {
+    ASGraph g = make_mixed_graph();
+    std::vector<uint32_t> rov_asns = {4};
+
+    BGPSim ref(g, rov_asns);
+    ColumnarSim col(g, rov_asns);
+
+    ref.seed_prefix("10.0.0.0/24", 6);
+    ref.seed_prefix("10.0.0.0/24", 3, true);
+    ref.seed_prefix("20.0.0.0/24", 5);
+    col.seed_prefix("10.0.0.0/24", 6);
+    col.seed_prefix("10.0.0.0/24", 3, true);
+    col.seed_prefix("20.0.0.0/24", 5);
+
+    ref.propagate_all();
+    col.propagate_all();
+
+    ASSERT_EQ(ref.prefixes().size(), col.prefixes().size());
+    for (uint32_t asn = 1; asn <= 6; ++asn) {
+        const auto& rib = ref.policy(asn).local_rib();
+        for (uint32_t id = 0; id < col.prefixes().size(); ++id) {
+            auto it = rib.find(id);
+            ASSERT_EQ(it != rib.end(), col.has_route(id, asn))
+                << "asn " << asn << " prefix " << id;
+            if (it == rib.end()) continue;
+
+            Announcement c = col.route(id, asn);
+            EXPECT_EQ(c.received_from, it->second.received_from);
+            EXPECT_EQ(c.next_hop_asn, it->second.next_hop_asn);
+            EXPECT_EQ(c.rov_invalid, it->second.rov_invalid);
+            EXPECT_EQ(col.as_path(asn, c), ref.as_path(asn, it->second));
+        }
+    }
+}
+
+TEST(ColumnarSimTest, ROVBitmaskDropsInvalidRoute) {
+    ASGraph g(2);
+    g.add_peer(1, 2);
+
+    ColumnarSim sim(g, {2});
+    sim.seed_prefix("10.10.0.0/16", 1, true);
+    sim.propagate_across_peers();
+
+    const uint32_t id = sim.prefixes().find("10.10.0.0/16");
+    EXPECT_TRUE(sim.has_route(id, 1));
+    EXPECT_TRUE(sim.route(id, 1).rov_invalid);
+    EXPECT_FALSE(sim.has_route(id, 2));
+}
+
+TEST(BGPSimTest, PropagatesOverSparseAsns) {
+    ASGraph g;
+    g.add_provider_customer(4200000001u, 65000);
+    g.add_provider_customer(65000, 13335);
+
+    BGPSim sim(g);
+    sim.seed_prefix("10.0.0.0/24", 13335);
+    sim.propagate_all();
+
+    const uint32_t id = sim.prefixes().find("10.0.0.0/24");
+    const auto& rib = sim.policy(4200000001u).local_rib();
+    auto it = rib.find(id);
+    ASSERT_NE(it, rib.end());
+    EXPECT_EQ(it->second.next_hop_asn, 65000u);
+    EXPECT_EQ(sim.as_path(4200000001u, it->second),
+              (std::vector<uint32_t>{4200000001u, 65000, 13335}));
+
+    EXPECT_THROW(sim.seed_prefix("10.0.0.0/24", 7), std::runtime_error);
+}
+
+
+// -------------------- PARALLEL PROPAGATION TESTS --------------------
+
+// Three-tier graph wide enough that layer sweeps take the threaded path:
+// 4 peering tier-1s, 40 transits with two providers each, 2000 stubs.
+static ASGraph make_wide_graph() {
+    ASGraph g;
+    for (uint32_t t = 1; t <= 4; ++t)
+        for (uint32_t u = t + 1; u <= 4; ++u)
+            g.add_peer(t, u);
+    for (uint32_t m = 0; m < 40; ++m) {
+        g.add_provider_customer(1 + m % 4, 100 + m);
+        g.add_provider_customer(1 + (m + 1) % 4, 100 + m);
+        if (m % 2 == 0) g.add_peer(100 + m, 101 + m);
+    }
+    for (uint32_t leaf = 0; leaf < 2000; ++leaf) {
+        g.add_provider_customer(100 + leaf % 40, 10000 + leaf);
+        if (leaf % 3 == 0) g.add_provider_customer(100 + (leaf * 7) % 40, 10000 + leaf);
+    }
+    return g;
+}
+
+template <typename Sim>
+static void seed_wide_prefixes(Sim& sim) {
+    for (uint32_t k = 0; k < 20; ++k)
+        sim.seed_prefix("10." + std::to_string(k) + ".0.0/16",
+                        10000 + (k * 97) % 2000);
+    sim.seed_prefix("10.0.0.0/16", 10500, true);
+}
+
+static void expect_same_ribs(const BGPSim& expected, const BGPSim& actual) {
+    const CSRGraph& g = expected.graph();
+    for (uint32_t id = 1; id < g.size(); ++id) {
+        const auto& a = expected.policy_at(id).local_rib();
+        const auto& b = actual.policy_at(id).local_rib();
+        ASSERT_EQ(a.size(), b.size()) << "asn " << g.asn_of(id);
+        for (const auto& [prefix_id, ann] : a) {
+            auto it = b.find(prefix_id);
+            ASSERT_NE(it, b.end());
+            EXPECT_EQ(it->second.received_from, ann.received_from);
+            EXPECT_EQ(it->second.next_hop_asn, ann.next_hop_asn);
+            EXPECT_EQ(actual.as_path(g.asn_of(id), it->second),
+                      expected.as_path(g.asn_of(id), ann));
+        }
+    }
+}
+
+TEST(BGPSimParallelTest, ThreadedLayersMatchSerial) {
+    auto topo = make_topology(make_wide_graph());
+    std::vector<uint32_t> rov_asns = {2, 105, 117};
+
+    BGPSim serial(topo, rov_asns);
+    BGPSim threaded(topo, rov_asns);
+    threaded.set_num_threads(4);
+    EXPECT_EQ(threaded.num_threads(), 4u);
+
+    for (BGPSim* sim : {&serial, &threaded}) {
+        seed_wide_prefixes(*sim);
+        sim->propagate_all();
+    }
+
+    expect_same_ribs(serial, threaded);
+}
+
+TEST(BGPSimPullTest, PullMatchesPushSerialAndThreaded) {
+    auto topo = make_topology(make_wide_graph());
+    std::vector<uint32_t> rov_asns = {2, 105, 117};
+
+    BGPSim push(topo, rov_asns);
+    BGPSim pull(topo, rov_asns);
+    BGPSim pull_threaded(topo, rov_asns);
+    pull.set_strategy(Strategy::PULL);
+    pull_threaded.set_strategy(Strategy::PULL);
+    pull_threaded.set_num_threads(3);
+
+    for (BGPSim* sim : {&push, &pull, &pull_threaded}) {
+        seed_wide_prefixes(*sim);
+        sim->propagate_all();
+    }
+
+    expect_same_ribs(push, pull);
+    expect_same_ribs(push, pull_threaded);
+}
+
+TEST(BGPSimParallelTest, BufferedSelectionMatchesFused) {
+    auto topo = make_topology(make_wide_graph());
+    std::vector<uint32_t> rov_asns = {2, 105, 117};
+
+    BGPSim fused(topo, rov_asns);
+    BGPSim buffered(topo, rov_asns);
+    EXPECT_EQ(fused.selection(), Selection::FUSED);
+    buffered.set_selection(Selection::BUFFERED);
+    buffered.set_num_threads(3);
+
+    for (BGPSim* sim : {&fused, &buffered}) {
+        seed_wide_prefixes(*sim);
+        sim->propagate_all();
+    }
+
+    expect_same_ribs(fused, buffered);
+}
+
+TEST(BGPSimPullTest, PeerRoutesAreNotChained) {
+    // 1 -- 2 -- 3 peer chain: 3 must not learn 1's route through 2
+    ASGraph g(3);
+    g.add_peer(1, 2);
+    g.add_peer(2, 3);
+
+    BGPSim sim(g);
+    sim.set_strategy(Strategy::PULL);
+    sim.seed_prefix("1.2.3.0/24", 1);
+    sim.propagate_all();
+
+    const uint32_t id = sim.prefixes().find("1.2.3.0/24");
+    EXPECT_EQ(sim.policy(2).local_rib().count(id), 1u);
+    EXPECT_EQ(sim.policy(3).local_rib().count(id), 0u);
+}
+
+
+TEST(OutputTest, ParallelRowsAreByteIdentical) {
+    ASGraph g(2);
+    g.add_provider_customer(1, 2);
+    BGPSim small(g);
+    small.seed_prefix("10.0.0.0/24", 2);
+    small.propagate_all();
+
+    std::ostringstream rows;
+    write_routing_rows(small, rows);
+    EXPECT_EQ(rows.str(), "1,10.0.0.0/24,\"(1, 2)\"\n"
+                          "2,10.0.0.0/24,\"(2,)\"\n");
+
+    auto topo = make_topology(make_wide_graph());
+    BGPSim sim(topo, {2, 105});
+    ColumnarSim col(topo, {2, 105});
+    seed_wide_prefixes(sim);
+    seed_wide_prefixes(col);
+    sim.propagate_all();
+    col.propagate_all();
+
+    std::ostringstream serial, threaded, col_serial, col_threaded;
+    write_routing_rows(sim, serial);
+    write_routing_rows(sim, threaded, 4);
+    write_routing_rows(col, col_serial);
+    write_routing_rows(col, col_threaded, 3);
+    EXPECT_FALSE(serial.str().empty());
+    EXPECT_EQ(serial.str(), threaded.str());
+    EXPECT_EQ(col_serial.str(), col_threaded.str());
+}
+
+TEST(OutputTest, BinaryRibsRoundTripWithSharedPaths) {
+    auto topo = make_topology(make_wide_graph());
+    BGPSim sim(topo, {2, 105});
+    seed_wide_prefixes(sim);
+    sim.propagate_all();
+
+    write_routing_binary(sim, "ribs_test.bin");
+    const BinaryRibs ribs = read_routing_binary("ribs_test.bin");
+
+    std::size_t rows = 0, path_nodes = 0;
+    for (uint32_t id = 1; id < topo->graph.size(); ++id) {
+        const uint32_t asn = topo->graph.asn_of(id);
+        for (const auto& [prefix_id, ann] : sim.policy_at(id).local_rib()) {
+            ASSERT_LT(rows, ribs.size());
+            EXPECT_EQ(ribs.asn[rows], asn);
+            EXPECT_EQ(ribs.prefixes[ribs.prefix_id[rows]],
+                      sim.prefixes().name(prefix_id));
+            EXPECT_EQ(ribs.path(rows), sim.as_path(asn, ann));
+            path_nodes += ann.path_len - 1;
+            ++rows;
+        }
+    }
+    EXPECT_EQ(rows, ribs.size());
+    EXPECT_LT(ribs.pool_asn.size() * 4, path_nodes);   // suffixes are shared
+
+    { std::ofstream junk("ribs_junk.bin"); junk << "asn,prefix,as_path\n"; }
+    EXPECT_THROW(read_routing_binary("ribs_junk.bin"), std::runtime_error);
+    std::remove("ribs_test.bin");
+    std::remove("ribs_junk.bin");
+}
+
+TEST(OutputTest, StreamedRowsMatchAndRibsAreReleased) {
+    auto topo = make_topology(make_wide_graph());
+    BGPSim whole(topo, {2, 105});
+    seed_wide_prefixes(whole);
+    whole.propagate_all();
+
+    std::ostringstream full;
+    write_routing_rows(whole, full);
+    std::vector<std::string> expected;
+    std::istringstream full_in(full.str());
+    for (std::string line; std::getline(full_in, line);) expected.push_back(line);
+    std::sort(expected.begin(), expected.end());
+
+    for (Strategy strategy : {Strategy::PUSH, Strategy::PULL}) {
+        BGPSim sim(topo, {2, 105});
+        sim.set_strategy(strategy);
+        seed_wide_prefixes(sim);
+        sim.propagate_up();
+        sim.propagate_across_peers();
+
+        std::ostringstream streamed;
+        std::vector<int> reported(topo->graph.size(), 0);
+        sim.propagate_down_streaming([&](const std::vector<uint32_t>& ids) {
+            for (uint32_t id : ids) ++reported[id];
+            write_routing_rows(sim, ids, streamed);
+        });
+
+        std::vector<std::string> got;
+        std::istringstream in(streamed.str());
+        for (std::string line; std::getline(in, line);) got.push_back(line);
+        std::sort(got.begin(), got.end());
+        EXPECT_EQ(got, expected);
+
+        for (uint32_t id = 1; id < topo->graph.size(); ++id) {
+            EXPECT_EQ(reported[id], 1);
+            EXPECT_TRUE(sim.policy_at(id).local_rib().empty());
+        }
+    }
+}
+
+TEST(OutputTest, StubRibsAreReleasedDuringTheDownPhase) {
+    auto topo = make_topology(make_wide_graph());
+    const auto is_stub = [&](uint32_t id) { return topo->ranks[id] == 0; };
+    const auto has_down_route = [](const Policy& pol) {
+        for (const auto& kv : pol.local_rib())
+            if (kv.second.received_from == Relationship::FROM_PROVIDER) return true;
+        return false;
+    };
+
+    for (Strategy strategy : {Strategy::PUSH, Strategy::PULL}) {
+        BGPSim sim(topo, {2, 105});
+        sim.set_strategy(strategy);
+        seed_wide_prefixes(sim);
+        sim.propagate_up();
+        sim.propagate_across_peers();
+
+        std::size_t stub_batches = 0;
+        std::size_t stubs_reported = 0;
+        sim.propagate_down_streaming([&](const std::vector<uint32_t>& ids) {
+            std::size_t stubs = 0;
+            for (uint32_t id : ids) stubs += is_stub(id);
+            if (stubs == 0) return;
+            ++stub_batches;
+            stubs_reported += stubs;
+
+            // no stub outside the batches handed out so far has been reached
+            std::size_t reached = 0;
+            for (uint32_t id = 1; id < topo->graph.size(); ++id)
+                if (is_stub(id) && has_down_route(sim.policy_at(id))) ++reached;
+            EXPECT_LE(reached, stubs);
+        });
+
+        EXPECT_EQ(stubs_reported, 2000u);
+        EXPECT_GE(stub_batches, 4u);
+    }
+}
+
+// -------------------- INCREMENTAL UPDATE TESTS --------------------
+
+TEST(BGPSimIncrementalTest, UpdatesMatchFullPropagation) {
+    auto topo = make_topology(make_wide_graph());
+    std::vector<uint32_t> rov = {2, 105, 117};
+
+    std::vector<Seed> seeds;
+    for (uint32_t k = 0; k < 8; ++k)
+        seeds.push_back({"10." + std::to_string(k) + ".0.0/16",
+                         10000 + (k * 97) % 2000, false});
+    seeds.push_back({"10.0.0.0/16", 10500, true});
+
+    auto full = [&](const std::vector<Seed>& s, const std::vector<uint32_t>& r) {
+        auto sim = std::make_unique<BGPSim>(topo, r);
+        seed_all(*sim, s);
+        sim->propagate_all();
+        return sim;
+    };
+
+    BGPSim sim(topo, rov);
+    seed_all(sim, seeds);
+    sim.propagate_all();
+
+    sim.announce("10.3.0.0/16", 11444, true);         // ROV-invalid hijack
+    seeds.push_back({"10.3.0.0/16", 11444, true});
+    sim.announce("10.5.0.0/16", 105);                 // second origin, transit
+    seeds.push_back({"10.5.0.0/16", 105, false});
+    sim.announce("10.99.0.0/16", 10077);              // brand new prefix
+    seeds.push_back({"10.99.0.0/16", 10077, false});
+    expect_same_ribs(*full(seeds, rov), sim);
+
+    EXPECT_TRUE(sim.withdraw("10.5.0.0/16", 10000 + (5 * 97) % 2000));
+    EXPECT_FALSE(sim.withdraw("10.5.0.0/16", 12345));
+    seeds[5] = seeds[10];            // keep 10.5's prefix id in the rebuild
+    seeds.erase(seeds.begin() + 10);
+    expect_same_ribs(*full(seeds, rov), sim);
+
+    sim.set_rov(1, true);      // tier-1
+    sim.set_rov(105, false);
+    sim.set_rov(10500, true);  // origin of an invalid seed
+    rov = {1, 2, 117, 10500};
+    expect_same_ribs(*full(seeds, rov), sim);
+}
+
+// compares RIBs by prefix name, so the two sides may have interned their
+// prefixes in different orders
+static void expect_same_routes(const BGPSim& expected, const BGPSim& actual) {
+    const CSRGraph& g = expected.graph();
+    for (uint32_t id = 1; id < g.size(); ++id) {
+        const uint32_t asn = g.asn_of(id);
+        const auto& a = expected.policy_at(id).local_rib();
+        const auto& b = actual.policy_at(id).local_rib();
+        ASSERT_EQ(a.size(), b.size()) << "asn " << asn;
+        for (const auto& [prefix_id, ann] : a) {
+            const uint32_t other = actual.prefixes().find(expected.prefixes().name(prefix_id));
+            ASSERT_NE(other, PrefixTable::npos);
+            auto it = b.find(other);
+            ASSERT_NE(it, b.end()) << "asn " << asn;
+            EXPECT_EQ(it->second.received_from, ann.received_from);
+            EXPECT_EQ(it->second.next_hop_asn, ann.next_hop_asn);
+            EXPECT_EQ(actual.as_path(asn, it->second), expected.as_path(asn, ann));
+        }
+    }
+}
+
+TEST(BGPSimIncrementalTest, RandomUpdatesMatchFullPropagation) {
+    auto topo = make_topology(make_wide_graph());
+    const CSRGraph& g = topo->graph;
+    std::mt19937 rng(20261015);
+    auto pick = [&](std::size_t n) {
+        return static_cast<std::size_t>(std::uniform_int_distribution<std::size_t>(0, n - 1)(rng));
+    };
+    auto random_asn = [&] { return g.asn_of(static_cast<uint32_t>(1 + pick(g.size() - 1))); };
+    auto random_prefix = [&] { return "10." + std::to_string(pick(12)) + ".0.0/16"; };
+
+    std::vector<Seed> seeds;
+    std::vector<uint32_t> rov = {2, 105, 117};
+    BGPSim sim(topo, rov);
+    sim.propagate_all();
+
+    for (int step = 0; step < 300; ++step) {
+        const std::size_t op = pick(10);
+        if (op < 5 || seeds.empty()) {
+            Seed s{random_prefix(), random_asn(), pick(4) == 0};
+            sim.announce(s.prefix, s.origin_asn, s.rov_invalid);
+            seeds.push_back(s);
+        } else if (op < 8) {
+            const Seed gone = pick(5) ? seeds[pick(seeds.size())]
+                                      : Seed{random_prefix(), random_asn(), false};
+            const auto kept = std::remove_if(seeds.begin(), seeds.end(), [&](const Seed& s) {
+                return s.prefix == gone.prefix && s.origin_asn == gone.origin_asn;
+            });
+            EXPECT_EQ(sim.withdraw(gone.prefix, gone.origin_asn), kept != seeds.end());
+            seeds.erase(kept, seeds.end());
+        } else {
+            const uint32_t asn = random_asn();
+            const bool deploy = pick(2) == 0;
+            sim.set_rov(asn, deploy);
+            auto pos = std::find(rov.begin(), rov.end(), asn);
+            if (deploy && pos == rov.end()) rov.push_back(asn);
+            if (!deploy && pos != rov.end()) rov.erase(pos);
+        }
+
+        BGPSim full(topo, rov);
+        seed_all(full, seeds);
+        full.propagate_all();
+        expect_same_routes(full, sim);
+        if (::testing::Test::HasFailure()) {
+            ADD_FAILURE() << "diverged at step " << step;
+            return;
+        }
+    }
+}
+
+// -------------------- SHARDED SIMULATION TESTS --------------------
+
+TEST(ShardedSimTest, ShardsKeepPrefixSeedsTogether) {
+    std::vector<Seed> seeds = {
+        {"a", 1, false}, {"b", 2, false}, {"a", 3, true},
+        {"c", 4, false}, {"d", 5, false}, {"c", 6, false},
+    };
+
+    auto shards = shard_seeds(seeds, 2);
+    ASSERT_EQ(shards.size(), 2u);
+    ASSERT_EQ(shards[0].size(), 3u);   // a, b, a
+    EXPECT_EQ(shards[0][2].origin_asn, 3u);
+    ASSERT_EQ(shards[1].size(), 3u);   // c, d, c
+    EXPECT_EQ(shards[1][0].prefix, "c");
+}
+
+TEST(ShardedSimTest, ShardedRunMatchesSingleRun) {
+    auto topo = make_topology(make_wide_graph());
+    std::vector<uint32_t> rov_asns = {2, 105, 117};
+
+    std::vector<Seed> seeds;
+    for (uint32_t k = 0; k < 12; ++k)
+        seeds.push_back({"10." + std::to_string(k) + ".0.0/16",
+                         10000 + (k * 131) % 2000, k % 4 == 0});
+
+    ColumnarSim whole(topo, rov_asns);
+    seed_all(whole, seeds);
+    whole.propagate_all();
+
+    std::vector<std::size_t> order;
+    std::size_t routes = 0;
+    run_sharded<ColumnarSim>(topo, rov_asns, shard_seeds(seeds, 5), 3,
+        [](ColumnarSim&) {},
+        [&](std::size_t k, const ColumnarSim& shard) {
+            order.push_back(k);
+            for (uint32_t id = 0; id < shard.prefixes().size(); ++id) {
+                const uint32_t whole_id =
+                    whole.prefixes().find(shard.prefixes().name(id));
+                const auto& a = whole.rib(whole_id);
+                const auto& b = shard.rib(id);
+                for (uint32_t asn_id = 1; asn_id < topo->graph.size(); ++asn_id) {
+                    ASSERT_EQ(a.rel[asn_id], b.rel[asn_id]);
+                    if (a.rel[asn_id] == ColumnarSim::kNoRoute) continue;
+                    ++routes;
+                    const uint32_t asn = topo->graph.asn_of(asn_id);
+                    EXPECT_EQ(whole.paths().expand(asn, a.path[asn_id]),
+                              shard.paths().expand(asn, b.path[asn_id]));
+                }
+            }
+        });
+
+    EXPECT_EQ(order, (std::vector<std::size_t>{0, 1, 2}));
+    EXPECT_GT(routes, 0u);
+}
+
+// -------------------- SCENARIO BATCH TESTS --------------------
+
+static std::vector<Scenario> make_wide_scenarios() {
+    std::vector<Scenario> scenarios;
+    for (uint32_t k = 0; k < 6; ++k) {
+        Scenario sc;
+        sc.seeds.push_back({"10.0.0.0/16", 10000 + k * 37, false});
+        sc.seeds.push_back({"10.0.0.0/16", 11000 + k * 53, true});    // hijack
+        sc.seeds.push_back({"10." + std::to_string(k) + ".0.0/16", 101, false});
+        for (uint32_t a = 100 + k; a < 140; a += 3) sc.rov_asns.push_back(a);
+        scenarios.push_back(std::move(sc));
+    }
+    return scenarios;
+}
+
+TEST(ScenarioBatchTest, ResetSimulatorMatchesFreshOne) {
+    auto topo = make_topology(make_wide_graph());
+    auto scenarios = make_wide_scenarios();
+
+    for (Strategy strategy : {Strategy::PUSH, Strategy::PULL}) {
+        BGPSim reused(topo, scenarios[0].rov_asns);
+        reused.set_strategy(strategy);
+        seed_all(reused, scenarios[0].seeds);
+        reused.propagate_all();
+
+        reused.reset(scenarios[1].rov_asns);
+        seed_all(reused, scenarios[1].seeds);
+        reused.propagate_all();
+
+        BGPSim fresh(topo, scenarios[1].rov_asns);
+        seed_all(fresh, scenarios[1].seeds);
+        fresh.propagate_all();
+
+        EXPECT_EQ(reused.prefixes().size(), fresh.prefixes().size());
+        expect_same_ribs(fresh, reused);
+    }
+}
+
+TEST(ScenarioBatchTest, ConcurrentBatchMatchesIndividualRuns) {
+    auto topo = make_topology(make_wide_graph());
+    auto scenarios = make_wide_scenarios();
+
+    std::vector<std::string> expected(scenarios.size()), got(scenarios.size());
+    for (std::size_t k = 0; k < scenarios.size(); ++k) {
+        BGPSim sim(topo, scenarios[k].rov_asns);
+        seed_all(sim, scenarios[k].seeds);
+        sim.propagate_all();
+        std::ostringstream out;
+        write_routing_rows(sim, out);
+        expected[k] = out.str();
+    }
+
+    run_scenarios<BGPSim>(topo, scenarios, 3,
+        [](BGPSim&) {},
+        [&](std::size_t k, const BGPSim& sim) {
+            std::ostringstream out;
+            write_routing_rows(sim, out);
+            got[k] = out.str();
+        });
+    EXPECT_EQ(got, expected);
+
+    std::vector<std::string> columnar(scenarios.size());
+    run_scenarios<ColumnarSim>(topo, scenarios, 2,
+        [](ColumnarSim&) {},
+        [&](std::size_t k, const ColumnarSim& sim) {
+            std::ostringstream out;
+            write_routing_rows(sim, out);
+            columnar[k] = out.str();
+        });
+    for (std::size_t k = 0; k < scenarios.size(); ++k) {
+        EXPECT_FALSE(columnar[k].empty());
+        EXPECT_EQ(columnar[k].size(), expected[k].size());
+    }
+}
+
+// -------------------- STATS TESTS --------------------
+
+TEST(StatsTest, CountsPhasesThreadsAndLayers) {
+    if (!kStatsCompiled) GTEST_SKIP();
+
+    auto topo = make_topology(make_wide_graph());
+    BGPSim sim(topo, {2, 105, 117});
+    sim.set_num_threads(2);
+    sim.set_collect_stats(true);
+    seed_wide_prefixes(sim);
+    sim.propagate_all();
+
+    const auto& phases = sim.phase_stats();
+    ASSERT_EQ(phases.size(), 3u);
+    EXPECT_EQ(phases[0].name, "propagate_up");
+    EXPECT_EQ(phases[2].name, "propagate_down");
+
+    uint64_t installed = 0, dropped = 0;
+    for (const PhaseStats& p : phases) {
+        ASSERT_EQ(p.per_thread.size(), 2u);
+        PropagationCounters sum;
+        for (const auto& c : p.per_thread) sum += c;
+        EXPECT_EQ(sum.installed, p.total.installed);
+        EXPECT_LE(p.total.installed, p.total.enqueued);
+        installed += p.total.installed;
+        dropped += p.total.dropped;
+    }
+    EXPECT_GT(installed, 0u);
+    EXPECT_GT(dropped, 0u);   // the invalid origin is filtered by ROV ASes
+
+    std::size_t ases = 0;
+    for (const LayerStats& l : phases[0].layers) ases += l.ases;
+    EXPECT_EQ(ases, topo->graph.size() - 1 - topo->layers[0].size());
+    EXPECT_GT(phases[2].rib_entries, phases[0].rib_entries);
+    EXPECT_LE(phases[2].max_rib, 21u);
+
+    std::ostringstream json;
+    write_stats_json(json, RunStats{{{"propagate", 0.5}}, phases});
+    EXPECT_NE(json.str().find("\"propagate_across_peers\""), std::string::npos);
+}
+
+// -------------------- TOPOLOGY GENERATOR TESTS --------------------
+
+TEST(TopologyGeneratorTest, WritesAcyclicGraphWithConfiguredDepth) {
+    GeneratorConfig cfg;
+    cfg.num_ases = 3000;
+    cfg.tier1 = 6;
+    cfg.transit_levels = 3;
+    cfg.num_prefixes = 200;
+    cfg.hijack_fraction = 0.25;
+    cfg.seed = 42;
+    SyntheticTopology topo = generate_topology(cfg);
+
+    const std::string file = "generated_test.txt";
+    {
+        std::ofstream out(file);
+        write_caida(topo, out);
+    }
+    ASGraph graph;
+    build_graph(file, graph);
+    std::remove(file.c_str());
+
+    EXPECT_EQ(graph.size(), cfg.num_ases + 1);
+    EXPECT_NO_THROW(assert_provider_acyclic(graph));
+    auto flat = make_topology(graph);
+    ASSERT_EQ(flat->layers.size(), cfg.transit_levels + 2);
+
+    // preferential attachment: a few providers collect most customers
+    std::size_t max_customers = 0;
+    for (uint32_t id = 1; id < flat->graph.size(); ++id)
+        max_customers = std::max(max_customers, flat->graph.get(id).customers.size());
+    EXPECT_GT(max_customers, 20 * topo.provider_customer.size() / cfg.num_ases);
+
+    std::size_t invalid = 0;
+    for (const Seed& s : topo.seeds) {
+        EXPECT_NE(graph.id_of(s.origin_asn), kNoId);
+        invalid += s.rov_invalid;
+    }
+    EXPECT_EQ(topo.seeds.size(), cfg.num_prefixes + invalid);
+    EXPECT_GT(invalid, 0u);
+    EXPECT_FALSE(topo.rov_asns.empty());
+}
+
+TEST(TopologyGeneratorTest, SameSeedReproducesFiles) {
+    GeneratorConfig cfg;
+    cfg.num_ases = 1000;
+    cfg.num_prefixes = 50;
+
+    auto render = [](const GeneratorConfig& c) {
+        SyntheticTopology topo = generate_topology(c);
+        std::ostringstream out;
+        write_caida(topo, out);
+        write_announcements(topo, out);
+        write_rov_asns(topo, out);
+        return out.str();
+    };
+    EXPECT_EQ(render(cfg), render(cfg));
+    GeneratorConfig other = cfg;
+    other.seed = 2;
+    EXPECT_NE(render(cfg), render(other));
+}
+
+TEST(TopologyGeneratorTest, ParallelRanksMatchSerial) {
+    GeneratorConfig cfg;
+    cfg.num_ases = 20000;
+    cfg.num_prefixes = 0;
+    SyntheticTopology gen = generate_topology(cfg);
+
+    ASGraph g;
+    for (const auto& [p, c] : gen.provider_customer) g.add_provider_customer(p, c);
+    for (const auto& [a, b] : gen.peers) g.add_peer(a, b);
+    CSRGraph csr(g);
+
+    ThreadPool pool(4);
+    EXPECT_EQ(compute_propagation_ranks(csr, &pool), compute_propagation_ranks(csr));
+    EXPECT_EQ(make_topology(g, 4)->layers, make_topology(g)->layers);
+}
+
+TEST(TopologyGeneratorTest, ParallelChunkedLoadMatchesBuilder) {
+    GeneratorConfig cfg;
+    cfg.num_ases = 60000;
+    cfg.num_prefixes = 0;
+    std::ostringstream out;
+    write_caida(generate_topology(cfg), out);
+    const std::string text = out.str();
+
+    const std::string file = "generated_chunked.txt";
+    std::ofstream(file) << text;
+    ASGraph g;
+    build_graph(file, g);
+    std::remove(file.c_str());
+
+    CSRGraph serial = build_csr_graph(text, 1);
+    CSRGraph parallel = build_csr_graph(text, 4);
+    expect_same_csr(CSRGraph(g), serial);
+    expect_same_csr(serial, parallel);
+}
+
+// -------------------- INPUT FILE TESTS --------------------
+
+TEST(InputFilesTest, ParsesAnnouncementsAndRovAsns) {
+    const std::string anns =
+        "seed_asn,prefix,rov_invalid\r\n"
+        "# comment\n"
+        "\n"
+        " 13335 , 1.1.1.0/24 , False\r\n"
+        "64512,1.1.1.0/24,TRUE\n"
+        "7018,12.0.0.0/8\n"                  // too few fields: skipped
+        "3356,4.0.0.0/9,1";
+    std::vector<SeedView> seen;
+    parse_announcements(anns, [&](const SeedView& s) { seen.push_back(s); });
+    ASSERT_EQ(seen.size(), 3u);
+    EXPECT_EQ(seen[0].origin_asn, 13335u);
+    EXPECT_EQ(seen[0].prefix, "1.1.1.0/24");
+    EXPECT_FALSE(seen[0].rov_invalid);
+    EXPECT_TRUE(seen[1].rov_invalid);
+    EXPECT_EQ(seen[2].prefix, "4.0.0.0/9");
+    EXPECT_TRUE(seen[2].rov_invalid);
+
+    auto none = [](const SeedView&) {};
+    EXPECT_THROW(parse_announcements("1,10.0.0.0/8,maybe\n", none), std::runtime_error);
+    EXPECT_THROW(parse_announcements("1,x,0\n12a,10.0.0.0/8,0\n", none), std::runtime_error);
+    EXPECT_THROW(parse_announcements("1,x,0\n4294967296,x,0\n", none), std::runtime_error);
+
+    EXPECT_EQ(parse_rov_asns("asn\n174\r\n 3356 \n\n# x\n7018,extra\n"),
+              (std::vector<uint32_t>{174, 3356, 7018}));
+    EXPECT_EQ(parse_rov_asns("174\n"), (std::vector<uint32_t>{174}));
+    EXPECT_THROW(parse_rov_asns("asn\n17x\n"), std::runtime_error);
+}
+
+TEST(InputFilesTest, BulkSeedingMatchesOneByOne) {
+    auto topo = make_topology(make_wide_graph());
+    std::vector<Seed> seeds;
+    for (uint32_t k = 0; k < 50; ++k) {
+        const std::string prefix = "10." + std::to_string(k % 30) + ".0.0/16";
+        seeds.push_back(Seed{prefix, 10000 + (k * 37) % 2000, k % 7 == 0});
+        if (k % 5 == 0) seeds.push_back(Seed{prefix, 100 + k % 40, false});
+    }
+    seeds.push_back(seeds.front());   // same origin twice
+
+    for (Selection sel : {Selection::FUSED, Selection::BUFFERED}) {
+        BGPSim one(topo, {2, 105, 117});
+        BGPSim bulk(topo, {2, 105, 117});
+        one.set_selection(sel);
+        bulk.set_selection(sel);
+        for (const Seed& s : seeds)
+            one.seed_prefix(s.prefix, s.origin_asn, s.rov_invalid);
+        bulk.seed_prefixes(seeds);
+        expect_same_ribs(one, bulk);
+
+        one.propagate_all();
+        bulk.propagate_all();
+        expect_same_ribs(one, bulk);
+    }
+
+    BGPSim sim(topo, {});
+    std::vector<Seed> bad = {seeds[0], Seed{"10.99.0.0/16", 999999, false}};
+    EXPECT_THROW(sim.seed_prefixes(bad), std::runtime_error);
+    EXPECT_EQ(sim.prefixes().size(), 0u);   // nothing seeded
+}
+
+TEST(InputFilesTest, SeedsFromViewsOfTheMappedFile) {
+    auto topo = make_topology(make_wide_graph());
+    std::vector<Seed> seeds;
+    for (uint32_t k = 0; k < 40; ++k)
+        seeds.push_back(Seed{"10." + std::to_string(k % 25) + ".0.0/16",
+                             10000 + (k * 53) % 2000, k % 6 == 0});
+
+    const std::string filename = "mapped_anns.csv";
+    {
+        std::ofstream out(filename);
+        out << "seed_asn,prefix,rov_invalid\n";
+        for (const Seed& s : seeds)
+            out << s.origin_asn << "," << s.prefix << "," << (s.rov_invalid ? "True" : "False") << "\n";
+    }
+
+    BGPSim owned(topo, {2, 105, 117});
+    owned.seed_prefixes(seeds);
+    owned.propagate_all();
+
+    BGPSim viewed(topo, {2, 105, 117});
+    ColumnarSim col(topo, {2, 105, 117});
+    {
+        AnnouncementsFile anns(filename);
+        ASSERT_EQ(anns.seeds().size(), seeds.size());
+        viewed.seed_prefixes(anns.seeds());
+        col.seed_prefixes(anns.seeds());
+        EXPECT_EQ(shard_seeds(anns.seeds(), 7).size(), shard_seeds(seeds, 7).size());
+    }
+    // the interned names outlive the mapping
+    viewed.propagate_all();
+    col.propagate_all();
+    expect_same_ribs(owned, viewed);
+    EXPECT_EQ(col.prefixes().size(), owned.prefixes().size());
+
+    PrefixTable copy = viewed.prefixes();
+    for (uint32_t p = 0; p < copy.size(); ++p)
+        EXPECT_EQ(copy.find(copy.name(p)), p);
+    std::remove(filename.c_str());
+}
+
+// -------------------- ROUTE SUMMARY TESTS --------------------
+
+static void expect_same_summaries(const std::vector<PrefixSummary>& a,
+                                  const std::vector<PrefixSummary>& b) {
+    ASSERT_EQ(a.size(), b.size());
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        EXPECT_EQ(a[i].prefix, b[i].prefix);
+        EXPECT_EQ(a[i].ases, b[i].ases);
+        EXPECT_EQ(a[i].routed, b[i].routed);
+        EXPECT_EQ(a[i].invalid, b[i].invalid);
+        EXPECT_EQ(a[i].rov_ases, b[i].rov_ases);
+        EXPECT_EQ(a[i].rov_invalid, b[i].rov_invalid);
+        EXPECT_EQ(a[i].path_lengths, b[i].path_lengths);
+    }
+}
+
+TEST(RouteSummaryTest, MatchesCountsFromFullRibs) {
+    auto topo = make_topology(make_wide_graph());
+    const std::vector<uint32_t> rov_asns = {2, 105, 117};
+
+    BGPSim sim(topo, rov_asns);
+    seed_wide_prefixes(sim);
+    sim.propagate_all();
+
+    std::vector<PrefixSummary> expected(sim.prefixes().size());
+    for (uint32_t p = 0; p < expected.size(); ++p) {
+        expected[p].prefix = sim.prefixes().name(p);
+        expected[p].ases = topo->graph.size() - 1;
+        expected[p].rov_ases = rov_asns.size();
+    }
+    for (uint32_t id = 1; id < topo->graph.size(); ++id) {
+        const bool rov = std::count(rov_asns.begin(), rov_asns.end(),
+                                    topo->graph.asn_of(id)) > 0;
+        for (const auto& [prefix_id, ann] : sim.policy_at(id).local_rib()) {
+            PrefixSummary& e = expected[prefix_id];
+            ++e.routed;
+            e.invalid += ann.rov_invalid;
+            e.rov_invalid += ann.rov_invalid && rov;
+            if (e.path_lengths.size() <= ann.path_len)
+                e.path_lengths.resize(ann.path_len + 1, 0);
+            ++e.path_lengths[ann.path_len];
+        }
+    }
+    EXPECT_GT(expected[0].invalid, 0u);       // 10.0.0.0/16 is hijacked
+    EXPECT_EQ(expected[0].rov_invalid, 0u);   // ROV ASes dropped it
+
+    RouteSummarizer serial;
+    serial.add(sim);
+    expect_same_summaries(expected, serial.summaries());
+
+    ThreadPool pool(4);
+    RouteSummarizer threaded;
+    threaded.add(sim, &pool);
+    expect_same_summaries(expected, threaded.summaries());
+
+    ColumnarSim columnar(topo, rov_asns);
+    seed_wide_prefixes(columnar);
+    columnar.propagate_all();
+    RouteSummarizer from_columns;
+    from_columns.add(columnar, &pool);
+    expect_same_summaries(expected, from_columns.summaries());
+
+    std::ostringstream csv;
+    write_route_summary(serial.summaries(), csv);
+    EXPECT_EQ(csv.str().substr(0, csv.str().find('\n')),
+              "prefix,ases,routed,invalid,rov_ases,rov_invalid,"
+              "rov_invalid_fraction,path_lengths");
+}
+
+TEST(RouteSummaryTest, StreamingAndShardsMatchWholeRun) {
+    auto topo = make_topology(make_wide_graph());
+    const std::vector<uint32_t> rov_asns = {2, 105, 117};
+    std::vector<Seed> seeds;
+    for (uint32_t k = 0; k < 12; ++k)
+        seeds.push_back({"10." + std::to_string(k) + ".0.0/16",
+                         10000 + (k * 131) % 2000, false});
+    seeds.push_back({"10.4.0.0/16", 10007, true});
+
+    BGPSim whole(topo, rov_asns);
+    seed_all(whole, seeds);
+    whole.propagate_all();
+    RouteSummarizer expected;
+    expected.add(whole);
+
+    BGPSim streamed(topo, rov_asns);
+    seed_all(streamed, seeds);
+    streamed.propagate_up();
+    streamed.propagate_across_peers();
+    RouteSummarizer during;
+    streamed.propagate_down_streaming([&](const std::vector<uint32_t>& ids) {
+        during.add(streamed, ids);
+    });
+    expect_same_summaries(expected.summaries(), during.summaries());
+
+    RouteSummarizer sharded;
+    run_sharded<BGPSim>(topo, rov_asns, shard_seeds(seeds, 5), 3,
+        [](BGPSim&) {},
+        [&](std::size_t, const BGPSim& shard) { sharded.add(shard); });
+    expect_same_summaries(expected.summaries(), sharded.summaries());
+}
+
+// -------------------- ID ORDER TESTS --------------------
+
+TEST(IdOrderTest, LayerOrderMakesLayersContiguous) {
+    auto input = make_topology(make_wide_graph());
+    auto layered = make_topology(make_wide_graph(), 1, IdOrder::LAYER);
+    const CSRGraph& a = input->graph;
+    const CSRGraph& b = layered->graph;
+    ASSERT_TRUE(b.well_formed());
+    ASSERT_EQ(a.size(), b.size());
+    ASSERT_EQ(input->layers.size(), layered->layers.size());
+
+    uint32_t next = 1;
+    for (std::size_t r = 0; r < layered->layers.size(); ++r) {
+        ASSERT_EQ(layered->layers[r].size(), input->layers[r].size());
+        for (uint32_t id : layered->layers[r]) {
+            EXPECT_EQ(id, next++);
+            EXPECT_EQ(layered->ranks[id], static_cast<int>(r));
+        }
+    }
+
+    auto asns = [](const CSRGraph& g, NeighborRange ids) {
+        std::vector<uint32_t> out;
+        for (uint32_t id : ids) out.push_back(g.asn_of(id));
+        std::sort(out.begin(), out.end());
+        return out;
+    };
+    for (uint32_t id = 1; id < a.size(); ++id) {
+        const uint32_t asn = a.asn_of(id);
+        const uint32_t other = b.id_of(asn);
+        ASSERT_NE(other, kNoId);
+        EXPECT_EQ(input->ranks[id], layered->ranks[other]);
+        EXPECT_EQ(asns(a, a.providers(id)), asns(b, b.providers(other)));
+        EXPECT_EQ(asns(a, a.customers(id)), asns(b, b.customers(other)));
+        EXPECT_EQ(asns(a, a.peers(id)), asns(b, b.peers(other)));
+    }
+
+    // stubs under the same single transit (AS 100) are numbered next to
+    // each other
+    const uint32_t first = b.id_of(10000), sibling = b.id_of(10040);
+    EXPECT_EQ(asns(b, b.providers(first)), asns(b, b.providers(sibling)));
+    EXPECT_LT(std::max(first, sibling) - std::min(first, sibling), 80u);
+}
+
+TEST(IdOrderTest, LayeredIdsGiveSameRoutes) {
+    auto input = make_topology(make_wide_graph());
+    auto layered = relabel_by_layer(*input);
+    const std::vector<uint32_t> rov_asns = {2, 105, 117};
+
+    BGPSim a(input, rov_asns), b(layered, rov_asns);
+    b.set_num_threads(4);
+    seed_wide_prefixes(a);
+    seed_wide_prefixes(b);
+    a.propagate_all();
+    b.propagate_all();
+
+    for (uint32_t id = 1; id < input->graph.size(); ++id) {
+        const uint32_t asn = input->graph.asn_of(id);
+        const auto& ra = a.policy(asn).local_rib();
+        const auto& rb = b.policy(asn).local_rib();
+        ASSERT_EQ(ra.size(), rb.size()) << "asn " << asn;
+        for (const auto& [prefix_id, ann] : ra) {
+            auto it = rb.find(prefix_id);
+            ASSERT_NE(it, rb.end());
+            EXPECT_EQ(b.as_path(asn, it->second), a.as_path(asn, ann));
+        }
+    }
+}
+
+// -------------------- DISTRIBUTED TESTS --------------------
+
+static std::vector<Seed> distributed_seeds() {
+    std::vector<Seed> seeds;
+    for (uint32_t k = 0; k < 12; ++k)
+        seeds.push_back({"10." + std::to_string(k) + ".0.0/16",
+                         10000 + (k * 131) % 2000, k % 4 == 0});
+    return seeds;
+}
+
+static std::string binary_of(const BinaryRibWriter& writer) {
+    std::ostringstream out;
+    writer.write(out);
+    return out.str();
+}
+
+TEST(DistributedTest, WorkersMatchShardedRun) {
+    auto topo = make_topology(make_wide_graph());
+    const std::vector<uint32_t> rov_asns = {2, 105, 117};
+    const auto shards = shard_seeds(distributed_seeds(), 3);
+
+    BinaryRibWriter expected;
+    run_sharded<BGPSim>(topo, rov_asns, shards, 1, [](BGPSim&) {},
+        [&](std::size_t, const BGPSim& sim) { expected.add(sim); });
+
+    Coordinator coordinator(0);
+    std::size_t served[2] = {};
+    std::thread workers[2];
+    for (int w = 0; w < 2; ++w)
+        workers[w] = std::thread([&, w] {
+            served[w] = run_worker("127.0.0.1", coordinator.port(),
+                                   [](BGPSim& sim) { sim.set_num_threads(2); });
+        });
+
+    BinaryRibWriter merged;
+    std::vector<std::size_t> order;
+    coordinator.run(*topo, rov_asns, shards, 2,
+        [&](std::size_t k, const BinaryRibs& ribs) {
+            order.push_back(k);
+            merged.add(ribs);
+        });
+    for (auto& t : workers) t.join();
+
+    EXPECT_EQ(order, (std::vector<std::size_t>{0, 1, 2, 3}));
+    EXPECT_EQ(served[0] + served[1], shards.size());
+    EXPECT_EQ(binary_of(merged), binary_of(expected));
+}
+
+TEST(DistributedTest, LostWorkersShardIsRedone) {
+    auto topo = make_topology(make_wide_graph());
+    const auto shards = shard_seeds(distributed_seeds(), 4);
+
+    BinaryRibWriter expected;
+    run_sharded<BGPSim>(topo, {}, shards, 1, [](BGPSim&) {},
+        [&](std::size_t, const BGPSim& sim) { expected.add(sim); });
+
+    Coordinator coordinator(0);
+    // takes the topology and one shard, then hangs up
+    std::thread flaky([&] {
+        detail::Socket s = detail::connect_to("127.0.0.1", coordinator.port());
+        const uint32_t hello[2] = {kWireProtocolVersion, detail::kSnapshotByteOrder};
+        s.send_message(detail::WireType::HELLO, detail::wire_bytes(hello, sizeof(hello)));
+        for (int i = 0; i < 3; ++i) s.recv_message();
+    });
+    std::thread worker([&] { run_worker("127.0.0.1", coordinator.port()); });
+
+    BinaryRibWriter merged;
+    coordinator.run(*topo, {}, shards, 2,
+        [&](std::size_t, const BinaryRibs& ribs) { merged.add(ribs); });
+    flaky.join();
+    worker.join();
+    EXPECT_EQ(binary_of(merged), binary_of(expected));
+}
+
+TEST(DistributedTest, HungWorkersShardIsRedone) {
+    auto topo = make_topology(make_wide_graph());
+    const auto shards = shard_seeds(distributed_seeds(), 4);
+
+    BinaryRibWriter expected;
+    run_sharded<BGPSim>(topo, {}, shards, 1, [](BGPSim&) {},
+        [&](std::size_t, const BGPSim& sim) { expected.add(sim); });
+
+    Coordinator coordinator(0);
+    coordinator.set_result_timeout(std::chrono::milliseconds(500));
+    // takes a shard and never answers, until the coordinator hangs up
+    std::thread hung([&] {
+        detail::Socket s = detail::connect_to("127.0.0.1", coordinator.port());
+        const uint32_t hello[2] = {kWireProtocolVersion, detail::kSnapshotByteOrder};
+        s.send_message(detail::WireType::HELLO, detail::wire_bytes(hello, sizeof(hello)));
+        for (int i = 0; i < 3; ++i) s.recv_message();
+        EXPECT_THROW(s.recv_message(), std::runtime_error);
+    });
+    std::size_t served = 0;
+    std::thread worker([&] { served = run_worker("127.0.0.1", coordinator.port()); });
+
+    BinaryRibWriter merged;
+    coordinator.run(*topo, {}, shards, 2,
+        [&](std::size_t, const BinaryRibs& ribs) { merged.add(ribs); });
+    hung.join();
+    worker.join();
+    EXPECT_EQ(served, shards.size());
+    EXPECT_EQ(binary_of(merged), binary_of(expected));
+}
+
+TEST(DistributedTest, FailedShardDismissesTheOtherWorkers) {
+    auto topo = make_topology(make_wide_graph());
+    const auto shards = shard_seeds(distributed_seeds(), 4);
+
+    Coordinator coordinator(0);
+    // takes a shard and reports a failure on it
+    std::thread failing([&] {
+        detail::Socket s = detail::connect_to("127.0.0.1", coordinator.port());
+        const uint32_t hello[2] = {kWireProtocolVersion, detail::kSnapshotByteOrder};
+        s.send_message(detail::WireType::HELLO, detail::wire_bytes(hello, sizeof(hello)));
+        for (int i = 0; i < 3; ++i) s.recv_message();
+        s.send_message(detail::WireType::FAILED, "out of memory");
+    });
+    bool clean_exit = false;
+    std::thread worker([&] {
+        try {
+            run_worker("127.0.0.1", coordinator.port());
+            clean_exit = true;
+        } catch (const std::exception&) {}
+    });
+
+    EXPECT_THROW(coordinator.run(*topo, {}, shards, 2,
+                                 [](std::size_t, const BinaryRibs&) {}),
+                 std::runtime_error);
+    failing.join();
+    worker.join();
+    EXPECT_TRUE(clean_exit);
+}
+
+TEST(DistributedTest, StrayConnectionsAreDropped) {
+    auto topo = make_topology(make_wide_graph());
+    const auto shards = shard_seeds(distributed_seeds(), 4);
+
+    BinaryRibWriter expected;
+    run_sharded<BGPSim>(topo, {}, shards, 1, [](BGPSim&) {},
+        [&](std::size_t, const BGPSim& sim) { expected.add(sim); });
+
+    Coordinator coordinator(0);
+    coordinator.set_handshake_timeout(std::chrono::milliseconds(200));
+
+    // queued ahead of the real worker: a port probe, a silent client, a
+    // garbage header and a worker of another protocol version
+    std::vector<detail::Socket> strays;
+    strays.push_back(detail::connect_to("127.0.0.1", coordinator.port()));
+    strays.back().close();
+    strays.push_back(detail::connect_to("127.0.0.1", coordinator.port()));
+    strays.push_back(detail::connect_to("127.0.0.1", coordinator.port()));
+    const detail::WireHeader garbage{static_cast<uint32_t>(detail::WireType::HELLO), 0,
+                                     ~uint64_t(0)};
+    strays.back().send_all(&garbage, sizeof(garbage));
+    strays.push_back(detail::connect_to("127.0.0.1", coordinator.port()));
+    const uint32_t hello[2] = {kWireProtocolVersion + 1, detail::kSnapshotByteOrder};
+    strays.back().send_message(detail::WireType::HELLO, detail::wire_bytes(hello, sizeof(hello)));
+
+    std::size_t served = 0;
+    std::thread worker([&] { served = run_worker("127.0.0.1", coordinator.port()); });
+
+    BinaryRibWriter merged;
+    coordinator.run(*topo, {}, shards, 1,
+        [&](std::size_t, const BinaryRibs& ribs) { merged.add(ribs); });
+    worker.join();
+    EXPECT_EQ(served, shards.size());
+    EXPECT_EQ(binary_of(merged), binary_of(expected));
+}
+
+TEST(DistributedTest, OversizedFrameIsRejected) {
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    detail::Socket a(fds[0]), b(fds[1]);
+
+    const detail::WireHeader bogus{static_cast<uint32_t>(detail::WireType::RESULT), 0,
+                                   uint64_t(1) << 62};
+    a.send_all(&bogus, sizeof(bogus));
+    EXPECT_THROW(b.recv_message(), std::runtime_error);
+
+    a.send_message(detail::WireType::HELLO, "0123456789");
+    EXPECT_THROW(b.recv_message(), std::runtime_error);
+
+    // a frame within its cap still arrives whole across receive chunks
+    const std::string big((3u << 20) + 5, 'x');
+    std::thread sender([&] { a.send_message(detail::WireType::TOPOLOGY, big); });
+    char skip[10];   // the rejected HELLO's payload is still queued
+    b.recv_all(skip, sizeof(skip));
+    const detail::WireMessage msg = b.recv_message();
+    sender.join();
+    EXPECT_EQ(msg.type, detail::WireType::TOPOLOGY);
+    EXPECT_EQ(msg.payload, big);
+}
+
+// -------------------- PIPELINE TESTS --------------------
+
+TEST(PipelineTest, BoundedQueueBlocksWhenFullAndDrainsOnClose) {
+    BoundedQueue<int> q(2);
+    std::vector<int> seen;
+    std::thread consumer([&] {
+        while (auto v = q.pop()) seen.push_back(*v);
+    });
+    for (int i = 0; i < 100; ++i) ASSERT_TRUE(q.push(i));
+    q.close();
+    consumer.join();
+    EXPECT_FALSE(q.push(100));
+
+    ASSERT_EQ(seen.size(), 100u);
+    for (int i = 0; i < 100; ++i) EXPECT_EQ(seen[i], i);
+}
+
+TEST(PipelineTest, PipelinedShardsMatchShardedRun) {
+    auto topo = make_topology(make_wide_graph());
+    const std::vector<uint32_t> rov_asns = {2, 105, 117};
+    const auto shards = shard_seeds(distributed_seeds(), 2);
+
+    BinaryRibWriter expected;
+    run_sharded<BGPSim>(topo, rov_asns, shards, 1, [](BGPSim&) {},
+        [&](std::size_t, const BGPSim& sim) { expected.add(sim); });
+
+    for (unsigned threads : {1u, 3u}) {
+        BinaryRibWriter piped;
+        std::vector<std::size_t> order;
+        std::atomic<std::size_t> sims{0};
+        run_sharded_pipelined<BGPSim>(topo, rov_asns, shards, threads,
+            [&](BGPSim&) { ++sims; },
+            [&](std::size_t k, const BGPSim& sim) {
+                order.push_back(k);
+                piped.add(sim);
+            }, 1);
+
+        EXPECT_EQ(order, (std::vector<std::size_t>{0, 1, 2, 3, 4, 5}));
+        EXPECT_LE(sims, threads + 1);
+        EXPECT_EQ(binary_of(piped), binary_of(expected));
+    }
+
+    EXPECT_THROW(run_sharded_pipelined<BGPSim>(topo, rov_asns, shards, 2,
+                     [](BGPSim&) {},
+                     [](std::size_t k, const BGPSim&) {
+                         if (k == 2) throw std::runtime_error("disk full");
+                     }),
+                 std::runtime_error);
+}
+
+TEST(PipelineTest, NoMoreSimulatorsThanShards) {
+    auto topo = make_topology(make_wide_graph());
+    const auto shards = shard_seeds(distributed_seeds(), 6);
+    ASSERT_EQ(shards.size(), 2u);
+
+    BinaryRibWriter expected;
+    run_sharded<BGPSim>(topo, {}, shards, 1, [](BGPSim&) {},
+        [&](std::size_t, const BGPSim& sim) { expected.add(sim); });
+
+    BinaryRibWriter piped;
+    std::atomic<std::size_t> sims{0};
+    run_sharded_pipelined<BGPSim>(topo, {}, shards, 16,
+        [&](BGPSim&) { ++sims; },
+        [&](std::size_t, const BGPSim& sim) { piped.add(sim); });
+    EXPECT_LE(sims, shards.size());
+    EXPECT_EQ(binary_of(piped), binary_of(expected));
+
+    std::size_t calls = 0;
+    run_sharded_pipelined<BGPSim>(topo, {}, {}, 4,
+        [&](BGPSim&) { ++sims; },
+        [&](std::size_t, const BGPSim&) { ++calls; });
+    EXPECT_EQ(calls, 0u);
+}
+
+// -------------------- VERIFY TESTS --------------------
+
+template <typename Sim>
+static std::string canonical_csv(const Sim& sim, unsigned threads = 1) {
+    std::ostringstream out;
+    write_routing_rows(sim, out, threads, RowOrder::CANONICAL);
+    return out.str();
+}
+
+TEST(VerifyTest, CanonicalRowsAreTheSameForEveryEngine) {
+    auto topo = make_topology(make_wide_graph());
+    const std::vector<uint32_t> rov_asns = {2, 105, 117};
+    const auto seeds = distributed_seeds();
+
+    BGPSim reference(topo, rov_asns);
+    seed_all(reference, seeds);
+    reference.propagate_all();
+    const std::string expected = canonical_csv(reference);
+    ASSERT_FALSE(expected.empty());
+
+    BGPSim pull(topo, rov_asns);
+    pull.set_num_threads(3);
+    pull.set_strategy(Strategy::PULL);
+    seed_all(pull, seeds);
+    pull.propagate_all();
+    EXPECT_EQ(canonical_csv(pull, 2), expected);
+
+    ColumnarSim col(relabel_by_layer(*topo), rov_asns);
+    seed_all(col, seeds);
+    col.propagate_all();
+    EXPECT_EQ(canonical_csv(col), expected);
+
+    BinaryRibWriter sharded;
+    run_sharded<BGPSim>(topo, rov_asns, shard_seeds(seeds, 5), 2, [](BGPSim&) {},
+        [&](std::size_t, const BGPSim& sim) { sharded.add(sim); });
+    std::ostringstream out;
+    write_routing_rows(sharded.take(), out, RowOrder::CANONICAL);
+    EXPECT_EQ(out.str(), expected);
+}
+
+TEST(VerifyTest, ShardsAreWrittenOneAtATime) {
+    auto topo = make_topology(make_wide_graph());
+    const std::vector<uint32_t> rov_asns = {2, 105, 117};
+    const auto seeds = distributed_seeds();
+
+    BGPSim reference(topo, rov_asns);
+    seed_all(reference, seeds);
+    reference.propagate_all();
+
+    BinaryRibWriter merged;
+    std::ostringstream canonical;
+    {
+        BinaryRibFile file("ribs_segments.bin");
+        CanonicalRowSpill spill("ribs_rows.spill");
+        run_sharded<BGPSim>(topo, rov_asns, shard_seeds(seeds, 5), 2, [](BGPSim&) {},
+            [&](std::size_t, const BGPSim& sim) {
+                file.add(sim);
+                spill.add(sim);
+                merged.add(sim);
+            });
+        file.finish();
+        spill.finish(canonical);
+    }
+    EXPECT_EQ(canonical.str(), canonical_csv(reference));
+    std::ifstream gone("ribs_rows.spill");
+    EXPECT_FALSE(gone.is_open());
+
+    // one segment per shard, merged back in shard order
+    const BinaryRibs read = read_routing_binary("ribs_segments.bin");
+    std::ostringstream got, expected;
+    write_routing_rows(read, got);
+    write_routing_rows(merged.take(), expected);
+    EXPECT_EQ(got.str(), expected.str());
+    EXPECT_EQ(merged.size(), 0u);
+
+    std::string bytes;
+    {
+        std::ifstream in("ribs_segments.bin", std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    EXPECT_THROW(parse_routing_binary(std::string_view(bytes).substr(0, bytes.size() - 8)),
+                 std::runtime_error);
+    std::remove("ribs_segments.bin");
+}
+
+TEST(VerifyTest, ShardsAreDiffedOneAtATime) {
+    auto topo = make_topology(make_wide_graph());
+    const std::vector<uint32_t> rov_asns = {2, 105, 117};
+    const auto seeds = distributed_seeds();
+
+    BGPSim reference(topo, rov_asns);
+    seed_all(reference, seeds);
+    reference.propagate_all();
+    BinaryRibWriter writer;
+    writer.add(reference);
+    const BinaryRibs expected = writer.take();
+
+    RibDiffer all(expected), but_one(expected);
+    std::size_t skipped_rows = 0;
+    run_sharded<BGPSim>(topo, rov_asns, shard_seeds(seeds, 5), 1, [](BGPSim&) {},
+        [&](std::size_t k, const BGPSim& sim) {
+            BinaryRibWriter shard;
+            shard.add(sim);
+            const BinaryRibs ribs = shard.take();
+            all.add(ribs);
+            if (k == 1) skipped_rows = ribs.size();
+            else        but_one.add(ribs);
+        });
+
+    const RibDiff same = all.finish();
+    EXPECT_TRUE(same.same());
+    EXPECT_EQ(same.compared, expected.size());
+
+    const RibDiff missing = but_one.finish();
+    EXPECT_GT(skipped_rows, 0u);
+    EXPECT_EQ(missing.missing, skipped_rows);
+    EXPECT_EQ(missing.extra + missing.different, 0u);
+    EXPECT_EQ(missing.compared + missing.missing, expected.size());
+}
+
+TEST(VerifyTest, DiffFindsMissingAndChangedRoutes) {
+    auto topo = make_topology(make_wide_graph());
+    auto seeds = distributed_seeds();
+    auto ribs_of = [&](const std::vector<uint32_t>& rov_asns, const std::vector<Seed>& s) {
+        BGPSim sim(topo, rov_asns);
+        seed_all(sim, s);
+        sim.propagate_all();
+        BinaryRibWriter writer;
+        writer.add(sim);
+        return writer.take();
+    };
+
+    const BinaryRibs expected = ribs_of({2, 105, 117}, seeds);
+    const RibDiff same = diff_ribs(expected, ribs_of({2, 105, 117}, seeds));
+    EXPECT_TRUE(same.same());
+    EXPECT_EQ(same.compared, expected.asn.size());
+    EXPECT_TRUE(same.examples.empty());
+
+    // ROV at the upstream of the hijacked prefixes changes who holds them
+    const RibDiff rov = diff_ribs(expected, ribs_of({}, seeds), 3);
+    EXPECT_FALSE(rov.same());
+    EXPECT_GT(rov.missing + rov.different + rov.extra, 0u);
+    EXPECT_LE(rov.examples.size(), 3u);
+
+    seeds.pop_back();
+    const RibDiff fewer = diff_ribs(expected, ribs_of({2, 105, 117}, seeds));
+    EXPECT_GT(fewer.missing, 0u);
+    EXPECT_EQ(fewer.extra, 0u);
+    EXPECT_EQ(fewer.different, 0u);
+
+    std::ostringstream out;
+    write_rib_diff(fewer, out);
+    EXPECT_NE(out.str().find("MISMATCH"), std::string::npos);
+}
@@ -0,0 +1,103 @@
+// Writes a synthetic topology as simulator inputs: CAIDA serial-2
+// relationships, announcements and ROV ASNs (see topology_generator.hpp).
+//
+//   g++ -std=c++17 -O2 -Iinclude tools/gen_topology.cpp -o gen_topology
+//   ./gen_topology --ases 150000 --prefixes 100000 --seed 7
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "../include/topology_generator.hpp"
+
+static void print_usage(const char* prog) {
+    std::cerr
+        << "Usage: " << prog
+        << " [--ases <n>] [--tier1 <n>] [--transit-levels <n>]"
+        << " [--transit-fraction <f>] [--providers <mean>] [--peering <mean>]"
+        << " [--prefixes <n>] [--hijack-fraction <f>] [--rov-fraction <f>]"
+        << " [--seed <n>] [--relationships <as-rel-file>]"
+        << " [--announcements <announcements.csv>] [--rov-asns <rov_asns.csv>]\n";
+}
+
+static void write_file(const std::string& filename,
+                       void (*write)(const SyntheticTopology&, std::ostream&),
+                       const SyntheticTopology& topo) {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        throw std::runtime_error("Failed to open output file: " + filename);
+    write(topo, out);
+    if (!out)
+        throw std::runtime_error("Failed to write output file: " + filename);
+}
+
+int main(int argc, char** argv) {
+    GeneratorConfig cfg;
+    std::string rel_file = "synthetic.as-rel2.txt";
+    std::string ann_file = "synthetic_anns.csv";
+    std::string rov_file = "synthetic_rov_asns.csv";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--ases") {
+            cfg.num_ases = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--tier1") {
+            cfg.tier1 = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--transit-levels") {
+            cfg.transit_levels = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--transit-fraction") {
+            cfg.transit_fraction = std::atof(value);
+        } else if (arg == "--providers") {
+            cfg.providers = std::atof(value);
+        } else if (arg == "--peering") {
+            cfg.peering = std::atof(value);
+        } else if (arg == "--prefixes") {
+            cfg.num_prefixes = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--hijack-fraction") {
+            cfg.hijack_fraction = std::atof(value);
+        } else if (arg == "--rov-fraction") {
+            cfg.rov_fraction = std::atof(value);
+        } else if (arg == "--seed") {
+            cfg.seed = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--relationships") {
+            rel_file = value;
+        } else if (arg == "--announcements") {
+            ann_file = value;
+        } else if (arg == "--rov-asns") {
+            rov_file = value;
+        } else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    try {
+        SyntheticTopology topo = generate_topology(cfg);
+        write_file(rel_file, write_caida, topo);
+        write_file(ann_file, write_announcements, topo);
+        write_file(rov_file, write_rov_asns, topo);
+
+        std::cout << topo.asns.size() << " ASes, "
+                  << topo.provider_customer.size() << " provider-customer and "
+                  << topo.peers.size() << " peer links, "
+                  << topo.seeds.size() << " announcements, "
+                  << topo.rov_asns.size() << " ROV ASes\n";
+        return 0;
+    } catch (const std::exception& ex) {
+        std::cerr << "Fatal error: " << ex.what() << "\n";
+        return 1;
+    }
+}